@@ -15,6 +15,7 @@
 #include "press.h"
 #include "cmd.h"
 #include <drogon/DrClassMap.h>
+#include <algorithm>
 #include <iostream>
 #include <memory>
 #include <iomanip>
@@ -30,9 +31,20 @@ std::string press::detail()
            "  -t num    number of threads(default : 1)\n"
            "  -c num    concurrent connections(default : 1)\n"
            //  "  -k        keep alive(default: no)\n"
-           "  -q        no progress indication(default: no)\n\n"
+           "  -q        no progress indication(default: no)\n"
+           "  -s num    size of WebSocket messages in bytes(default : 64)\n"
+           "  -r num    WebSocket messages sent by every connection per "
+           "second,\n"
+           "            0 means sending one after the echo of the last "
+           "one(default : 0)\n\n"
            "example: drogon_ctl press -n 10000 -c 100 -t 4 -q "
-           "http://localhost:8080/index.html\n";
+           "http://localhost:8080/index.html\n\n"
+           "If the url starts with ws:// or wss://, messages are sent by "
+           "WebSocket\nconnections and the server must echo them back. "
+           "Messages that the server\nbroadcasts to other connections are "
+           "counted as fan-out deliveries.\n"
+           "example: drogon_ctl press -n 100000 -c 100 -t 4 -s 256 -r 10 "
+           "ws://localhost:8080/chat\n";
 }
 
 void outputErrorAndExit(const string_view &err)
@@ -147,6 +159,74 @@ void press::handleCommand(std::vector<std::string> &parameters)
                 continue;
             }
         }
+        else if (param.find("-s") == 0)
+        {
+            if (param == "-s")
+            {
+                iter++;
+                if (iter == parameters.end())
+                {
+                    outputErrorAndExit("No message size!");
+                }
+                auto &num = *iter;
+                try
+                {
+                    _messageSize = std::stoll(num);
+                }
+                catch (...)
+                {
+                    outputErrorAndExit("Invalid message size!");
+                }
+                continue;
+            }
+            else
+            {
+                auto num = param.substr(2);
+                try
+                {
+                    _messageSize = std::stoll(num);
+                }
+                catch (...)
+                {
+                    outputErrorAndExit("Invalid message size!");
+                }
+                continue;
+            }
+        }
+        else if (param.find("-r") == 0)
+        {
+            if (param == "-r")
+            {
+                iter++;
+                if (iter == parameters.end())
+                {
+                    outputErrorAndExit("No message rate!");
+                }
+                auto &num = *iter;
+                try
+                {
+                    _messageRate = std::stoll(num);
+                }
+                catch (...)
+                {
+                    outputErrorAndExit("Invalid message rate!");
+                }
+                continue;
+            }
+            else
+            {
+                auto num = param.substr(2);
+                try
+                {
+                    _messageRate = std::stoll(num);
+                }
+                catch (...)
+                {
+                    outputErrorAndExit("Invalid message rate!");
+                }
+                continue;
+            }
+        }
         // else if (param == "-k")
         // {
         //     _keepAlive = true;
@@ -166,7 +246,8 @@ void press::handleCommand(std::vector<std::string> &parameters)
     // std::cout << "c=" << _numOfConnections << std::endl;
     // std::cout << "q=" << _processIndication << std::endl;
     // std::cout << "url=" << _url << std::endl;
-    if (_url.empty() || _url.find("http") != 0 ||
+    if (_url.empty() ||
+        (_url.find("http") != 0 && _url.find("ws") != 0) ||
         _url.find("://") == std::string::npos)
     {
         outputErrorAndExit("Invalid URL");
@@ -188,7 +269,10 @@ void press::handleCommand(std::vector<std::string> &parameters)
     }
     // std::cout << "host=" << _host << std::endl;
     // std::cout << "path=" << _path << std::endl;
-    doTesting();
+    if (_url.find("ws") == 0)
+        doWebSocketTesting();
+    else
+        doTesting();
 }
 
 void press::doTesting()
@@ -316,3 +400,195 @@ void press::outputResults()
               << std::endl;
     exit(0);
 }
+
+void press::doWebSocketTesting()
+{
+    _loopPool = std::make_unique<trantor::EventLoopThreadPool>(_numOfThreads);
+    _loopPool->start();
+    for (size_t i = 0; i < _numOfConnections; i++)
+    {
+        auto wsClient = std::make_unique<WebSocketPressClient>();
+        wsClient->_client = WebSocketClient::newWebSocketClient(
+            _host, _loopPool->getNextLoop());
+        wsClient->_client->setMessageHandler(
+            [this, i](std::string &&message,
+                      const WebSocketClientPtr &,
+                      const WebSocketMessageType &type) {
+                if (type == WebSocketMessageType::Text)
+                    onMessage(i, message);
+            });
+        _wsClients.push_back(std::move(wsClient));
+    }
+    for (auto &wsClient : _wsClients)
+    {
+        auto request = HttpRequest::newHttpRequest();
+        request->setPath(_path);
+        wsClient->_client->connectToServer(
+            request,
+            [this](ReqResult r,
+                   const HttpResponsePtr &,
+                   const WebSocketClientPtr &) {
+                if (r != ReqResult::Ok)
+                    ++_stat._numOfBadResponse;
+                // Start sending when all connections are done connecting.
+                if (++_numOfConnected == _numOfConnections)
+                    startSendingMessages();
+            });
+    }
+    _loopPool->wait();
+}
+
+void press::startSendingMessages()
+{
+    if (_stat._numOfBadResponse >= _numOfConnections)
+    {
+        outputErrorAndExit("No connection!");
+    }
+    _stat._startDate = trantor::Date::now();
+    for (size_t i = 0; i < _wsClients.size(); ++i)
+    {
+        auto loop = _wsClients[i]->_client->getLoop();
+        loop->runInLoop([this, i, loop]() {
+            if (_messageRate == 0)
+            {
+                sendMessage(i);
+                return;
+            }
+            _wsClients[i]->_timerId =
+                loop->runEvery(1.0 / _messageRate, [this, i, loop]() {
+                    if (!sendMessage(i))
+                        loop->invalidateTimer(_wsClients[i]->_timerId);
+                });
+        });
+    }
+    // Output the results if the echoes stop coming.
+    _loopPool->getNextLoop()->runEvery(
+        1.0, [this, lastNum = size_t(0), idleSeconds = 0]() mutable {
+            size_t num = _stat._numOfGoodResponse;
+            if (num != lastNum ||
+                _stat._numOfRequestsSent < _numOfRequests)
+            {
+                lastNum = num;
+                idleSeconds = 0;
+            }
+            else if (++idleSeconds >= 5)
+            {
+                std::cout << "No echo is received in 5 seconds" << std::endl;
+                outputWebSocketResults();
+            }
+        });
+}
+
+bool press::sendMessage(size_t index)
+{
+    auto connPtr = _wsClients[index]->_client->getConnection();
+    if (!connPtr || !connPtr->connected())
+        return false;
+    auto numOfMessage = _stat._numOfRequestsSent++;
+    if (numOfMessage >= _numOfRequests)
+    {
+        return false;
+    }
+    // The message begins with the sending time and the index of the sender.
+    auto message =
+        std::to_string(trantor::Date::now().microSecondsSinceEpoch()) + " " +
+        std::to_string(index) + " ";
+    if (message.length() < _messageSize)
+        message.append(_messageSize - message.length(), 'x');
+    connPtr->send(message);
+    return true;
+}
+
+void press::onMessage(size_t index, const std::string &message)
+{
+    if (_finished)
+        return;
+    char *end = nullptr;
+    auto sendingTime = std::strtoll(message.c_str(), &end, 10);
+    auto sender = std::strtoull(end, nullptr, 10);
+    auto delay = trantor::Date::now().microSecondsSinceEpoch() - sendingTime;
+    _stat._bytesRecieved += message.length();
+    auto &wsClient = *_wsClients[index];
+    if (sender != index)
+    {
+        ++_numOfFanOut;
+        std::lock_guard<std::mutex> lock(wsClient._mutex);
+        wsClient._fanOutLags.push_back(delay);
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(wsClient._mutex);
+        wsClient._latencies.push_back(delay);
+    }
+    _stat._totalDelay += delay;
+    auto goodNum = ++_stat._numOfGoodResponse;
+    if (goodNum >= _numOfRequests)
+    {
+        outputWebSocketResults();
+    }
+    if (_processIndication && goodNum % 100000 == 0)
+    {
+        std::cout << goodNum << " echoes are received" << std::endl
+                  << std::endl;
+    }
+    if (_messageRate == 0)
+        sendMessage(index);
+}
+
+static void outputPercentiles(const char *title, std::vector<int64_t> &delays)
+{
+    if (delays.empty())
+        return;
+    std::sort(delays.begin(), delays.end());
+    auto percentile = [&delays](double p) {
+        return (double)delays[(size_t)(p * (delays.size() - 1))] / 1000;
+    };
+    std::cout << title << "min " << (double)delays.front() / 1000 << ", p50 "
+              << percentile(0.5) << ", p90 " << percentile(0.9) << ", p99 "
+              << percentile(0.99) << ", p99.9 " << percentile(0.999)
+              << ", max " << (double)delays.back() / 1000 << " ms"
+              << std::endl;
+}
+
+void press::outputWebSocketResults()
+{
+    if (_finished.exchange(true))
+        return;
+    std::vector<int64_t> latencies, fanOutLags;
+    for (auto &wsClient : _wsClients)
+    {
+        std::lock_guard<std::mutex> lock(wsClient->_mutex);
+        latencies.insert(latencies.end(),
+                         wsClient->_latencies.begin(),
+                         wsClient->_latencies.end());
+        fanOutLags.insert(fanOutLags.end(),
+                          wsClient->_fanOutLags.begin(),
+                          wsClient->_fanOutLags.end());
+    }
+    auto now = trantor::Date::now();
+    auto microSecs = now.microSecondsSinceEpoch() -
+                     _stat._startDate.microSecondsSinceEpoch();
+    double seconds = (double)microSecs / 1000000.0;
+    size_t sent = std::min<size_t>(_stat._numOfRequestsSent, _numOfRequests);
+    size_t echoes = _stat._numOfGoodResponse;
+    std::cout << std::endl;
+    std::cout << "TOTALS:   " << _numOfConnections << " connect, "
+              << _stat._numOfBadResponse << " fail, " << sent
+              << " messages, " << echoes << " echoes, " << _numOfFanOut
+              << " fan-out deliveries" << std::endl;
+
+    std::cout << std::setiosflags(std::ios::fixed) << std::setprecision(3)
+              << "TIMING:   " << seconds << " seconds, " << sent / seconds
+              << " messages/s, " << (echoes + _numOfFanOut) / seconds
+              << " deliveries/s" << std::endl;
+
+    outputPercentiles("LATENCY:  ", latencies);
+    outputPercentiles("FAN-OUT:  ", fanOutLags);
+
+    std::cout << "SPEED:    download " << _stat._bytesRecieved / seconds / 1000
+              << " kBps, upload "
+              << sent * std::max<size_t>(_messageSize, 1) / seconds / 1000
+              << " kBps" << std::endl
+              << std::endl;
+    exit(0);
+}
@@ -18,11 +18,13 @@
 #include <drogon/DrObject.h>
 #include <drogon/HttpAppFramework.h>
 #include <drogon/HttpClient.h>
+#include <drogon/WebSocketClient.h>
 #include <trantor/utils/Date.h>
 #include <trantor/net/EventLoopThreadPool.h>
 #include <string>
 #include <atomic>
 #include <memory>
+#include <mutex>
 #include <vector>
 
 using namespace drogon;
@@ -39,6 +41,16 @@ struct Statistics
     trantor::Date _startDate;
     trantor::Date _endDate;
 };
+struct WebSocketPressClient
+{
+    WebSocketClientPtr _client;
+    trantor::TimerId _timerId = trantor::InvalidTimerId;
+    // Round-trip times of the messages sent by this client and delivery lags
+    // of the messages sent by other clients, in microseconds.
+    std::mutex _mutex;
+    std::vector<int64_t> _latencies;
+    std::vector<int64_t> _fanOutLags;
+};
 class press : public DrObject<press>, public CommandHandler
 {
   public:
@@ -70,5 +82,18 @@ class press : public DrObject<press>, public CommandHandler
     std::unique_ptr<trantor::EventLoopThreadPool> _loopPool;
     std::vector<HttpClientPtr> _clients;
     Statistics _stat;
+
+    // The WebSocket mode
+    size_t _messageSize = 64;
+    size_t _messageRate = 0;
+    std::atomic_size_t _numOfConnected = ATOMIC_VAR_INIT(0);
+    std::atomic_size_t _numOfFanOut = ATOMIC_VAR_INIT(0);
+    std::atomic_bool _finished = ATOMIC_VAR_INIT(false);
+    std::vector<std::unique_ptr<WebSocketPressClient>> _wsClients;
+    void doWebSocketTesting();
+    void startSendingMessages();
+    bool sendMessage(size_t index);
+    void onMessage(size_t index, const std::string &message);
+    void outputWebSocketResults();
 };
 }  // namespace drogon_ctl
@@ -0,0 +1,212 @@
+/**
+ *
+ *  main.cc
+ *
+ *  A benchmark of the HTTP client and the forward() method. A mock upstream
+ *  and the clients run in this process over the loopback interface. Every
+ *  run sends a number of requests through a new client with the given
+ *  numbers of connections and pipelining depth, keeping all connections
+ *  busy, and outputs the throughput and the latency percentiles:
+ *  - direct runs send requests to the upstream handler;
+ *  - proxy runs send requests to a handler which forwards them to the
+ *    upstream with the forward() method;
+ *  - stream runs do the same with the forwardStreaming() method.
+ *  Compare a proxy run with the direct run of the same connections and
+ *  depth to get the overhead of forwarding, the forward() method is
+ *  allowed as many upstream connections as the largest proxy run has.
+ *
+ *  Usage: client_benchmark [requests per run, 20000 by default]
+ *                          [response body size, 64 by default]
+ *                          [server IO threads, 1 by default]
+ *
+ */
+
+#include <drogon/HttpAppFramework.h>
+#include <drogon/HttpClient.h>
+#include <trantor/net/EventLoopThread.h>
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace drogon;
+
+static const uint16_t port = 8850;
+static const std::string hostString = "http://127.0.0.1:8850";
+
+struct Run
+{
+    std::string _name;
+    std::string _path;
+    size_t _connections;
+    size_t _depth;
+};
+
+// All members are used in the loop of the clients.
+struct Bench
+{
+    trantor::EventLoop *_loop;
+    size_t _total;
+    std::vector<Run> _runs;
+    size_t _current = 0;
+    HttpClientPtr _client;
+    size_t _sent = 0;
+    size_t _finished = 0;
+    size_t _failed = 0;
+    std::vector<double> _latencies;
+    std::chrono::steady_clock::time_point _start;
+};
+
+static void startRun(Bench &bench);
+
+static void outputResults(Bench &bench)
+{
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - bench._start;
+    auto &run = bench._runs[bench._current];
+    auto &latencies = bench._latencies;
+    std::sort(latencies.begin(), latencies.end());
+    std::cout << std::left << std::setw(8) << run._name
+              << " connections=" << std::setw(4) << run._connections
+              << " depth=" << std::setw(4) << run._depth << std::right
+              << std::setw(8) << (size_t)(bench._finished / elapsed.count())
+              << " requests/s (" << bench._failed << " failed)";
+    if (!latencies.empty())
+    {
+        std::cout << "  latency(ms):";
+        for (auto percent : {50, 90, 99, 100})
+        {
+            auto index = std::min(latencies.size() * percent / 100,
+                                  latencies.size() - 1);
+            std::cout << "  p" << percent << "=" << std::fixed
+                      << std::setprecision(3) << latencies[index];
+        }
+    }
+    std::cout << std::endl;
+}
+
+static void sendOne(Bench &bench)
+{
+    if (bench._sent == bench._total)
+        return;
+    ++bench._sent;
+    auto req = HttpRequest::newHttpRequest();
+    req->setPath(bench._runs[bench._current]._path);
+    auto begin = std::chrono::steady_clock::now();
+    bench._client->sendRequest(
+        req, [&bench, begin](ReqResult result, const HttpResponsePtr &resp) {
+            std::chrono::duration<double, std::milli> latency =
+                std::chrono::steady_clock::now() - begin;
+            ++bench._finished;
+            if (result == ReqResult::Ok && resp->statusCode() == k200OK)
+                bench._latencies.push_back(latency.count());
+            else
+                ++bench._failed;
+            if (bench._finished == bench._total)
+            {
+                outputResults(bench);
+                ++bench._current;
+                // Don't destroy the client in its own callback.
+                bench._loop->queueInLoop([&bench]() { startRun(bench); });
+                return;
+            }
+            sendOne(bench);
+        });
+}
+
+static void startRun(Bench &bench)
+{
+    if (bench._current == bench._runs.size())
+    {
+        bench._client.reset();
+        app().quit();
+        return;
+    }
+    auto &run = bench._runs[bench._current];
+    bench._client = HttpClient::newHttpClient(hostString, bench._loop);
+    bench._client->setMaxConnectionNum(run._connections);
+    bench._client->setPipeliningDepth(run._depth);
+    bench._client->preconnect(run._connections);
+    bench._sent = 0;
+    bench._finished = 0;
+    bench._failed = 0;
+    bench._latencies.clear();
+    // Connections are established before the run starts.
+    bench._loop->runAfter(0.2, [&bench, &run]() {
+        bench._start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < run._connections * (run._depth + 1); ++i)
+            sendOne(bench);
+    });
+}
+
+int main(int argc, char *argv[])
+{
+    size_t total = 20000;
+    size_t bodySize = 64;
+    size_t threadNum = 1;
+    if (argc > 1)
+        total = std::stoul(argv[1]);
+    if (argc > 2)
+        bodySize = std::stoul(argv[2]);
+    if (argc > 3)
+        threadNum = std::stoul(argv[3]);
+
+    std::string body(bodySize, 'a');
+    app().registerHandler(
+        "/upstream",
+        [body](const HttpRequestPtr &,
+               std::function<void(const HttpResponsePtr &)> &&callback) {
+            auto resp = HttpResponse::newHttpResponse();
+            resp->setBody(body);
+            callback(resp);
+        });
+    app().registerHandler(
+        "/proxy",
+        [](const HttpRequestPtr &req,
+           std::function<void(const HttpResponsePtr &)> &&callback) {
+            req->setPath("/upstream");
+            app().forward(req, std::move(callback), hostString);
+        });
+    app().registerHandler(
+        "/stream",
+        [](const HttpRequestPtr &req,
+           std::function<void(const HttpResponsePtr &)> &&callback) {
+            req->setPath("/upstream");
+            app().forwardStreaming(req, std::move(callback), hostString);
+        });
+
+    trantor::EventLoopThread clientThread;
+    clientThread.run();
+    Bench bench;
+    bench._loop = clientThread.getLoop();
+    bench._total = total;
+    bench._latencies.reserve(total);
+    for (size_t connections : {1, 4, 16})
+    {
+        for (size_t depth : {0, 4, 16})
+        {
+            bench._runs.push_back(
+                {"direct", "/upstream", connections, depth});
+        }
+    }
+    for (size_t connections : {1, 16})
+    {
+        bench._runs.push_back({"proxy", "/proxy", connections, 0});
+        bench._runs.push_back({"stream", "/stream", connections, 0});
+    }
+    // The forwarding clients are created with the first forwarded requests,
+    // their pools must be large enough for the largest proxy run, otherwise
+    // the requests wait for the upstream connections instead of measuring
+    // the overhead of forwarding. A run with fewer connections never has
+    // more requests in flight than its connections.
+    app().setMaxForwardingConnectionNum(16);
+    bench._loop->runAfter(1.0, [&bench]() { startRun(bench); });
+
+    app().setLogLevel(trantor::Logger::WARN);
+    app().setThreadNum(threadNum);
+    app().addListener("127.0.0.1", port);
+    app().run();
+    return 0;
+}
@@ -0,0 +1,211 @@
+/**
+ *
+ *  main.cc
+ *
+ *  A benchmark comparing the ways of sending files over a loopback TCP
+ *  connection, it's used to choose the default value of the
+ *  sendfile_threshold option.
+ *
+ *  memory:   the file content is cached in memory and written to the socket.
+ *  read:     the file is opened and read into a buffer for every response.
+ *  mmap:     the file is opened and mapped into memory for every response.
+ *  sendfile: the file is opened and sent by sendfile() for every response.
+ *
+ *  Usage: file_benchmark [total MB sent for each size, 256 by default]
+ *
+ */
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+static void writeAll(int fd, const char *data, size_t len)
+{
+    while (len > 0)
+    {
+        auto n = write(fd, data, len);
+        if (n <= 0)
+        {
+            perror("write");
+            exit(1);
+        }
+        data += n;
+        len -= n;
+    }
+}
+
+static void sendByMemory(int sock,
+                         const std::string &,
+                         const std::string &content)
+{
+    writeAll(sock, content.data(), content.length());
+}
+
+static void sendByRead(int sock, const std::string &path, const std::string &)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    struct stat st;
+    fstat(fd, &st);
+    std::string buf;
+    buf.resize(st.st_size);
+    size_t offset = 0;
+    while (offset < buf.size())
+    {
+        auto n = read(fd, &buf[offset], buf.size() - offset);
+        if (n <= 0)
+            break;
+        offset += n;
+    }
+    close(fd);
+    writeAll(sock, buf.data(), offset);
+}
+
+static void sendByMmap(int sock, const std::string &path, const std::string &)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    struct stat st;
+    fstat(fd, &st);
+    auto addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED)
+    {
+        perror("mmap");
+        exit(1);
+    }
+    writeAll(sock, static_cast<const char *>(addr), st.st_size);
+    munmap(addr, st.st_size);
+}
+
+#ifdef __linux__
+static void sendBySendfile(int sock,
+                           const std::string &path,
+                           const std::string &)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    struct stat st;
+    fstat(fd, &st);
+    off_t offset = 0;
+    while (offset < st.st_size)
+    {
+        if (sendfile(sock, fd, &offset, st.st_size - offset) <= 0)
+        {
+            perror("sendfile");
+            exit(1);
+        }
+    }
+    close(fd);
+}
+#endif
+
+int main(int argc, char *argv[])
+{
+    size_t totalBytes = 256 * 1024 * 1024;
+    if (argc > 1)
+        totalBytes = std::stoul(argv[1]) * 1024 * 1024;
+
+    int listenFd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t addrLen = sizeof(addr);
+    if (bind(listenFd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+        listen(listenFd, 1) < 0 ||
+        getsockname(listenFd, (struct sockaddr *)&addr, &addrLen) < 0)
+    {
+        perror("listen");
+        return 1;
+    }
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+    if (connect(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+    {
+        perror("connect");
+        return 1;
+    }
+    int on = 1;
+    setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    int peer = accept(listenFd, nullptr, nullptr);
+
+    // Drain the connection like a fast client.
+    std::atomic<bool> stop(false);
+    std::thread drainThread([peer, &stop]() {
+        std::vector<char> buf(256 * 1024);
+        while (!stop)
+        {
+            if (read(peer, buf.data(), buf.size()) <= 0)
+                break;
+        }
+    });
+
+    typedef std::function<void(int, const std::string &, const std::string &)>
+        SendFunction;
+    std::vector<std::pair<std::string, SendFunction>> methods = {
+        {"memory", sendByMemory},
+        {"read", sendByRead},
+        {"mmap", sendByMmap},
+#ifdef __linux__
+        {"sendfile", sendBySendfile},
+#endif
+    };
+
+    std::cout << std::setw(10) << "size";
+    for (auto &method : methods)
+        std::cout << std::setw(14) << method.first;
+    std::cout << "    (responses per second)" << std::endl;
+
+    std::vector<size_t> sizes = {1024,
+                                 4 * 1024,
+                                 16 * 1024,
+                                 64 * 1024,
+                                 128 * 1024,
+                                 256 * 1024,
+                                 1024 * 1024,
+                                 4 * 1024 * 1024};
+    for (auto size : sizes)
+    {
+        std::string path = "./file_benchmark_" + std::to_string(size) + ".tmp";
+        std::string content(size, 'x');
+        int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        writeAll(fd, content.data(), content.length());
+        close(fd);
+
+        auto times = std::max<size_t>(totalBytes / size, 100);
+        std::cout << std::setw(9) << size / 1024 << "K";
+        for (auto &method : methods)
+        {
+            auto start = std::chrono::steady_clock::now();
+            for (size_t i = 0; i < times; ++i)
+            {
+                method.second(sock, path, content);
+            }
+            std::chrono::duration<double> elapsed =
+                std::chrono::steady_clock::now() - start;
+            std::cout << std::setw(14) << (size_t)(times / elapsed.count());
+            std::cout.flush();
+        }
+        std::cout << std::endl;
+        unlink(path.c_str());
+    }
+    stop = true;
+    shutdown(sock, SHUT_RDWR);
+    drainThread.join();
+    close(sock);
+    close(peer);
+    close(listenFd);
+    return 0;
+}
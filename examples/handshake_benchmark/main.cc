@@ -0,0 +1,168 @@
+/**
+ *
+ *  main.cc
+ *
+ *  A benchmark of WebSocket handshake storms, like the reconnection of all
+ *  clients after a deploy. A WebSocket server and the clients run in this
+ *  process over the loopback interface, a number of clients connect at the
+ *  same time, and every client that finishes the handshake closes its
+ *  connection and is replaced by a new one until all connections are made.
+ *
+ *  Usage: handshake_benchmark [total connections, 20000 by default]
+ *                             [concurrent connections, 500 by default]
+ *                             [server IO threads, 1 by default]
+ *
+ *  The open files limit (ulimit -n) must be greater than twice the number
+ *  of concurrent connections.
+ *
+ */
+
+#include <drogon/HttpAppFramework.h>
+#include <drogon/WebSocketClient.h>
+#include <drogon/WebSocketController.h>
+#include <trantor/net/EventLoopThread.h>
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace drogon;
+
+class StormCtrl : public drogon::WebSocketController<StormCtrl>
+{
+  public:
+    virtual void handleNewMessage(const WebSocketConnectionPtr &,
+                                  std::string &&,
+                                  const WebSocketMessageType &) override
+    {
+    }
+    virtual void handleNewConnection(const HttpRequestPtr &,
+                                     const WebSocketConnectionPtr &) override
+    {
+    }
+    virtual void handleConnectionClosed(
+        const WebSocketConnectionPtr &) override
+    {
+    }
+    WS_PATH_LIST_BEGIN
+    WS_PATH_ADD("/storm");
+    WS_PATH_LIST_END
+};
+
+static const uint16_t port = 8849;
+
+// All members are used in the loop of the clients.
+struct Storm
+{
+    trantor::EventLoop *_loop;
+    size_t _total;
+    size_t _concurrency;
+    size_t _started = 0;
+    size_t _finished = 0;
+    size_t _failed = 0;
+    std::vector<WebSocketClientPtr> _clients;
+    std::vector<double> _latencies;
+    std::chrono::steady_clock::time_point _start;
+};
+
+static void outputResults(Storm &storm)
+{
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - storm._start;
+    auto &latencies = storm._latencies;
+    std::sort(latencies.begin(), latencies.end());
+    std::cout << storm._finished << " handshakes (" << storm._failed
+              << " failed) in " << std::fixed << std::setprecision(3)
+              << elapsed.count() << "s, "
+              << (size_t)(storm._finished / elapsed.count())
+              << " handshakes per second" << std::endl;
+    if (latencies.empty())
+        return;
+    std::cout << "latency(ms):";
+    for (auto percent : {50, 90, 99, 100})
+    {
+        auto index = std::min(latencies.size() * percent / 100,
+                              latencies.size() - 1);
+        std::cout << "  p" << percent << "=" << std::setprecision(2)
+                  << latencies[index];
+    }
+    std::cout << std::endl;
+}
+
+static void connectOne(Storm &storm)
+{
+    if (storm._started == storm._total)
+        return;
+    auto index = storm._started++;
+    auto client = WebSocketClient::newWebSocketClient("127.0.0.1",
+                                                      port,
+                                                      false,
+                                                      storm._loop);
+    storm._clients[index] = client;
+    auto req = HttpRequest::newHttpRequest();
+    req->setPath("/storm");
+    auto begin = std::chrono::steady_clock::now();
+    client->connectToServer(
+        req,
+        [&storm, index, begin](ReqResult result,
+                               const HttpResponsePtr &,
+                               const WebSocketClientPtr &wsPtr) {
+            std::chrono::duration<double, std::milli> latency =
+                std::chrono::steady_clock::now() - begin;
+            ++storm._finished;
+            if (result == ReqResult::Ok)
+            {
+                storm._latencies.push_back(latency.count());
+                wsPtr->getConnection()->forceClose();
+            }
+            else
+            {
+                ++storm._failed;
+            }
+            // Don't destroy the client in its own callback.
+            storm._loop->queueInLoop(
+                [&storm, index]() { storm._clients[index].reset(); });
+            if (storm._finished == storm._total)
+            {
+                outputResults(storm);
+                app().quit();
+                return;
+            }
+            connectOne(storm);
+        });
+}
+
+int main(int argc, char *argv[])
+{
+    size_t total = 20000;
+    size_t concurrency = 500;
+    size_t threadNum = 1;
+    if (argc > 1)
+        total = std::stoul(argv[1]);
+    if (argc > 2)
+        concurrency = std::stoul(argv[2]);
+    if (argc > 3)
+        threadNum = std::stoul(argv[3]);
+
+    trantor::EventLoopThread clientThread;
+    clientThread.run();
+    Storm storm;
+    storm._loop = clientThread.getLoop();
+    storm._total = total;
+    storm._concurrency = concurrency;
+    storm._clients.resize(total);
+    storm._latencies.reserve(total);
+    storm._loop->runAfter(1.0, [&storm]() {
+        storm._start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < storm._concurrency; ++i)
+            connectOne(storm);
+    });
+
+    app().setLogLevel(trantor::Logger::WARN);
+    app().setThreadNum(threadNum);
+    app().addListener("127.0.0.1", port);
+    app().run();
+    return 0;
+}
@@ -483,12 +483,41 @@ class HttpAppFramework : public trantor::NonCopyable
      *
      * This method can be used to implement reverse proxy or redirection on the
      * server side.
+     *
+     * When it's called in an IO thread, the request is sent by the client
+     * of the thread to the host, see the setMaxForwardingConnectionNum()
+     * method.
      */
     virtual void forward(
         const HttpRequestPtr &req,
         std::function<void(const HttpResponsePtr &)> &&callback,
         const std::string &hostString = "") = 0;
 
+    /// Forward the http request and relay the body of the response
+    /**
+     * Unlike the forward() method, the callback is called as soon as the
+     * headers of the response are received from the host, and the body is
+     * sent to the client as it arrives, as it is, without being decompressed
+     * or kept in memory. So this method is suitable for large responses.
+     *
+     * @param req the HTTP request to be forwarded;
+     * @param callback is called with the response, whose headers can be
+     * modified but whose body is always the body from the host, so the
+     * response should be passed to the callback of the handler unchanged
+     * otherwise. If the host can't be reached, a 404 response is created.
+     * @param hostString is the address where the request is forwarded, see
+     * the forward() method, it must not be empty.
+     *
+     * @note
+     * The client connection is closed if it doesn't receive the body as
+     * fast as the host sends it and more than 64MB of the body are waiting
+     * to be sent.
+     */
+    virtual void forwardStreaming(
+        const HttpRequestPtr &req,
+        std::function<void(const HttpResponsePtr &)> &&callback,
+        const std::string &hostString) = 0;
+
     /// Get information about the handlers registered to drogon
     /**
      * @return
@@ -693,13 +722,23 @@ class HttpAppFramework : public trantor::NonCopyable
      *
      * @note
      * This operation can be performed by an option in the configuration file.
-     * Even though sendfile() is enabled, only files larger than 200k are sent
-     * this way,
+     * Even though sendfile() is enabled, only files larger than the sendfile
+     * threshold (64K by default) are sent this way,
      * because the advantages of sendfile() can only be reflected in sending
      * large files.
      */
     virtual HttpAppFramework &enableSendfile(bool sendFile) = 0;
 
+    /// Set the minimum size of files sent by sendfile().
+    /**
+     * @param threshold Files larger than this size are sent by sendfile() if
+     * it's enabled. The default value is 64K.
+     *
+     * @note
+     * This operation can be performed by an option in the configuration file.
+     */
+    virtual HttpAppFramework &setSendfileThreshold(size_t threshold) = 0;
+
     /// Enable gzip compression.
     /**
      * @param useGzip if the parameter is true, use gzip to compress the
@@ -839,13 +878,89 @@ class HttpAppFramework : public trantor::NonCopyable
 
     /// Set the max size of messages sent by WebSocket client.
     /**
-     * The default value is 128K.
+     * The default value is 128K. The size of compressed messages received
+     * by WebSocket clients after they are decompressed is limited too.
      * @note
      * This operation can be performed by an option in the configuration file.
      */
     virtual HttpAppFramework &setClientMaxWebSocketMessageSize(
         size_t maxSize) = 0;
 
+    /// Enable the permessage-deflate extension of WebSocket (rfc7692).
+    /**
+     * The extension is used by connections whose clients offer it. The zlib
+     * streams of every connection are reused by all its messages.
+     *
+     * @param enable Whether to accept the extension, the default value is
+     * false.
+     * @param maxWindowBits The max LZ77 window bits (9-15) used by the
+     * server and required from clients, smaller windows take less memory per
+     * connection but compress less.
+     * @note
+     * This operation can be performed by an option in the configuration file.
+     */
+    virtual HttpAppFramework &enableWebSocketCompression(
+        bool enable,
+        int maxWindowBits = 15) = 0;
+
+    /// Set the number of worker threads for WebSocket controllers.
+    /**
+     * The messages of the WebSocket controllers whose usesWorkerThreads()
+     * method returns true are handled by these threads instead of the IO
+     * threads. The default value is 0, which means the number of CPU cores.
+     * The threads are created when the first such connection is established.
+     * @note
+     * This operation can be performed by an option in the configuration file.
+     */
+    virtual HttpAppFramework &setWebSocketWorkerThreadNum(size_t num) = 0;
+
+    /// Set the max number of connections to every host of the forward()
+    /// method in each IO thread.
+    /**
+     * Every IO thread has its own clients for the forward() method, so the
+     * forwarded requests and their responses are handled in the IO thread of
+     * the original request without any lock. The default value is 1.
+     * @note
+     * This operation can be performed by an option in the configuration file.
+     */
+    virtual HttpAppFramework &setMaxForwardingConnectionNum(size_t num) = 0;
+
+    /// Add a group of upstream hosts for the forward() method
+    /**
+     * When the name of the group is used as the host string of the forward()
+     * or forwardStreaming() methods, every request is sent to a host of the
+     * group.
+     *
+     * @param name The name of the group, it must not be a valid host string.
+     * @param hosts The host strings of the group, see the forward() method.
+     * @param balancing How to choose a host for a request, one of
+     * "round_robin", "least_connections" and "consistent_hash".
+     * @param hashKey The value hashed by the "consistent_hash" method, like
+     * "header:x-user-id" or "cookie:session_id", requests with the same value
+     * are sent to the same host as long as it's up.
+     * @param healthCheckPath The path requested by the GET method from
+     * every host every healthCheckInterval seconds, a host is down while the
+     * request fails or gets a 5xx response. Empty means no active checks.
+     * @param maxFails A host is ejected from the group for ejectionTime
+     * seconds after maxFails requests sent to it fail in a row, by network
+     * errors or 502, 503 and 504 responses. 0 means never.
+     * @param retries The number of times a request with an idempotent method
+     * is sent to another host when it can't be sent or no response comes.
+     *
+     * @note
+     * This operation can be performed by an option in the configuration file.
+     */
+    virtual HttpAppFramework &addUpstreamGroup(
+        const std::string &name,
+        const std::vector<std::string> &hosts,
+        const std::string &balancing = "round_robin",
+        const std::string &hashKey = "",
+        const std::string &healthCheckPath = "",
+        const double healthCheckInterval = 5.0,
+        const size_t maxFails = 3,
+        const double ejectionTime = 30.0,
+        const size_t retries = 1) = 0;
+
     // Set the HTML file of the home page, the default value is "index.html"
     /**
      * If there isn't any handler registered to the path "/", the home page file
@@ -21,6 +21,7 @@
 #include <drogon/DrObject.h>
 #include <drogon/utils/FunctionTraits.h>
 #include <drogon/HttpRequest.h>
+#include <drogon/utils/coroutine.h>
 #include <list>
 #include <memory>
 #include <sstream>
@@ -109,6 +110,11 @@ class HttpBinder : public HttpBinderBase
     {
         static_assert(traits::isHTTPFunction,
                       "Your API handler function interface is wrong!");
+#ifdef __cpp_impl_coroutine
+        static_assert(!IsTask<typename traits::result_type>::value,
+                      "A coroutine handler must return AsyncTask, a Task "
+                      "is never started!");
+#endif
         _handlerName = DrClassMap::demangle(typeid(FUNCTION).name());
     }
     void test()
@@ -18,17 +18,74 @@
 #include <drogon/drogon_callbacks.h>
 #include <drogon/HttpResponse.h>
 #include <drogon/HttpRequest.h>
+#include <drogon/utils/coroutine.h>
 #include <trantor/utils/NonCopyable.h>
 #include <trantor/net/EventLoop.h>
 #include <functional>
 #include <memory>
 #include <future>
+#include <stdexcept>
 
 namespace drogon
 {
 class HttpClient;
 typedef std::shared_ptr<HttpClient> HttpClientPtr;
 
+#ifdef __cpp_impl_coroutine
+/// The exception thrown by awaiting a request which fails
+class HttpRequestException : public std::runtime_error
+{
+  public:
+    explicit HttpRequestException(ReqResult result)
+        : std::runtime_error(message(result)), _result(result)
+    {
+    }
+    ReqResult result() const
+    {
+        return _result;
+    }
+
+  private:
+    static const char *message(ReqResult result)
+    {
+        switch (result)
+        {
+            case ReqResult::BadResponse:
+                return "Bad response";
+            case ReqResult::NetworkFailure:
+                return "Network failure";
+            case ReqResult::BadServerAddress:
+                return "Bad server address";
+            case ReqResult::Timeout:
+                return "Timeout";
+            case ReqResult::Cancelled:
+                return "Cancelled";
+            default:
+                return "Unknown error";
+        }
+    }
+    ReqResult _result;
+};
+
+namespace internal
+{
+class HttpRespAwaiter : public CallbackAwaiter<HttpResponsePtr>
+{
+  public:
+    HttpRespAwaiter(HttpClient *client, HttpRequestPtr req, double timeout)
+        : _client(client), _req(std::move(req)), _timeout(timeout)
+    {
+    }
+    void await_suspend(std::coroutine_handle<> handle);
+
+  private:
+    HttpClient *_client;
+    HttpRequestPtr _req;
+    double _timeout;
+};
+}  // namespace internal
+#endif
+
 /// Asynchronous http client
 /**
  * HttpClient implementation object uses the HttpAppFramework's event loop by
@@ -52,13 +109,17 @@ class HttpClient : public trantor::NonCopyable
      * @param req The request sent to the server.
      * @param callback The callback is called when the response is received from
      * the server.
+     * @param timeout The timeout in seconds, if it's 0, the timeout of the
+     * client is used, see the setTimeout() method. The request is given up
+     * at the deadline of the request if it's earlier.
      * @note
      * The request object is altered(some headers are added to it) before it is
      * sent, so calling this method with a same request object in different
      * thread is dangerous.
      */
     virtual void sendRequest(const HttpRequestPtr &req,
-                             const HttpReqCallback &callback) = 0;
+                             const HttpReqCallback &callback,
+                             double timeout = 0) = 0;
 
     /**
      * @brief Send a request asynchronously to the server
@@ -66,34 +127,77 @@ class HttpClient : public trantor::NonCopyable
      * @param req The request sent to the server.
      * @param callback The callback is called when the response is received from
      * the server.
+     * @param timeout The timeout in seconds, see the method above.
      * @note
      * The request object is altered(some headers are added to it) before it is
      * sent, so calling this method with a same request object in different
      * thread is dangerous.
      */
     virtual void sendRequest(const HttpRequestPtr &req,
-                             HttpReqCallback &&callback) = 0;
+                             HttpReqCallback &&callback,
+                             double timeout = 0) = 0;
 
     /**
      * @brief Send a request synchronously to the server and return the
      * response.
      *
      * @param req
+     * @param timeout The timeout in seconds, see the methods above.
      * @return std::pair<ReqResult, HttpResponsePtr>
      * @note Never call this function in the event loop thread of the
      * client (partially in the callback function of the asynchronous
      * sendRequest method), otherwise the thread will be blocked forever.
      */
-    std::pair<ReqResult, HttpResponsePtr> sendRequest(const HttpRequestPtr &req)
+    std::pair<ReqResult, HttpResponsePtr> sendRequest(const HttpRequestPtr &req,
+                                                      double timeout = 0)
     {
         std::promise<std::pair<ReqResult, HttpResponsePtr>> prom;
         auto f = prom.get_future();
-        sendRequest(req, [&prom](ReqResult r, const HttpResponsePtr &resp) {
-            prom.set_value({r, resp});
-        });
+        sendRequest(req,
+                    [&prom](ReqResult r, const HttpResponsePtr &resp) {
+                        prom.set_value({r, resp});
+                    },
+                    timeout);
         return f.get();
     }
 
+#ifdef __cpp_impl_coroutine
+    /**
+     * @brief Send a request in a coroutine and return the response.
+     *
+     * The coroutine is resumed in the event loop in which it awaits, so this
+     * method can be used in the event loop of the client. An
+     * HttpRequestException is thrown if the request fails.
+     *
+     * @code
+       auto resp = co_await client->sendRequestCoro(req);
+       @endcode
+     */
+    internal::HttpRespAwaiter sendRequestCoro(HttpRequestPtr req,
+                                              double timeout = 0)
+    {
+        return internal::HttpRespAwaiter(this, std::move(req), timeout);
+    }
+#endif
+
+    /// Cancel a request sent by the client
+    /**
+     * The request object is the handle of the request. If its response is
+     * not received yet, the callback is called with ReqResult::Cancelled.
+     * If the request is already sent, the connection is closed since its
+     * response can't be skipped, and the requests sent after it over the
+     * connection fail with ReqResult::NetworkFailure.
+     */
+    virtual void cancelRequest(const HttpRequestPtr &req) = 0;
+
+    /// Set the timeout in seconds of the requests of the client.
+    /**
+     * The callback of a request is called with ReqResult::Timeout if the
+     * response is not received in time. The default value is 0, which means
+     * no timeout.
+     */
+    virtual void setTimeout(double timeout) = 0;
+
     /// Set the pipelining depth, which is the number of requests that are not
     /// responding.
     /**
@@ -103,6 +207,44 @@ class HttpClient : public trantor::NonCopyable
      */
     virtual void setPipeliningDepth(size_t depth) = 0;
 
+    /// Set the max number of connections to the server.
+    /**
+     * The default value is 1, which means all requests are sent over one
+     * connection. If the number is greater than 1, every request is sent over
+     * the connection with the fewest requests waiting for responses, and a
+     * new connection is established when all connections are busy, so a slow
+     * response doesn't block the requests behind it. Connections which are
+     * idle for idleTimeout seconds are closed except the last one.
+     */
+    virtual void setMaxConnectionNum(size_t num, double idleTimeout = 60.0) = 0;
+
+    /// Establish connections to the server in advance
+    /**
+     * The first requests don't wait for resolving the name and connecting to
+     * the server then. The number of connections is limited by the
+     * setMaxConnectionNum() method, and pre-established connections are
+     * closed like other idle connections.
+     */
+    virtual void preconnect(size_t num = 1) = 0;
+
+    /// Set the time in seconds for which the addresses of domain names are
+    /// cached, the default value is 60.
+    /**
+     * The cache is shared by all clients of the process, a client resolves
+     * the name of its server again when the address expires in the cache.
+     */
+    static void setDnsCacheTtl(double ttl);
+
+    /// Receive compressed bodies as they are
+    /**
+     * By default, a gzip body is decompressed when the body() or
+     * jsonObject() method of the response is called for the first time. The
+     * received body and the content-encoding header are kept unless the
+     * non-const body() method is called. If the flag is true, the body is
+     * never decompressed.
+     */
+    virtual void enableRawBody(bool flag = true) = 0;
+
     /// Enable cookies for the client
     /**
      * @param flag if the parameter is true, all requests sent by the client
@@ -192,4 +334,25 @@ class HttpClient : public trantor::NonCopyable
     HttpClient() = default;
 };
 
+#ifdef __cpp_impl_coroutine
+inline void internal::HttpRespAwaiter::await_suspend(
+    std::coroutine_handle<> handle)
+{
+    suspend(handle);
+    // The coroutine stays suspended until the callback is called, so the
+    // awaiter outlives the request and only this pointer is captured.
+    _client->sendRequest(
+        _req,
+        [this](ReqResult result, const HttpResponsePtr &resp) {
+            if (result == ReqResult::Ok)
+                setValue(resp);
+            else
+                setException(
+                    std::make_exception_ptr(HttpRequestException(result)));
+            resume();
+        },
+        _timeout);
+}
+#endif
+
 }  // namespace drogon
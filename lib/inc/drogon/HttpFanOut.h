@@ -0,0 +1,156 @@
+/**
+ *
+ *  HttpFanOut.h
+ *  An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#pragma once
+
+#include <drogon/HttpClient.h>
+#include <trantor/net/EventLoop.h>
+#include <trantor/utils/NonCopyable.h>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace drogon
+{
+/// The outcome of one request of a fan-out.
+struct HttpFanOutResult
+{
+    /// ReqResult::Cancelled if the fan-out completed before the response.
+    ReqResult _result = ReqResult::Cancelled;
+    HttpResponsePtr _response;
+};
+
+class HttpFanOut;
+typedef std::shared_ptr<HttpFanOut> HttpFanOutPtr;
+
+/**
+ * @brief Send a number of requests in parallel and collect their results.
+ *
+ * The responses are collected in the loop of the fan-out, so no lock is
+ * needed, and the callback is called in the loop once, when all requests
+ * are finished or when the quorum is reached.
+ *
+ * Example usage:
+ *
+ * @code
+ * auto fanOut = HttpFanOut::newHttpFanOut();
+ * auto userIndex = fanOut->addRequest(userReq, userClient, 0.5);
+ * auto feedIndex = fanOut->addRequest(feedReq, {feedClient1, feedClient2});
+ * fanOut->setHedgeDelay(0.05);
+ * fanOut->send([=](const std::vector<HttpFanOutResult> &results) {
+ *     if (results[userIndex]._result == ReqResult::Ok)
+ *     ...
+ * });
+ * @endcode
+ */
+class HttpFanOut : public trantor::NonCopyable,
+                   public std::enable_shared_from_this<HttpFanOut>
+{
+  public:
+    typedef std::function<void(const std::vector<HttpFanOutResult> &)>
+        Callback;
+
+    /// Create a fan-out which runs in the loop
+    /**
+     * If the loop is nullptr, the fan-out runs in the loop of the current
+     * thread, or in the main loop of the framework if the current thread
+     * doesn't run a loop.
+     */
+    static HttpFanOutPtr newHttpFanOut(trantor::EventLoop *loop = nullptr);
+
+    explicit HttpFanOut(trantor::EventLoop *loop);
+
+    /// Add a request, and return the index of its result
+    /**
+     * The request is sent by the first client, its hedged copy is sent by the
+     * next client, so the clients can be connected to the replicas of a
+     * service. The timeout in seconds works like the one of the
+     * HttpClient::sendRequest() method. Requests must be added before the
+     * send() method is called.
+     */
+    size_t addRequest(const HttpRequestPtr &req,
+                      const std::vector<HttpClientPtr> &clients,
+                      double timeout = 0);
+    size_t addRequest(const HttpRequestPtr &req,
+                      const HttpClientPtr &client,
+                      double timeout = 0)
+    {
+        return addRequest(req, std::vector<HttpClientPtr>{client}, timeout);
+    }
+
+    /// Complete the fan-out when the number of requests succeed
+    /**
+     * The fan-out also completes as soon as the quorum can't be reached. The
+     * responses received after the completion are dropped. By default, the
+     * fan-out waits for all requests.
+     */
+    void setQuorum(size_t num)
+    {
+        _quorum = num;
+    }
+
+    /// Send a copy of every request whose response is not received after
+    /// the delay in seconds, the first response of the two is used.
+    /**
+     * Only requests that can be sent again (all except POST requests and
+     * file upload requests) are hedged. The default delay is 0, which means
+     * no hedging.
+     */
+    void setHedgeDelay(double delay)
+    {
+        _hedgeDelay = delay;
+    }
+
+    /// Send all requests, the results are in the order of the requests.
+    void send(Callback &&callback);
+
+  private:
+    struct Call
+    {
+        HttpRequestPtr _req;
+        // The copy of the request sent when it's hedged, it's made before
+        // the request is sent, since the client alters the request in its
+        // own loop.
+        HttpRequestPtr _hedgeReq;
+        std::vector<HttpClientPtr> _clients;
+        double _timeout;
+        // The number of copies sent and the number of copies waiting for
+        // their responses.
+        size_t _sent = 0;
+        size_t _pending = 0;
+        bool _done = false;
+    };
+    void sendCall(size_t index,
+                  const HttpRequestPtr &req,
+                  const HttpClientPtr &client,
+                  double timeout);
+    void onResponse(size_t index,
+                    ReqResult result,
+                    const HttpResponsePtr &resp);
+    void hedge();
+    void complete();
+
+    trantor::EventLoop *_loop;
+    std::vector<Call> _calls;
+    std::vector<HttpFanOutResult> _results;
+    size_t _quorum = 0;
+    double _hedgeDelay = 0;
+    size_t _succeeded = 0;
+    size_t _finished = 0;
+    bool _completed = false;
+    Callback _callback;
+    trantor::TimerId _hedgeTimerId = trantor::InvalidTimerId;
+};
+
+}  // namespace drogon
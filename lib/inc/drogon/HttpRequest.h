@@ -278,6 +278,17 @@ class HttpRequest
         return creationDate();
     }
 
+    /// Set the time after which the response is no longer needed
+    /**
+     * The HTTP client gives up the request when its deadline is reached, so
+     * a request received by the server can be forwarded with its deadline,
+     * or its deadline can be set to the requests sent to handle it.
+     */
+    virtual void setDeadline(const trantor::Date &deadline) = 0;
+
+    /// Return the deadline, it's the zero date if no deadline is set.
+    virtual const trantor::Date &deadline() const = 0;
+
     /// Get the Json object of the request
     /**
      * The content type of the request must be 'application/json', and the query
@@ -115,7 +115,8 @@ enum class ReqResult
     BadResponse,
     NetworkFailure,
     BadServerAddress,
-    Timeout
+    Timeout,
+    Cancelled
 };
 
 enum class WebSocketMessageType
@@ -14,6 +14,7 @@
 
 #pragma once
 
+#include <functional>
 #include <map>
 #include <string>
 #include <vector>
@@ -69,6 +70,21 @@ class HttpFile
      */
     int saveAs(const std::string &filename) const;
 
+    /// Save the file to the file system asynchronously.
+    /**
+     * The paths are the same as the synchronous versions. The content is
+     * copied before the methods return, and the callback is called with 0 on
+     * success or -1 on failure. When these methods are called in an event
+     * loop of the framework and io_uring is available, the file is written
+     * without blocking the event loop, otherwise the callback is called
+     * before the methods return.
+     */
+    void save(std::function<void(int)> &&callback) const;
+    void save(const std::string &path,
+              std::function<void(int)> &&callback) const;
+    void saveAs(const std::string &filename,
+                std::function<void(int)> &&callback) const;
+
     /// Return the file length.
     int64_t fileLength() const noexcept
     {
@@ -100,6 +116,10 @@ class HttpFile
 
   protected:
     int saveTo(const std::string &pathAndFilename) const;
+    void saveTo(const std::string &pathAndFilename,
+                std::function<void(int)> &&callback) const;
+    std::string getPathAndFilename(const std::string &path) const;
+    std::string getPathAndFilenameOfSaveAs(const std::string &filename) const;
     std::string _fileName;
     std::string _fileContent;
 };
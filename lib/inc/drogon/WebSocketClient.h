@@ -64,6 +64,16 @@ class WebSocketClient
     virtual void setConnectionClosedHandler(
         const std::function<void(const WebSocketClientPtr &)> &callback) = 0;
 
+    /**
+     * @brief Offer the permessage-deflate extension (rfc7692) when connecting
+     * to the server. Messages are compressed only if the server accepts it.
+     *
+     * @param maxWindowBits The max LZ77 window bits (9-15) used by both
+     * sides, smaller windows take less memory but compress less.
+     * @note This method must be called before connecting to the server.
+     */
+    virtual void enableCompression(int maxWindowBits = 15) = 0;
+
     /// Connect to the server.
     virtual void connectToServer(const HttpRequestPtr &request,
                                  const WebSocketRequestCallback &callback) = 0;
@@ -14,6 +14,7 @@
 
 #pragma once
 
+#include <functional>
 #include <memory>
 #include <string>
 #include <drogon/HttpTypes.h>
@@ -21,6 +22,67 @@
 #include <trantor/utils/NonCopyable.h>
 namespace drogon
 {
+/**
+ * @brief A serialized WebSocket frame.
+ *
+ * Frames sent by servers are not masked, so one frame can be serialized once
+ * and sent to any number of connections without being copied or allocated
+ * again, which makes broadcasting cheap.
+ */
+class WebSocketFrame : public trantor::NonCopyable
+{
+  public:
+    /**
+     * @brief Serialize a message into a frame.
+     *
+     * @param msg The message.
+     * @param len The message length.
+     * @param type The message type.
+     */
+    static std::shared_ptr<WebSocketFrame> newFrame(
+        const char *msg,
+        uint64_t len,
+        const WebSocketMessageType &type = WebSocketMessageType::Text);
+
+    static std::shared_ptr<WebSocketFrame> newFrame(
+        const std::string &msg,
+        const WebSocketMessageType &type = WebSocketMessageType::Text)
+    {
+        return newFrame(msg.data(), msg.length(), type);
+    }
+
+    /// Return the whole frame, including the header.
+    const std::string &data() const
+    {
+        return _data;
+    }
+
+    /// Return the payload of the frame.
+    const char *payload() const
+    {
+        return _data.data() + _headerLength;
+    }
+    uint64_t payloadLength() const
+    {
+        return _data.length() - _headerLength;
+    }
+
+    const WebSocketMessageType &type() const
+    {
+        return _type;
+    }
+
+  private:
+    WebSocketFrame() = default;
+    std::string _data;
+    size_t _headerLength = 0;
+    WebSocketMessageType _type = WebSocketMessageType::Text;
+};
+typedef std::shared_ptr<WebSocketFrame> WebSocketFramePtr;
+
+class WebSocketConnection;
+typedef std::shared_ptr<WebSocketConnection> WebSocketConnectionPtr;
+
 /**
  * @brief The WebSocket connection abstract class.
  *
@@ -53,6 +115,16 @@ class WebSocketConnection
         const std::string &msg,
         const WebSocketMessageType &type = WebSocketMessageType::Text) = 0;
 
+    /**
+     * @brief Send a serialized frame to the peer
+     *
+     * The frame is shared instead of being copied, except on client side
+     * connections, which must mask their payloads.
+     *
+     * @param frame The frame made by WebSocketFrame::newFrame().
+     */
+    virtual void sendFrame(const WebSocketFramePtr &frame) = 0;
+
     /// Return the local IP address and port number of the connection
     virtual const trantor::InetAddress &localAddr() const = 0;
 
@@ -72,6 +144,44 @@ class WebSocketConnection
     /// Close the connection
     virtual void forceClose() = 0;
 
+    /**
+     * @brief Set the callback which is called when more than markLen bytes
+     * are waiting in the output buffer, so producers can stop sending until
+     * the write complete callback is called.
+     *
+     * @param callback The function called with the number of buffered bytes.
+     * @param markLen The high water mark.
+     * @note The callback is called in the IO thread of the connection.
+     */
+    virtual void setHighWaterMarkCallback(
+        const std::function<void(const WebSocketConnectionPtr &, size_t)>
+            &callback,
+        size_t markLen) = 0;
+
+    /**
+     * @brief Set the callback which is called when all the data in the output
+     * buffer has been written to the socket.
+     *
+     * @note The callback is called in the IO thread of the connection.
+     */
+    virtual void setWriteCompleteCallback(
+        const std::function<void(const WebSocketConnectionPtr &)>
+            &callback) = 0;
+
+    /// Return the number of bytes which are sent but not written to the
+    /// socket yet. While the output buffer is being drained, the value may be
+    /// larger than the actual one. This method can be called in any thread.
+    virtual size_t bufferedAmount() const = 0;
+
+    /**
+     * @brief Limit the data waiting to be written. Text and binary messages
+     * that would make bufferedAmount() larger than the limit are dropped.
+     *
+     * @param limit The max number of bytes, 0 means no limit, which is the
+     * default.
+     */
+    virtual void setSendQueueLimit(size_t limit) = 0;
+
     /**
      * @brief Set custom data on the connection
      *
@@ -123,14 +233,35 @@ class WebSocketConnection
      * @param interval The sending interval.
      * @note
      * Both the server and the client in Drogon automatically send the pong
-     * message after receiving the ping message.
+     * message after receiving the ping message. Intervals of one second or
+     * more are rounded up to whole seconds, shorter ones are kept.
      */
     virtual void setPingMessage(
         const std::string &message,
         const std::chrono::duration<long double> &interval) = 0;
 
+    /**
+     * @brief Close the connection if no pong message is received in the
+     * timeout after a ping message is sent by setPingMessage().
+     *
+     * @param timeout The timeout, 0 disables it, which is the default.
+     */
+    virtual void setPongTimeout(
+        const std::chrono::duration<long double> &timeout) = 0;
+
+    /**
+     * @brief Close the connection if nothing is received from the peer in the
+     * timeout.
+     *
+     * @param timeout The timeout, 0 disables it, which is the default.
+     * @note The timers of all WebSocket connections in one IO loop are driven
+     * by one timing wheel with a resolution of one second, so the connection
+     * is closed up to one second after the timeout.
+     */
+    virtual void setIdleTimeout(
+        const std::chrono::duration<long double> &timeout) = 0;
+
   private:
     std::shared_ptr<void> _contextPtr;
 };
-typedef std::shared_ptr<WebSocketConnection> WebSocketConnectionPtr;
 }  // namespace drogon
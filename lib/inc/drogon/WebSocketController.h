@@ -50,6 +50,38 @@ class WebSocketControllerBase : public virtual DrObjectBase
                                   std::string &&,
                                   const WebSocketMessageType &) = 0;
 
+    // Return true to receive text and binary messages piece by piece by the
+    // handleNewFragment() method as they arrive, instead of whole messages by
+    // the handleNewMessage() method. Control messages are always received by
+    // the handleNewMessage() method. Because messages are not accumulated in
+    // this mode, their size is not limited by the
+    // client_max_websocket_message_size option.
+    virtual bool isStreaming() const
+    {
+        return false;
+    }
+
+    // This function is called when a piece of a text or binary message is
+    // received in the streaming mode, isFinal is true for the last piece.
+    virtual void handleNewFragment(const WebSocketConnectionPtr &,
+                                   std::string &&,
+                                   const WebSocketMessageType &,
+                                   bool isFinal)
+    {
+        (void)isFinal;
+    }
+
+    // Return true to handle messages in the worker threads instead of the IO
+    // threads, so CPU-heavy handlers don't stall other connections of the
+    // same IO loop. The messages and the close event of one connection are
+    // handled one by one in order, and messages can be sent in any thread.
+    // The number of worker threads is set by the
+    // websocket_worker_threads_num option.
+    virtual bool usesWorkerThreads() const
+    {
+        return false;
+    }
+
     // This function is called after a new connection of WebSocket is
     // established.
     virtual void handleNewConnection(const HttpRequestPtr &,
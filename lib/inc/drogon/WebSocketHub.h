@@ -0,0 +1,116 @@
+/**
+ *
+ *  WebSocketHub.h
+ *  An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#pragma once
+
+#include <drogon/WebSocketConnection.h>
+#include <trantor/utils/NonCopyable.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace drogon
+{
+/**
+ * @brief A publish/subscribe hub of WebSocket connections.
+ *
+ * Subscribers are indexed in the IO loops of their connections, so
+ * subscribing, unsubscribing and delivering messages don't need any lock.
+ * A message is serialized once when published, and one task is queued to
+ * every IO loop with subscribers to send it to the subscribers of the loop.
+ *
+ * Example usage:
+ *
+ * @code
+ * class Feed : public drogon::WebSocketController<Feed>
+ * {
+ *   public:
+ *     virtual void handleNewMessage(const WebSocketConnectionPtr &conn,
+ *                                   std::string &&topic,
+ *                                   const WebSocketMessageType &) override
+ *     {
+ *         _hub.subscribe(conn, topic);
+ *     }
+ *     ...
+ *     // _hub.publish("prices", message) may be called in any thread.
+ *   private:
+ *     WebSocketHub _hub;
+ * };
+ * @endcode
+ *
+ * @note The hub must be created after the number of IO threads is set, for
+ * example as a member of a controller or a plugin. Only connections accepted
+ * by the framework can subscribe.
+ */
+class WebSocketHub : public trantor::NonCopyable
+{
+  public:
+    /// What is done to subscribers whose output buffers are above the high
+    /// water mark.
+    enum class SlowConsumerPolicy
+    {
+        /// Messages for the slow subscriber are dropped.
+        Drop,
+        /// The slow subscriber is disconnected.
+        Disconnect,
+        /// Only the latest message of every topic is kept for the slow
+        /// subscriber, and it's sent when the output buffer is drained.
+        Coalesce
+    };
+
+    /**
+     * @brief Construct a new hub.
+     *
+     * @param policy The policy for slow subscribers.
+     * @param highWaterMark A subscriber is slow when the output buffer of its
+     * connection holds more than this number of bytes.
+     */
+    explicit WebSocketHub(SlowConsumerPolicy policy = SlowConsumerPolicy::Drop,
+                          size_t highWaterMark = 1024 * 1024);
+    ~WebSocketHub();
+
+    /// Subscribe the connection to the topic, this method can be called in
+    /// any thread.
+    void subscribe(const WebSocketConnectionPtr &conn,
+                   const std::string &topic);
+
+    /// Unsubscribe the connection from the topic, this method can be called
+    /// in any thread.
+    void unsubscribe(const WebSocketConnectionPtr &conn,
+                     const std::string &topic);
+
+    /// Unsubscribe the connection from all topics, this method can be called
+    /// in any thread. Connections are unsubscribed automatically when they
+    /// are closed.
+    void unsubscribe(const WebSocketConnectionPtr &conn);
+
+    /// Publish a message to the subscribers of the topic, this method can be
+    /// called in any thread.
+    void publish(const std::string &topic,
+                 const std::string &message,
+                 const WebSocketMessageType &type = WebSocketMessageType::Text)
+    {
+        publish(topic, WebSocketFrame::newFrame(message, type));
+    }
+    void publish(const std::string &topic, const WebSocketFramePtr &frame);
+
+  private:
+    struct LoopData;
+    SlowConsumerPolicy _policy;
+    size_t _highWaterMark;
+    std::vector<std::shared_ptr<LoopData>> _loopData;
+    std::shared_ptr<LoopData> getLoopData(const WebSocketConnectionPtr &conn);
+};
+
+}  // namespace drogon
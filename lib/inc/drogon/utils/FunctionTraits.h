@@ -88,6 +88,19 @@ struct FunctionTraits<
     typedef HttpRequestPtr first_param_type;
 };
 
+// HTTP handling function which takes the request and the callback by value,
+// like a coroutine which uses them after it's suspended
+template <typename ReturnType, typename... Arguments>
+struct FunctionTraits<
+    ReturnType (*)(HttpRequestPtr req,
+                   std::function<void(const HttpResponsePtr &)> callback,
+                   Arguments...)> : FunctionTraits<ReturnType (*)(Arguments...)>
+{
+    static const bool isHTTPFunction = true;
+    typedef void class_type;
+    typedef HttpRequestPtr first_param_type;
+};
+
 template <typename ReturnType, typename... Arguments>
 struct FunctionTraits<
     ReturnType (*)(HttpRequestPtr &req,
@@ -0,0 +1,301 @@
+/**
+ *
+ *  coroutine.h
+ *  An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#pragma once
+
+// The coroutine support is header-only, it's enabled when the application is
+// compiled with C++20 coroutines, whatever the standard of the library is.
+#ifdef __cpp_impl_coroutine
+
+#include <trantor/net/EventLoop.h>
+#include <trantor/utils/Logger.h>
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+namespace drogon
+{
+namespace internal
+{
+struct FinalAwaiter
+{
+    bool await_ready() noexcept
+    {
+        return false;
+    }
+    // Resume the awaiting coroutine without growing the stack.
+    template <typename Promise>
+    std::coroutine_handle<> await_suspend(
+        std::coroutine_handle<Promise> handle) noexcept
+    {
+        auto continuation = handle.promise()._continuation;
+        if (continuation)
+            return continuation;
+        return std::noop_coroutine();
+    }
+    void await_resume() noexcept
+    {
+    }
+};
+
+struct TaskPromiseBase
+{
+    std::suspend_always initial_suspend() noexcept
+    {
+        return {};
+    }
+    FinalAwaiter final_suspend() noexcept
+    {
+        return {};
+    }
+    void unhandled_exception()
+    {
+        _exception = std::current_exception();
+    }
+    std::coroutine_handle<> _continuation;
+    std::exception_ptr _exception;
+};
+
+template <typename T>
+struct TaskPromise : public TaskPromiseBase
+{
+    void return_value(T value)
+    {
+        _value = std::move(value);
+    }
+    T result()
+    {
+        if (_exception)
+            std::rethrow_exception(_exception);
+        return std::move(*_value);
+    }
+    std::optional<T> _value;
+};
+
+template <>
+struct TaskPromise<void> : public TaskPromiseBase
+{
+    void return_void()
+    {
+    }
+    void result()
+    {
+        if (_exception)
+            std::rethrow_exception(_exception);
+    }
+};
+
+/**
+ * @brief The base of the awaiters of callback based methods.
+ *
+ * The coroutine is resumed in the event loop in which it's suspended, so the
+ * code after co_await runs in the same thread as the code before it. If the
+ * coroutine doesn't run in an event loop, it's resumed in the thread of the
+ * callback.
+ */
+template <typename T>
+class CallbackAwaiter
+{
+  public:
+    bool await_ready() noexcept
+    {
+        return false;
+    }
+    T await_resume()
+    {
+        if (_exception)
+            std::rethrow_exception(_exception);
+        return std::move(*_value);
+    }
+
+  protected:
+    // Called at the beginning of the await_suspend() methods.
+    void suspend(std::coroutine_handle<> handle)
+    {
+        _handle = handle;
+        _loop = trantor::EventLoop::getEventLoopOfCurrentThread();
+    }
+    void setValue(T value)
+    {
+        _value = std::move(value);
+    }
+    void setException(const std::exception_ptr &exception)
+    {
+        _exception = exception;
+    }
+    // The awaiter may be destroyed by the resumed coroutine, so it must not
+    // be used after this method is called.
+    void resume()
+    {
+        auto handle = _handle;
+        if (_loop && !_loop->isInLoopThread())
+            _loop->queueInLoop([handle]() { handle.resume(); });
+        else
+            handle.resume();
+    }
+
+  private:
+    std::coroutine_handle<> _handle;
+    trantor::EventLoop *_loop = nullptr;
+    std::optional<T> _value;
+    std::exception_ptr _exception;
+};
+
+}  // namespace internal
+
+/**
+ * @brief A coroutine which returns a value of type T.
+ *
+ * The coroutine starts when the task is awaited by another coroutine, and
+ * the awaiting coroutine is resumed when it returns, exceptions thrown by the
+ * coroutine are thrown by co_await.
+ *
+ * @code
+   Task<int> countUsers(orm::DbClientPtr client)
+   {
+       auto result = co_await client->execSqlCoro("select count(*) from users");
+       co_return result[0][0].as<int>();
+   }
+   @endcode
+ */
+template <typename T = void>
+class [[nodiscard]] Task
+{
+  public:
+    struct promise_type : public internal::TaskPromise<T>
+    {
+        Task get_return_object()
+        {
+            return Task(
+                std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+    };
+
+    Task(Task &&that) noexcept : _handle(std::exchange(that._handle, nullptr))
+    {
+    }
+    Task &operator=(Task &&that) noexcept
+    {
+        if (this != &that)
+        {
+            if (_handle)
+                _handle.destroy();
+            _handle = std::exchange(that._handle, nullptr);
+        }
+        return *this;
+    }
+    Task(const Task &) = delete;
+    Task &operator=(const Task &) = delete;
+    ~Task()
+    {
+        if (_handle)
+            _handle.destroy();
+    }
+
+    bool await_ready() const noexcept
+    {
+        return !_handle || _handle.done();
+    }
+    std::coroutine_handle<> await_suspend(
+        std::coroutine_handle<> awaiting) noexcept
+    {
+        _handle.promise()._continuation = awaiting;
+        return _handle;
+    }
+    T await_resume()
+    {
+        return _handle.promise().result();
+    }
+
+  private:
+    explicit Task(std::coroutine_handle<promise_type> handle) : _handle(handle)
+    {
+    }
+    std::coroutine_handle<promise_type> _handle;
+};
+
+/**
+ * @brief A coroutine which starts at once and can't be awaited.
+ *
+ * It's the entry from callback based code to coroutines, like the handlers
+ * of controllers. Its frame is destroyed when it returns, an exception thrown
+ * out of it is logged.
+ *
+ * A handler of a controller can be a coroutine which returns AsyncTask, all
+ * its parameters must be taken by value since they are used after the
+ * coroutine is suspended.
+ *
+ * @code
+   AsyncTask UserCtrl::getUser(HttpRequestPtr req,
+                               std::function<void(const HttpResponsePtr &)>
+                                   callback,
+                               int userId)
+   {
+       auto resp = co_await _client->sendRequestCoro(req);
+       callback(resp);
+   }
+   @endcode
+ */
+struct AsyncTask
+{
+    struct promise_type
+    {
+        AsyncTask get_return_object() noexcept
+        {
+            return {};
+        }
+        std::suspend_never initial_suspend() noexcept
+        {
+            return {};
+        }
+        std::suspend_never final_suspend() noexcept
+        {
+            return {};
+        }
+        void return_void() noexcept
+        {
+        }
+        void unhandled_exception()
+        {
+            try
+            {
+                throw;
+            }
+            catch (const std::exception &e)
+            {
+                LOG_ERROR << "Unhandled exception in a coroutine: "
+                          << e.what();
+            }
+            catch (...)
+            {
+                LOG_ERROR << "Unhandled exception in a coroutine";
+            }
+        }
+    };
+};
+
+template <typename T>
+struct IsTask : public std::false_type
+{
+};
+template <typename T>
+struct IsTask<Task<T>> : public std::true_type
+{
+};
+
+}  // namespace drogon
+
+#endif
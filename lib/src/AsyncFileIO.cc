@@ -0,0 +1,425 @@
+/**
+ *
+ *  AsyncFileIO.cc
+ *  An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#include "AsyncFileIO.h"
+#include <trantor/utils/Logger.h>
+#include <algorithm>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#ifdef USE_IO_URING
+#include <trantor/net/inner/Channel.h>
+#include <linux/io_uring.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#endif
+
+using namespace drogon;
+
+struct AsyncFileIO::Request
+{
+    int _fd;
+    char *_buf;
+    size_t _len;
+    off_t _offset;
+    bool _isWrite;
+    size_t _done = 0;
+    Callback _callback;
+#ifdef USE_IO_URING
+    struct iovec _iov;
+#endif
+};
+
+AsyncFileIO::AsyncFileIO(trantor::EventLoop *loop, unsigned int entries)
+    : _loop(loop)
+{
+#ifdef USE_IO_URING
+    if (!setupRing(entries))
+    {
+        LOG_WARN << "io_uring is unavailable, file I/O blocks the event loop";
+        closeRing();
+    }
+#else
+    (void)entries;
+#endif
+}
+
+AsyncFileIO::~AsyncFileIO()
+{
+#ifdef USE_IO_URING
+    closeRing();
+#endif
+}
+
+void AsyncFileIO::read(int fd,
+                       char *buf,
+                       size_t len,
+                       off_t offset,
+                       Callback &&cb)
+{
+    std::unique_ptr<Request> request(new Request);
+    request->_fd = fd;
+    request->_buf = buf;
+    request->_len = len;
+    request->_offset = offset;
+    request->_isWrite = false;
+    request->_callback = std::move(cb);
+#ifdef USE_IO_URING
+    if (isAsync())
+    {
+        auto id = _nextId++;
+        auto &req = *request;
+        _requests[id] = std::move(request);
+        submit(id, req);
+        return;
+    }
+#endif
+    doBlocking(*request);
+}
+
+void AsyncFileIO::write(int fd,
+                        const char *buf,
+                        size_t len,
+                        off_t offset,
+                        Callback &&cb)
+{
+    std::unique_ptr<Request> request(new Request);
+    request->_fd = fd;
+    request->_buf = const_cast<char *>(buf);
+    request->_len = len;
+    request->_offset = offset;
+    request->_isWrite = true;
+    request->_callback = std::move(cb);
+#ifdef USE_IO_URING
+    if (isAsync())
+    {
+        auto id = _nextId++;
+        auto &req = *request;
+        _requests[id] = std::move(request);
+        submit(id, req);
+        return;
+    }
+#endif
+    doBlocking(*request);
+}
+
+void AsyncFileIO::doBlocking(Request &request)
+{
+    while (request._done < request._len)
+    {
+        ssize_t n;
+        if (request._isWrite)
+            n = pwrite(request._fd,
+                       request._buf + request._done,
+                       request._len - request._done,
+                       request._offset + request._done);
+        else
+            n = pread(request._fd,
+                      request._buf + request._done,
+                      request._len - request._done,
+                      request._offset + request._done);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            request._callback(-errno);
+            return;
+        }
+        if (n == 0)
+            break;
+        request._done += n;
+    }
+    request._callback(request._done);
+}
+
+#ifdef USE_IO_URING
+bool AsyncFileIO::setupRing(unsigned int entries)
+{
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    _ringFd = syscall(__NR_io_uring_setup, entries, &params);
+    if (_ringFd < 0)
+        return false;
+    _entries = params.sq_entries;
+    _sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    _cqRingSize =
+        params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        _sqRingSize = _cqRingSize = std::max(_sqRingSize, _cqRingSize);
+    }
+    _sqRing = mmap(nullptr,
+                   _sqRingSize,
+                   PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE,
+                   _ringFd,
+                   IORING_OFF_SQ_RING);
+    if (_sqRing == MAP_FAILED)
+    {
+        _sqRing = nullptr;
+        return false;
+    }
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        _cqRing = _sqRing;
+    }
+    else
+    {
+        _cqRing = mmap(nullptr,
+                       _cqRingSize,
+                       PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE,
+                       _ringFd,
+                       IORING_OFF_CQ_RING);
+        if (_cqRing == MAP_FAILED)
+        {
+            _cqRing = nullptr;
+            return false;
+        }
+    }
+    _sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+    auto sqes = mmap(nullptr,
+                     _sqesSize,
+                     PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_POPULATE,
+                     _ringFd,
+                     IORING_OFF_SQES);
+    if (sqes == MAP_FAILED)
+        return false;
+    _sqes = static_cast<struct io_uring_sqe *>(sqes);
+
+    auto sqPtr = static_cast<char *>(_sqRing);
+    _sqHead = reinterpret_cast<unsigned *>(sqPtr + params.sq_off.head);
+    _sqTail = reinterpret_cast<unsigned *>(sqPtr + params.sq_off.tail);
+    _sqMask = reinterpret_cast<unsigned *>(sqPtr + params.sq_off.ring_mask);
+    _sqArray = reinterpret_cast<unsigned *>(sqPtr + params.sq_off.array);
+    auto cqPtr = static_cast<char *>(_cqRing);
+    _cqHead = reinterpret_cast<unsigned *>(cqPtr + params.cq_off.head);
+    _cqTail = reinterpret_cast<unsigned *>(cqPtr + params.cq_off.tail);
+    _cqMask = reinterpret_cast<unsigned *>(cqPtr + params.cq_off.ring_mask);
+    _cqes =
+        reinterpret_cast<struct io_uring_cqe *>(cqPtr + params.cq_off.cqes);
+
+    // Completions are notified to the event loop through an eventfd.
+    _eventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (_eventFd < 0)
+        return false;
+    if (syscall(__NR_io_uring_register,
+                _ringFd,
+                IORING_REGISTER_EVENTFD,
+                &_eventFd,
+                1) < 0)
+        return false;
+    _channelPtr = std::unique_ptr<trantor::Channel>(
+        new trantor::Channel(_loop, _eventFd));
+    _channelPtr->setReadCallback([this]() {
+        uint64_t count;
+        if (::read(_eventFd, &count, sizeof(count)) < 0 && errno != EAGAIN)
+        {
+            LOG_SYSERR << "read eventfd";
+        }
+        handleCompletions();
+    });
+    _loop->runInLoop([this]() { _channelPtr->enableReading(); });
+    return true;
+}
+
+void AsyncFileIO::closeRing()
+{
+    drainRing();
+    if (_channelPtr && _loop->isInLoopThread())
+    {
+        _channelPtr->disableAll();
+        _channelPtr->remove();
+    }
+    _channelPtr.reset();
+    if (_sqes)
+        munmap(_sqes, _sqesSize);
+    if (_cqRing && _cqRing != _sqRing)
+        munmap(_cqRing, _cqRingSize);
+    if (_sqRing)
+        munmap(_sqRing, _sqRingSize);
+    _sqes = nullptr;
+    _sqRing = _cqRing = nullptr;
+    if (_eventFd >= 0)
+        close(_eventFd);
+    _eventFd = -1;
+    if (_ringFd >= 0)
+        close(_ringFd);
+    _ringFd = -1;
+}
+
+void AsyncFileIO::drainRing()
+{
+    // The kernel may still read from or write to the buffers of the requests
+    // in flight, which are owned by their callbacks, so the requests are
+    // only released when their completions are posted. The callbacks are
+    // not called, the objects they refer to may be gone.
+    for (auto id : _waitingIds)
+        _requests.erase(id);
+    _waitingIds.clear();
+    while (!_requests.empty() && _cqRing)
+    {
+        unsigned head = *_cqHead;
+        while (head != __atomic_load_n(_cqTail, __ATOMIC_ACQUIRE))
+        {
+            _requests.erase(_cqes[head & *_cqMask].user_data);
+            ++head;
+            __atomic_store_n(_cqHead, head, __ATOMIC_RELEASE);
+        }
+        if (_requests.empty())
+            break;
+        if (syscall(__NR_io_uring_enter,
+                    _ringFd,
+                    0,
+                    1,
+                    IORING_ENTER_GETEVENTS,
+                    nullptr,
+                    0) < 0 &&
+            errno != EINTR)
+        {
+            LOG_SYSERR << "io_uring_enter";
+            break;
+        }
+    }
+    if (!_requests.empty())
+    {
+        // The buffers are leaked rather than freed while the kernel may
+        // still use them.
+        LOG_ERROR << _requests.size() << " file requests are not finished";
+        for (auto &request : _requests)
+            request.second.release();
+    }
+    _requests.clear();
+}
+
+void AsyncFileIO::submit(uint64_t id, Request &request)
+{
+    // Every entry of the submission queue is counted until its completion
+    // is handled, so neither queue of the ring can overflow.
+    if (_inFlight >= _entries)
+    {
+        _waitingIds.push_back(id);
+        return;
+    }
+    ++_inFlight;
+    unsigned tail = *_sqTail;
+    unsigned index = tail & *_sqMask;
+    auto sqe = &_sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    request._iov.iov_base = request._buf + request._done;
+    request._iov.iov_len = request._len - request._done;
+    sqe->opcode = request._isWrite ? IORING_OP_WRITEV : IORING_OP_READV;
+    sqe->fd = request._fd;
+    sqe->off = request._offset + request._done;
+    sqe->addr = reinterpret_cast<uint64_t>(&request._iov);
+    sqe->len = 1;
+    sqe->user_data = id;
+    _sqArray[index] = index;
+    __atomic_store_n(_sqTail, tail + 1, __ATOMIC_RELEASE);
+    for (;;)
+    {
+        // The entries left by a failed call before are submitted too.
+        unsigned toSubmit =
+            *_sqTail - __atomic_load_n(_sqHead, __ATOMIC_ACQUIRE);
+        if (toSubmit == 0 || syscall(__NR_io_uring_enter,
+                                     _ringFd,
+                                     toSubmit,
+                                     0,
+                                     0,
+                                     nullptr,
+                                     0) >= 0)
+            return;
+        if (errno == EINTR)
+            continue;
+        // EBUSY means the completion queue is full, only this thread can
+        // make room in it.
+        if ((errno == EBUSY || errno == EAGAIN) && handleCompletions() > 0)
+            continue;
+        LOG_SYSERR << "io_uring_enter";
+        break;
+    }
+    unsigned head = __atomic_load_n(_sqHead, __ATOMIC_ACQUIRE);
+    if (static_cast<int>(head - tail) > 0)
+    {
+        // The entry was taken by the kernel after all.
+        return;
+    }
+    // The entry is left in the queue as a no-op whose completion is ignored,
+    // the request is done by blocking calls.
+    sqe->opcode = IORING_OP_NOP;
+    sqe->user_data = 0;
+    auto iter = _requests.find(id);
+    if (iter != _requests.end())
+    {
+        auto req = std::move(iter->second);
+        _requests.erase(iter);
+        doBlocking(*req);
+    }
+}
+
+size_t AsyncFileIO::handleCompletions()
+{
+    size_t count = 0;
+    // The head is read again for every completion because the callbacks
+    // and submit() may handle completions too.
+    for (;;)
+    {
+        unsigned head = *_cqHead;
+        if (head == __atomic_load_n(_cqTail, __ATOMIC_ACQUIRE))
+            break;
+        auto cqe = &_cqes[head & *_cqMask];
+        auto id = cqe->user_data;
+        auto res = cqe->res;
+        __atomic_store_n(_cqHead, head + 1, __ATOMIC_RELEASE);
+        --_inFlight;
+        ++count;
+
+        auto iter = _requests.find(id);
+        if (iter == _requests.end())
+            continue;
+        auto &request = *iter->second;
+        if (res == -EINTR || res == -EAGAIN)
+        {
+            submit(id, request);
+            continue;
+        }
+        if (res > 0)
+        {
+            request._done += res;
+            if (request._done < request._len)
+            {
+                // Short read or write, submit the rest.
+                submit(id, request);
+                continue;
+            }
+        }
+        auto req = std::move(iter->second);
+        _requests.erase(iter);
+        req->_callback(res < 0 ? static_cast<ssize_t>(res)
+                               : static_cast<ssize_t>(req->_done));
+    }
+    while (!_waitingIds.empty() && _inFlight < _entries)
+    {
+        auto id = _waitingIds.front();
+        _waitingIds.pop_front();
+        auto iter = _requests.find(id);
+        if (iter != _requests.end())
+            submit(id, *iter->second);
+    }
+    return count;
+}
+#endif
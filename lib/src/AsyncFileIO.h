@@ -0,0 +1,113 @@
+/**
+ *
+ *  AsyncFileIO.h
+ *  An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#pragma once
+
+#include <drogon/config.h>
+#include <trantor/net/EventLoop.h>
+#include <trantor/utils/NonCopyable.h>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <sys/types.h>
+
+namespace trantor
+{
+class Channel;
+}
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+namespace drogon
+{
+/**
+ * @brief This class reads and writes regular files without blocking the event
+ * loop. When drogon is built with io_uring support (USE_IO_URING) and the
+ * kernel allows it, the requests are submitted to an io_uring instance whose
+ * completions are delivered to the event loop through an eventfd. Otherwise,
+ * the requests are done by blocking pread()/pwrite() calls and the callbacks
+ * are called before the methods return. At most as many requests as the
+ * entries of the ring are in flight, the others wait for their turn.
+ * @note All methods must be called in the thread of the event loop, and the
+ * buffers must be valid until the callbacks are called.
+ */
+class AsyncFileIO : public trantor::NonCopyable
+{
+  public:
+    /// The parameter is the number of bytes transferred, or -errno on
+    /// failure.
+    typedef std::function<void(ssize_t)> Callback;
+
+    explicit AsyncFileIO(trantor::EventLoop *loop, unsigned int entries = 256);
+    ~AsyncFileIO();
+
+    trantor::EventLoop *getLoop() const
+    {
+        return _loop;
+    }
+
+    /// Return true if the requests are done asynchronously.
+    bool isAsync() const
+    {
+        return _ringFd >= 0;
+    }
+
+    /// Read len bytes at the offset of the file into buf, the callback gets
+    /// a number less than len only at the end of the file.
+    void read(int fd, char *buf, size_t len, off_t offset, Callback &&cb);
+
+    /// Write len bytes of buf to the file at the offset.
+    void write(int fd,
+               const char *buf,
+               size_t len,
+               off_t offset,
+               Callback &&cb);
+
+  private:
+    struct Request;
+    trantor::EventLoop *_loop;
+    int _ringFd = -1;
+#ifdef USE_IO_URING
+    int _eventFd = -1;
+    std::unique_ptr<trantor::Channel> _channelPtr;
+    void *_sqRing = nullptr;
+    void *_cqRing = nullptr;
+    size_t _sqRingSize = 0;
+    size_t _cqRingSize = 0;
+    ::io_uring_sqe *_sqes = nullptr;
+    size_t _sqesSize = 0;
+    unsigned *_sqHead = nullptr;
+    unsigned *_sqTail = nullptr;
+    unsigned *_sqMask = nullptr;
+    unsigned *_sqArray = nullptr;
+    unsigned *_cqHead = nullptr;
+    unsigned *_cqTail = nullptr;
+    unsigned *_cqMask = nullptr;
+    ::io_uring_cqe *_cqes = nullptr;
+    unsigned int _entries = 0;
+    uint64_t _nextId = 1;
+    std::unordered_map<uint64_t, std::unique_ptr<Request>> _requests;
+    size_t _inFlight = 0;
+    std::deque<uint64_t> _waitingIds;
+    bool setupRing(unsigned int entries);
+    void closeRing();
+    void drainRing();
+    void submit(uint64_t id, Request &request);
+    size_t handleCompletions();
+#endif
+    void doBlocking(Request &request);
+};
+
+}  // namespace drogon
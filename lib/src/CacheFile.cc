@@ -13,59 +13,151 @@
  */
 
 #include "CacheFile.h"
+#include "AsyncFileIO.h"
+#include "HttpAppFrameworkImpl.h"
 #include <trantor/utils/Logger.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <map>
+#include <mutex>
 #include <unistd.h>
 #include <sys/mman.h>
 
 using namespace drogon;
 
+static const size_t cacheFileBlockSize = 64 * 1024;
+
+struct CacheFile::PendingBlocks
+{
+    std::mutex _mutex;
+    // Keyed by the offsets of the blocks in the file
+    std::map<size_t, std::shared_ptr<std::string>> _blocks;
+};
+
+static void writeAll(int fd, const char *data, size_t length, off_t offset)
+{
+    while (length > 0)
+    {
+        auto n = pwrite(fd, data, length, offset);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            LOG_SYSERR << "pwrite:";
+            return;
+        }
+        data += n;
+        length -= n;
+        offset += n;
+    }
+}
+
 CacheFile::CacheFile(const std::string &path, bool autoDelete)
-    : _autoDelete(autoDelete), _path(path)
+    : _autoDelete(autoDelete),
+      _path(path),
+      _pendingBlocks(std::make_shared<PendingBlocks>())
 {
-    _file = fopen(_path.data(), "w+");
+    _fd = open(_path.data(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+    if (_fd < 0)
+    {
+        LOG_SYSERR << "open " << _path;
+    }
+    _fileIO = HttpAppFrameworkImpl::instance().getAsyncFileIO();
 }
 
 CacheFile::~CacheFile()
 {
+    // The writes in flight don't refer to this object, and io_uring holds
+    // the file they write to, so they're not waited for.
     if (_data)
     {
         munmap(_data, _dataLength);
     }
-    if (_autoDelete && _file)
+    if (_fd >= 0)
     {
-        fclose(_file);
-        unlink(_path.data());
+        close(_fd);
+        if (_autoDelete)
+            unlink(_path.data());
     }
-    else if (_file)
+}
+
+void CacheFile::append(const char *data, size_t length)
+{
+    if (_fd < 0)
+        return;
+    _buffer.append(data, length);
+    if (_buffer.length() >= cacheFileBlockSize)
+        flush();
+}
+
+void CacheFile::flush()
+{
+    if (_buffer.empty())
+        return;
+    auto offset = _length;
+    _length += _buffer.length();
+    if (_fileIO && _fileIO->getLoop()->isInLoopThread())
     {
-        fclose(_file);
+        auto buf = std::make_shared<std::string>(std::move(_buffer));
+        _buffer.clear();
+        {
+            std::lock_guard<std::mutex> lock(_pendingBlocks->_mutex);
+            _pendingBlocks->_blocks[offset] = buf;
+        }
+        _fileIO->write(_fd,
+                       buf->data(),
+                       buf->length(),
+                       offset,
+                       [pendingBlocks = _pendingBlocks, buf, offset](
+                           ssize_t n) {
+                           if (n != static_cast<ssize_t>(buf->length()))
+                           {
+                               LOG_ERROR << "Failed to write a cache file, "
+                                            "result: "
+                                         << n;
+                           }
+                           std::lock_guard<std::mutex> lock(
+                               pendingBlocks->_mutex);
+                           pendingBlocks->_blocks.erase(offset);
+                       });
+        return;
     }
+    writeAll(_fd, _buffer.data(), _buffer.length(), offset);
+    _buffer.clear();
 }
 
-void CacheFile::append(const char *data, size_t length)
+void CacheFile::writePendingBlocks()
 {
-    if (_file)
-        fwrite(data, length, 1, _file);
+    // Waiting for the completions would block the event loop or re-enter it
+    // from a handler, so the blocks still in flight are written again. Both
+    // writes put the same bytes at the same offsets, whichever is last.
+    std::lock_guard<std::mutex> lock(_pendingBlocks->_mutex);
+    for (auto &block : _pendingBlocks->_blocks)
+    {
+        writeAll(_fd,
+                 block.second->data(),
+                 block.second->length(),
+                 static_cast<off_t>(block.first));
+    }
+    _pendingBlocks->_blocks.clear();
 }
 
 size_t CacheFile::length()
 {
-    if (_file)
-        return ftell(_file);
-    return 0;
+    return _length + _buffer.length();
 }
 
 char *CacheFile::data()
 {
-    if (!_file)
+    if (_fd < 0)
         return nullptr;
     if (!_data)
     {
-        fflush(_file);
-        auto fd = fileno(_file);
+        flush();
+        writePendingBlocks();
         _dataLength = length();
         _data = static_cast<char *>(
-            mmap(nullptr, _dataLength, PROT_READ, MAP_SHARED, fd, 0));
+            mmap(nullptr, _dataLength, PROT_READ, MAP_SHARED, _fd, 0));
         if (_data == MAP_FAILED)
         {
             _data = nullptr;
@@ -73,4 +165,4 @@ char *CacheFile::data()
         }
     }
     return _data;
-}
\ No newline at end of file
+}
@@ -16,11 +16,20 @@
 
 #include <drogon/utils/string_view.h>
 #include <trantor/utils/NonCopyable.h>
+#include <memory>
 #include <string>
-#include <stdio.h>
 
 namespace drogon
 {
+class AsyncFileIO;
+
+/**
+ * @brief A temporary file holding a large request body. Data is appended in
+ * 64K blocks through the AsyncFileIO of the current event loop, so spilling
+ * an upload to disk doesn't block the loop when io_uring is available. The
+ * blocks still being written when the data is read are written again by
+ * pwrite(), so reading the data never waits for the event loop.
+ */
 class CacheFile : public trantor::NonCopyable
 {
   public:
@@ -41,10 +50,22 @@ class CacheFile : public trantor::NonCopyable
   private:
     char *data();
     size_t length();
-    FILE *_file = nullptr;
+    void flush();
+    void writePendingBlocks();
+    int _fd = -1;
     bool _autoDelete = true;
     const std::string _path;
     char *_data = nullptr;
     size_t _dataLength = 0;
+    AsyncFileIO *_fileIO = nullptr;
+    // Data not yet written to the file
+    std::string _buffer;
+    // The length of the data passed to the file
+    size_t _length = 0;
+    // The blocks being written by the AsyncFileIO, they're shared with the
+    // callbacks of the writes, which may be called after the file is
+    // destroyed.
+    struct PendingBlocks;
+    std::shared_ptr<PendingBlocks> _pendingBlocks;
 };
 }  // namespace drogon
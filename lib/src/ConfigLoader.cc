@@ -333,6 +333,16 @@ static void loadApp(const Json::Value &app)
         std::cerr << "Error format of client_max_memory_body_size" << std::endl;
         exit(1);
     }
+    auto sendfileThreshold = app.get("sendfile_threshold", "64K").asString();
+    if (bytesSize(sendfileThreshold, size))
+    {
+        drogon::app().setSendfileThreshold(size);
+    }
+    else
+    {
+        std::cerr << "Error format of sendfile_threshold" << std::endl;
+        exit(1);
+    }
     auto maxWsMsgSize =
         app.get("client_max_websocket_message_size", "128K").asString();
     if (bytesSize(maxWsMsgSize, size))
@@ -345,6 +355,20 @@ static void loadApp(const Json::Value &app)
                   << std::endl;
         exit(1);
     }
+    auto maxWindowBits = app.get("websocket_max_window_bits", 15).asInt();
+    if (maxWindowBits < 9 || maxWindowBits > 15)
+    {
+        std::cerr << "The websocket_max_window_bits must be between 9 and 15"
+                  << std::endl;
+        exit(1);
+    }
+    drogon::app().enableWebSocketCompression(
+        app.get("enable_websocket_compression", false).asBool(),
+        maxWindowBits);
+    drogon::app().setWebSocketWorkerThreadNum(
+        app.get("websocket_worker_threads_num", 0).asUInt64());
+    drogon::app().setMaxForwardingConnectionNum(
+        app.get("max_forwarding_connections", 1).asUInt64());
     drogon::app().setHomePage(app.get("home_page", "index.html").asString());
 }
 static void loadDbClients(const Json::Value &dbClients)
@@ -381,6 +405,37 @@ static void loadDbClients(const Json::Value &dbClients)
                                      isFast);
     }
 }
+static void loadUpstreams(const Json::Value &upstreams)
+{
+    if (!upstreams)
+        return;
+    for (auto const &upstream : upstreams)
+    {
+        auto name = upstream.get("name", "").asString();
+        std::vector<std::string> hosts;
+        for (auto const &host : upstream["hosts"])
+        {
+            hosts.push_back(host.asString());
+        }
+        if (name.empty() || hosts.empty())
+        {
+            std::cerr << "Please configure the name and hosts of upstreams in "
+                         "the configuration file"
+                      << std::endl;
+            exit(1);
+        }
+        drogon::app().addUpstreamGroup(
+            name,
+            hosts,
+            upstream.get("balancing", "round_robin").asString(),
+            upstream.get("hash_key", "").asString(),
+            upstream.get("health_check_path", "").asString(),
+            upstream.get("health_check_interval", 5.0).asDouble(),
+            upstream.get("max_fails", 3).asUInt64(),
+            upstream.get("ejection_time", 30.0).asDouble(),
+            upstream.get("retries", 1).asUInt64());
+    }
+}
 static void loadListeners(const Json::Value &listeners)
 {
     if (!listeners)
@@ -412,4 +467,5 @@ void ConfigLoader::load()
     loadSSL(_configJsonRoot["ssl"]);
     loadListeners(_configJsonRoot["listeners"]);
     loadDbClients(_configJsonRoot["db_clients"]);
+    loadUpstreams(_configJsonRoot["upstreams"]);
 }
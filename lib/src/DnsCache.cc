@@ -0,0 +1,98 @@
+/**
+ *
+ *  DnsCache.cc
+ *  An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#include "DnsCache.h"
+#include <trantor/net/Resolver.h>
+#include <trantor/utils/Logger.h>
+
+using namespace drogon;
+
+void DnsCache::resolve(const std::string &domain,
+                       trantor::EventLoop *loop,
+                       Callback &&callback)
+{
+    loop->assertInLoopThread();
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto &entry = _entries[domain];
+        if (entry._expiry > trantor::Date::now())
+        {
+            auto addr = entry._addr;
+            auto expiry = entry._expiry;
+            loop->queueInLoop(
+                [callback = std::move(callback), addr, expiry]() {
+                    callback(addr, expiry);
+                });
+            return;
+        }
+        entry._waiters.emplace_back(loop, std::move(callback));
+        if (entry._resolving)
+            return;
+        entry._resolving = true;
+    }
+    // The resolver of trantor keeps its own cache, which is made as short as
+    // possible so it doesn't outlive the entries of this one. A resolver
+    // runs in the loop it's created with, so every loop has its own.
+    static thread_local std::unordered_map<trantor::EventLoop *,
+                                           std::shared_ptr<trantor::Resolver>>
+        resolvers;
+    auto &resolver = resolvers[loop];
+    if (!resolver)
+        resolver = trantor::Resolver::newResolver(loop, 1);
+    resolver->resolve(domain, [this, domain](const trantor::InetAddress &addr) {
+        onResolved(domain, addr);
+    });
+}
+
+void DnsCache::onResolved(const std::string &domain,
+                          const trantor::InetAddress &addr)
+{
+    std::vector<std::pair<trantor::EventLoop *, Callback>> waiters;
+    trantor::Date expiry;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto &entry = _entries[domain];
+        entry._resolving = false;
+        waiters.swap(entry._waiters);
+        if (addr.ipNetEndian() != 0 || addr.isIpV6())
+        {
+            entry._addr = addr;
+            entry._expiry = trantor::Date::now().after(_ttl);
+            expiry = entry._expiry;
+        }
+        else
+        {
+            LOG_ERROR << "Failed to resolve " << domain;
+        }
+    }
+    for (auto &waiter : waiters)
+    {
+        auto &callback = waiter.second;
+        waiter.first->runInLoop(
+            [callback = std::move(callback), addr, expiry]() {
+                callback(addr, expiry);
+            });
+    }
+}
+
+void DnsCache::setTtl(double ttl)
+{
+    if (ttl <= 0)
+    {
+        LOG_ERROR << "Invalid TTL of the DNS cache: " << ttl;
+        return;
+    }
+    std::lock_guard<std::mutex> lock(_mutex);
+    _ttl = ttl;
+}
@@ -0,0 +1,79 @@
+/**
+ *
+ *  DnsCache.h
+ *  An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#pragma once
+
+#include <trantor/net/EventLoop.h>
+#include <trantor/net/InetAddress.h>
+#include <trantor/utils/Date.h>
+#include <trantor/utils/NonCopyable.h>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace drogon
+{
+/**
+ * @brief The DNS cache shared by all HTTP clients of the process.
+ *
+ * A resolved address is kept for the TTL of the cache, concurrent lookups of
+ * the same name from any loop are merged into one. Failed lookups are not
+ * cached.
+ */
+class DnsCache : public trantor::NonCopyable
+{
+  public:
+    /// The address is zero if the name can't be resolved, the expiry is the
+    /// time when the address should be resolved again.
+    typedef std::function<void(const trantor::InetAddress &addr,
+                               const trantor::Date &expiry)>
+        Callback;
+
+    static DnsCache &instance()
+    {
+        static DnsCache cache;
+        return cache;
+    }
+
+    /// Resolve the domain name, the callback is called in the loop. This
+    /// method must be called in the thread of the loop.
+    void resolve(const std::string &domain,
+                 trantor::EventLoop *loop,
+                 Callback &&callback);
+
+    /// Set the time in seconds for which addresses are cached, the default
+    /// value is 60.
+    void setTtl(double ttl);
+
+  private:
+    DnsCache() = default;
+    struct Entry
+    {
+        trantor::InetAddress _addr;
+        trantor::Date _expiry;
+        bool _resolving = false;
+        std::vector<std::pair<trantor::EventLoop *, Callback>> _waiters;
+    };
+    void onResolved(const std::string &domain,
+                    const trantor::InetAddress &addr);
+
+    std::mutex _mutex;
+    std::unordered_map<std::string, Entry> _entries;
+    double _ttl = 60.0;
+};
+
+}  // namespace drogon
@@ -0,0 +1,246 @@
+/**
+ *
+ *  FileMetadataCache.cc
+ *  An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#include "FileMetadataCache.h"
+#include <trantor/net/inner/Channel.h>
+#include <trantor/utils/Logger.h>
+#include <algorithm>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+
+using namespace drogon;
+
+// Entries which are not watched by inotify are revalidated after this
+// number of seconds.
+static const double validityOfUnwatchedEntries = 1.0;
+
+FileMetadata::~FileMetadata()
+{
+    if (_fd >= 0)
+    {
+        close(_fd);
+        --*_openFiles;
+    }
+}
+
+FileMetadataCache::FileMetadataCache(trantor::EventLoop *loop,
+                                     size_t maxEntries,
+                                     size_t maxOpenFiles)
+    : _loop(loop), _maxEntries(maxEntries), _maxOpenFiles(maxOpenFiles)
+{
+#ifdef __linux__
+    _inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (_inotifyFd < 0)
+    {
+        LOG_SYSERR << "inotify_init1";
+        return;
+    }
+    _channelPtr = std::unique_ptr<trantor::Channel>(
+        new trantor::Channel(loop, _inotifyFd));
+    _channelPtr->setReadCallback([this]() { onInotifyEvents(); });
+    // The cache may be created before the event loop runs in its thread.
+    loop->runInLoop([this]() { _channelPtr->enableReading(); });
+#endif
+}
+
+FileMetadataCache::~FileMetadataCache()
+{
+#ifdef __linux__
+    if (!_channelPtr)
+        return;
+    // The channel is removed in the thread of its loop, and the descriptor
+    // is closed after that, so it can't be reused while it's registered.
+    std::shared_ptr<trantor::Channel> channel = std::move(_channelPtr);
+    auto fd = _inotifyFd;
+    _loop->runInLoop([channel, fd]() {
+        channel->disableAll();
+        channel->remove();
+        close(fd);
+    });
+#endif
+}
+
+FileMetadataPtr FileMetadataCache::getMetadata(const std::string &path)
+{
+    auto iter = _entries.find(path);
+    if (iter != _entries.end())
+    {
+        if (iter->second._watchDescriptor >= 0 ||
+            trantor::Date::date() < iter->second._expiry)
+        {
+            return iter->second._metadata;
+        }
+        invalidate(path);
+    }
+    if (_entries.size() >= _maxEntries)
+    {
+        invalidate(_entries.begin()->first);
+    }
+
+    Entry entry;
+#ifdef __linux__
+    if (_inotifyFd >= 0)
+    {
+        // Add the watch before calling stat(), so any modification after the
+        // stat() call is not missed.
+        entry._watchDescriptor =
+            inotify_add_watch(_inotifyFd,
+                              path.c_str(),
+                              IN_MODIFY | IN_ATTRIB | IN_MOVE_SELF |
+                                  IN_DELETE_SELF);
+    }
+#endif
+    struct stat fileStat;
+    if (stat(path.c_str(), &fileStat) == 0 && S_ISREG(fileStat.st_mode))
+    {
+        auto metadata = std::make_shared<FileMetadata>();
+        metadata->_size = fileStat.st_size;
+        metadata->_mtime = fileStat.st_mtime;
+        metadata->_inode = fileStat.st_ino;
+        struct tm tm1;
+        gmtime_r(&fileStat.st_mtime, &tm1);
+        char buf[64];
+        auto len = strftime(buf, sizeof buf, "%a, %d %b %Y %T GMT", &tm1);
+        metadata->_lastModified.assign(buf, len);
+        len = snprintf(buf,
+                       sizeof buf,
+                       "\"%llx-%llx-%llx\"",
+                       static_cast<long long unsigned int>(fileStat.st_ino),
+                       static_cast<long long unsigned int>(fileStat.st_size),
+                       static_cast<long long unsigned int>(fileStat.st_mtime));
+        metadata->_etag.assign(buf, len);
+        entry._metadata = std::move(metadata);
+    }
+    else if (entry._watchDescriptor >= 0)
+    {
+        // A nonexistent file can't be watched, so the negative result is
+        // revalidated periodically.
+        removeWatch(entry._watchDescriptor, path);
+        entry._watchDescriptor = -1;
+    }
+#ifdef __linux__
+    if (entry._watchDescriptor >= 0)
+    {
+        _watchedPaths[entry._watchDescriptor].push_back(path);
+    }
+#endif
+    entry._expiry = trantor::Date::date().after(validityOfUnwatchedEntries);
+    auto metadata = entry._metadata;
+    _entries[path] = std::move(entry);
+    return metadata;
+}
+
+int FileMetadataCache::openFile(const std::string &path,
+                                const FileMetadataPtr &metadata)
+{
+    if (metadata->_fd >= 0)
+        return metadata->_fd;
+    auto iter = _entries.find(path);
+    if (iter == _entries.end() || iter->second._metadata != metadata ||
+        *_openFiles >= _maxOpenFiles)
+        return -1;
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        LOG_SYSERR << "open " << path;
+        return -1;
+    }
+    // Make sure the opened file is the one described by the metadata.
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) < 0 || fileStat.st_ino != metadata->_inode ||
+        static_cast<size_t>(fileStat.st_size) != metadata->_size)
+    {
+        close(fd);
+        invalidate(path);
+        return -1;
+    }
+    metadata->_fd = fd;
+    metadata->_openFiles = _openFiles;
+    ++*_openFiles;
+    return fd;
+}
+
+void FileMetadataCache::invalidate(const std::string &path)
+{
+    auto iter = _entries.find(path);
+    if (iter == _entries.end())
+        return;
+    if (iter->second._watchDescriptor >= 0)
+        removeWatch(iter->second._watchDescriptor, path);
+    eraseEntry(iter);
+}
+
+void FileMetadataCache::eraseEntry(
+    std::unordered_map<std::string, Entry>::iterator iter)
+{
+    _entries.erase(iter);
+}
+
+void FileMetadataCache::removeWatch(int wd, const std::string &path)
+{
+#ifdef __linux__
+    // Several paths (e.g. hard links) may share one watch descriptor.
+    auto iter = _watchedPaths.find(wd);
+    if (iter != _watchedPaths.end())
+    {
+        auto &paths = iter->second;
+        paths.erase(std::remove(paths.begin(), paths.end(), path),
+                    paths.end());
+        if (!paths.empty())
+            return;
+        _watchedPaths.erase(iter);
+    }
+    inotify_rm_watch(_inotifyFd, wd);
+#else
+    (void)wd;
+    (void)path;
+#endif
+}
+
+#ifdef __linux__
+void FileMetadataCache::onInotifyEvents()
+{
+    alignas(struct inotify_event) char buf[4096];
+    while (true)
+    {
+        auto n = read(_inotifyFd, buf, sizeof buf);
+        if (n <= 0)
+            break;
+        for (char *ptr = buf; ptr < buf + n;)
+        {
+            auto event = reinterpret_cast<struct inotify_event *>(ptr);
+            ptr += sizeof(struct inotify_event) + event->len;
+            auto iter = _watchedPaths.find(event->wd);
+            if (iter == _watchedPaths.end())
+                continue;
+            LOG_TRACE << "file changed, wd=" << event->wd;
+            auto paths = std::move(iter->second);
+            _watchedPaths.erase(iter);
+            for (auto const &path : paths)
+            {
+                auto entryIter = _entries.find(path);
+                if (entryIter != _entries.end())
+                    eraseEntry(entryIter);
+            }
+            if ((event->mask & IN_IGNORED) == 0)
+                inotify_rm_watch(_inotifyFd, event->wd);
+        }
+    }
+}
+#endif
@@ -0,0 +1,106 @@
+/**
+ *
+ *  FileMetadataCache.h
+ *  An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#pragma once
+
+#include <trantor/net/EventLoop.h>
+#include <trantor/utils/Date.h>
+#include <trantor/utils/NonCopyable.h>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <sys/types.h>
+
+namespace trantor
+{
+class Channel;
+}
+
+namespace drogon
+{
+struct FileMetadata
+{
+    ~FileMetadata();
+    size_t _size = 0;
+    time_t _mtime = 0;
+    ino_t _inode = 0;
+    // The value of the Last-Modified header
+    std::string _lastModified;
+    // The strong entity tag built from the inode, the size and the mtime
+    std::string _etag;
+    // The descriptor opened by FileMetadataCache::openFile(), it's closed
+    // when the last reference to the metadata is released.
+    int _fd = -1;
+    // The number of descriptors open by the cache, which is decreased when
+    // the descriptor is closed, possibly in another thread.
+    std::shared_ptr<std::atomic<size_t>> _openFiles;
+};
+typedef std::shared_ptr<FileMetadata> FileMetadataPtr;
+
+/**
+ * @brief This class caches the metadata of static files in an event loop, so
+ * the stat() system call is not made for every request. On Linux, the entries
+ * are invalidated by inotify as soon as the files are modified, moved or
+ * deleted. On other platforms (or when inotify is unavailable), the entries
+ * are revalidated every second.
+ * @note All methods must be called in the thread of the event loop.
+ */
+class FileMetadataCache : public trantor::NonCopyable
+{
+  public:
+    explicit FileMetadataCache(trantor::EventLoop *loop,
+                               size_t maxEntries = 10000,
+                               size_t maxOpenFiles = 1000);
+    ~FileMetadataCache();
+
+    /// Get the metadata of a regular file. nullptr is returned if the file
+    /// doesn't exist.
+    FileMetadataPtr getMetadata(const std::string &path);
+
+    /// Get an open descriptor of the file described by the metadata. The
+    /// descriptor is cached with the metadata and stays open as long as the
+    /// metadata is referenced, so a response holding the metadata always
+    /// sends the same inode. -1 is returned if the file was replaced, or if
+    /// too many descriptors opened by the cache are still open, including
+    /// the ones of evicted entries held by responses.
+    int openFile(const std::string &path, const FileMetadataPtr &metadata);
+
+    void invalidate(const std::string &path);
+
+  private:
+    struct Entry
+    {
+        FileMetadataPtr _metadata;
+        int _watchDescriptor = -1;
+        trantor::Date _expiry;
+    };
+    trantor::EventLoop *_loop;
+    size_t _maxEntries;
+    size_t _maxOpenFiles;
+    std::shared_ptr<std::atomic<size_t>> _openFiles{
+        std::make_shared<std::atomic<size_t>>(0)};
+    std::unordered_map<std::string, Entry> _entries;
+    void eraseEntry(std::unordered_map<std::string, Entry>::iterator iter);
+    void removeWatch(int wd, const std::string &path);
+#ifdef __linux__
+    int _inotifyFd = -1;
+    std::unique_ptr<trantor::Channel> _channelPtr;
+    std::unordered_map<int, std::vector<std::string>> _watchedPaths;
+    void onInotifyEvents();
+#endif
+};
+
+}  // namespace drogon
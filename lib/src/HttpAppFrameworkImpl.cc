@@ -15,6 +15,7 @@
 #include "HttpAppFrameworkImpl.h"
 #include "HttpRequestImpl.h"
 #include "HttpClientImpl.h"
+#include "HttpProxyStream.h"
 #include "HttpResponseImpl.h"
 #include "WebSocketConnectionImpl.h"
 #include "StaticFileRouter.h"
@@ -23,6 +24,7 @@
 #include "WebsocketControllersRouter.h"
 #include "HttpClientImpl.h"
 #include "AOPAdvice.h"
+#include "AsyncFileIO.h"
 #include "ConfigLoader.h"
 #include "HttpServer.h"
 #include "PluginsManager.h"
@@ -30,6 +32,7 @@
 #include "SharedLibManager.h"
 #include "SessionManager.h"
 #include "DbClientManager.h"
+#include "UpstreamGroup.h"
 #include <drogon/config.h>
 #include <algorithm>
 #include <drogon/version.h>
@@ -41,6 +44,7 @@
 #include <drogon/Session.h>
 #include <drogon/utils/Utilities.h>
 #include <trantor/utils/AsyncFileLogger.h>
+#include <trantor/utils/ConcurrentTaskQueue.h>
 #include <json/json.h>
 
 #include <fstream>
@@ -403,6 +407,11 @@ void HttpAppFrameworkImpl::run()
         ioLoops[i]->setIndex(i);
     }
     getLoop()->setIndex(_threadNum);
+    for (size_t i = 0; i <= _threadNum; ++i)
+    {
+        auto loop = i < _threadNum ? ioLoops[i] : getLoop();
+        _asyncFileIOs.emplace_back(new AsyncFileIO(loop));
+    }
     // A fast database client instance should be created in the main event
     // loop, so put the main loop into ioLoops.
     ioLoops.push_back(getLoop());
@@ -412,6 +421,12 @@ void HttpAppFrameworkImpl::run()
     _httpSimpleCtrlsRouterPtr->init(ioLoops);
     _staticFileRouterPtr->init(ioLoops);
     _websockCtrlsRouterPtr->init();
+    _forwardingClients = std::unique_ptr<IOThreadStorage<ForwardingClients>>(
+        new IOThreadStorage<ForwardingClients>());
+    for (auto &group : _upstreamGroups)
+    {
+        group.second->startHealthChecks(getLoop());
+    }
 
     if (_useSession)
     {
@@ -655,6 +670,26 @@ trantor::EventLoop *HttpAppFrameworkImpl::getLoop() const
     return &loop;
 }
 
+AsyncFileIO *HttpAppFrameworkImpl::getAsyncFileIO() const
+{
+    auto index = getCurrentThreadIndex();
+    if (index < _asyncFileIOs.size())
+        return _asyncFileIOs[index].get();
+    return nullptr;
+}
+
+trantor::ConcurrentTaskQueue *HttpAppFrameworkImpl::getWebSocketWorkerQueue()
+{
+    std::call_once(_webSocketWorkerQueueFlag, [this]() {
+        auto threadNum = _webSocketWorkerThreadNum;
+        if (threadNum == 0)
+            threadNum = std::max(std::thread::hardware_concurrency(), 1u);
+        _webSocketWorkerQueue = std::unique_ptr<trantor::ConcurrentTaskQueue>(
+            new trantor::ConcurrentTaskQueue(threadNum, "WebSocketWorkers"));
+    });
+    return _webSocketWorkerQueue.get();
+}
+
 HttpAppFramework &HttpAppFramework::instance()
 {
     return HttpAppFrameworkImpl::instance();
@@ -683,27 +718,103 @@ void HttpAppFrameworkImpl::forward(
     }
     else
     {
-        /// A tiny implementation of a reverse proxy.
-        static std::unordered_map<std::string, HttpClientImplPtr> clientsMap;
-        HttpClientImplPtr clientPtr;
-        static std::mutex mtx;
-        {
-            std::lock_guard<std::mutex> lock(mtx);
-            auto iter = clientsMap.find(hostString);
-            if (iter != clientsMap.end())
-            {
-                clientPtr = iter->second;
-            }
-            else
+        sendForwardingRequest(req, std::move(callback), hostString, false);
+    }
+}
+
+void HttpAppFrameworkImpl::forwardStreaming(
+    const HttpRequestPtr &req,
+    std::function<void(const HttpResponsePtr &)> &&callback,
+    const std::string &hostString)
+{
+    assert(!hostString.empty());
+    sendForwardingRequest(req, std::move(callback), hostString, true);
+}
+
+void HttpAppFrameworkImpl::sendForwardingRequest(
+    const HttpRequestPtr &req,
+    std::function<void(const HttpResponsePtr &)> &&callback,
+    const std::string &hostString,
+    bool streaming)
+{
+    auto iter = _upstreamGroups.find(hostString);
+    if (iter != _upstreamGroups.end())
+    {
+        sendToUpstreamGroup(
+            req,
+            std::make_shared<std::function<void(const HttpResponsePtr &)>>(
+                std::move(callback)),
+            iter->second,
+            streaming,
+            0,
+            -1);
+        return;
+    }
+    sendToHost(req,
+               hostString,
+               streaming,
+               [callback = std::move(callback)](ReqResult result,
+                                                const HttpResponsePtr &resp) {
+                   if (result == ReqResult::Ok)
+                       callback(resp);
+                   else
+                       callback(HttpResponse::newNotFoundResponse());
+               });
+}
+
+void HttpAppFrameworkImpl::sendToUpstreamGroup(
+    const HttpRequestPtr &req,
+    const std::shared_ptr<std::function<void(const HttpResponsePtr &)>>
+        &callbackPtr,
+    const UpstreamGroupPtr &group,
+    bool streaming,
+    size_t retries,
+    size_t lastIndex)
+{
+    auto index = group->choose(req, lastIndex);
+    sendToHost(
+        req,
+        group->hostString(index),
+        streaming,
+        [this, req, callbackPtr, group, streaming, retries, index](
+            ReqResult result, const HttpResponsePtr &resp) {
+            if (result != ReqResult::Ok)
             {
-                clientPtr = std::make_shared<HttpClientImpl>(
-                    trantor::EventLoop::getEventLoopOfCurrentThread()
-                        ? trantor::EventLoop::getEventLoopOfCurrentThread()
-                        : getLoop(),
-                    hostString);
-                clientsMap[hostString] = clientPtr;
+                group->finishRequest(index, false);
+                // Nothing is relayed to the client yet, so the request can
+                // be sent again if it's idempotent.
+                if (retries < group->retries() &&
+                    UpstreamGroup::isIdempotent(req->method()))
+                {
+                    sendToUpstreamGroup(req,
+                                        callbackPtr,
+                                        group,
+                                        streaming,
+                                        retries + 1,
+                                        index);
+                    return;
+                }
+                (*callbackPtr)(HttpResponse::newNotFoundResponse());
+                return;
             }
-        }
+            auto status = resp->statusCode();
+            group->finishRequest(index,
+                                 status != k502BadGateway &&
+                                     status != k503ServiceUnavailable &&
+                                     status != k504GatewayTimeout);
+            (*callbackPtr)(resp);
+        });
+}
+
+void HttpAppFrameworkImpl::sendToHost(const HttpRequestPtr &req,
+                                      const std::string &hostString,
+                                      bool streaming,
+                                      HttpReqCallback &&callback)
+{
+    /// A tiny implementation of a reverse proxy.
+    auto clientPtr = getForwardingClient(hostString);
+    if (!streaming)
+    {
         clientPtr->sendRequest(
             req,
             [callback = std::move(callback)](ReqResult result,
@@ -714,14 +825,74 @@ void HttpAppFrameworkImpl::forward(
                     resp->removeHeader("date");
                     resp->removeHeader("content-length");
                     resp->removeHeader("transfer-encoding");
-                    callback(resp);
                 }
-                else
+                callback(result, resp);
+            });
+        return;
+    }
+    auto stream = std::make_shared<HttpProxyStream>(clientPtr->getLoop());
+    clientPtr->sendStreamingRequest(
+        req,
+        stream,
+        [callback = std::move(callback), stream](ReqResult result,
+                                                 const HttpResponsePtr &resp) {
+            if (result == ReqResult::Ok)
+            {
+                // The framing headers are relayed with the body.
+                resp->removeHeader("server");
+                resp->removeHeader("date");
+                resp->removeHeader("connection");
+                resp->removeHeader("keep-alive");
+                auto respImplPtr = static_cast<HttpResponseImpl *>(resp.get());
+                // The content type of the host is sent as a normal header.
+                resp->setContentTypeCodeAndCustomString(CT_NONE, "");
+                auto status = resp->statusCode();
+                if (respImplPtr->getHeaderBy("content-length").empty() &&
+                    respImplPtr->getHeaderBy("transfer-encoding").empty() &&
+                    status != k204NoContent && status != k304NotModified &&
+                    status >= k200OK)
                 {
-                    callback(HttpResponse::newNotFoundResponse());
+                    // The end of the body is the end of the connection.
+                    resp->setCloseConnection(true);
                 }
-            });
+                respImplPtr->setProxyStream(stream);
+            }
+            callback(result, resp);
+        });
+}
+
+HttpClientImplPtr HttpAppFrameworkImpl::getForwardingClient(
+    const std::string &hostString)
+{
+    auto index = getCurrentThreadIndex();
+    if (_forwardingClients && index <= _threadNum)
+    {
+        // The thread of the framework has its own clients, no lock is needed.
+        auto &clients = _forwardingClients->getThreadData();
+        auto &clientPtr = clients[hostString];
+        if (!clientPtr)
+        {
+            clientPtr = std::make_shared<HttpClientImpl>(
+                trantor::EventLoop::getEventLoopOfCurrentThread(), hostString);
+            clientPtr->setMaxConnectionNum(_maxForwardingConnectionNum);
+        }
+        return clientPtr;
     }
+    // Called in other threads or before the framework runs.
+    static std::unordered_map<std::string, HttpClientImplPtr> clientsMap;
+    static std::mutex mtx;
+    std::lock_guard<std::mutex> lock(mtx);
+    auto &clientPtr = clientsMap[hostString];
+    if (!clientPtr)
+    {
+        clientPtr = std::make_shared<HttpClientImpl>(
+            trantor::EventLoop::getEventLoopOfCurrentThread()
+                ? trantor::EventLoop::getEventLoopOfCurrentThread()
+                : getLoop(),
+            hostString);
+        clientPtr->setMaxConnectionNum(_maxForwardingConnectionNum);
+    }
+    return clientPtr;
 }
 
 orm::DbClientPtr HttpAppFrameworkImpl::getDbClient(const std::string &name)
@@ -758,6 +929,31 @@ HttpAppFramework &HttpAppFrameworkImpl::createDbClient(
     return *this;
 }
 
+HttpAppFramework &HttpAppFrameworkImpl::addUpstreamGroup(
+    const std::string &name,
+    const std::vector<std::string> &hosts,
+    const std::string &balancing,
+    const std::string &hashKey,
+    const std::string &healthCheckPath,
+    const double healthCheckInterval,
+    const size_t maxFails,
+    const double ejectionTime,
+    const size_t retries)
+{
+    assert(!_running);
+    assert(!hosts.empty());
+    _upstreamGroups[name] = std::make_shared<UpstreamGroup>(name,
+                                                            hosts,
+                                                            balancing,
+                                                            hashKey,
+                                                            healthCheckPath,
+                                                            healthCheckInterval,
+                                                            maxFails,
+                                                            ejectionTime,
+                                                            retries);
+    return *this;
+}
+
 void HttpAppFrameworkImpl::quit()
 {
     if (getLoop()->isRunning())
@@ -16,6 +16,7 @@
 
 #include "impl_forwards.h"
 #include <drogon/HttpAppFramework.h>
+#include <drogon/IOThreadStorage.h>
 #include <drogon/config.h>
 #include <memory>
 #include <mutex>
@@ -92,6 +93,11 @@ class HttpAppFrameworkImpl : public HttpAppFramework
                  std::function<void(const HttpResponsePtr &)> &&callback,
                  const std::string &hostString);
 
+    virtual void forwardStreaming(
+        const HttpRequestPtr &req,
+        std::function<void(const HttpResponsePtr &)> &&callback,
+        const std::string &hostString) override;
+
     virtual HttpAppFramework &registerBeginningAdvice(
         const std::function<void()> &advice) override
     {
@@ -229,6 +235,11 @@ class HttpAppFrameworkImpl : public HttpAppFramework
         _useSendfile = sendFile;
         return *this;
     }
+    virtual HttpAppFramework &setSendfileThreshold(size_t threshold) override
+    {
+        _sendfileThreshold = threshold;
+        return *this;
+    }
     virtual HttpAppFramework &enableGzip(bool useGzip) override
     {
         _useGzip = useGzip;
@@ -275,6 +286,36 @@ class HttpAppFrameworkImpl : public HttpAppFramework
         _clientMaxWebSocketMessageSize = maxSize;
         return *this;
     }
+    virtual HttpAppFramework &enableWebSocketCompression(
+        bool enable,
+        int maxWindowBits = 15) override
+    {
+        assert(maxWindowBits >= 9 && maxWindowBits <= 15);
+        _webSocketCompression = enable;
+        _webSocketMaxWindowBits = maxWindowBits;
+        return *this;
+    }
+    virtual HttpAppFramework &setWebSocketWorkerThreadNum(size_t num) override
+    {
+        _webSocketWorkerThreadNum = num;
+        return *this;
+    }
+    virtual HttpAppFramework &setMaxForwardingConnectionNum(
+        size_t num) override
+    {
+        _maxForwardingConnectionNum = num;
+        return *this;
+    }
+    virtual HttpAppFramework &addUpstreamGroup(
+        const std::string &name,
+        const std::vector<std::string> &hosts,
+        const std::string &balancing = "round_robin",
+        const std::string &hashKey = "",
+        const std::string &healthCheckPath = "",
+        const double healthCheckInterval = 5.0,
+        const size_t maxFails = 3,
+        const double ejectionTime = 30.0,
+        const size_t retries = 1) override;
     virtual HttpAppFramework &setHomePage(
         const std::string &homePageFile) override
     {
@@ -297,6 +338,14 @@ class HttpAppFrameworkImpl : public HttpAppFramework
     {
         return _clientMaxWebSocketMessageSize;
     }
+    bool isWebSocketCompressionEnabled() const
+    {
+        return _webSocketCompression;
+    }
+    int getWebSocketMaxWindowBits() const
+    {
+        return _webSocketMaxWindowBits;
+    }
     virtual std::vector<std::tuple<std::string, HttpMethod, std::string>>
     getHandlersInfo() const override;
 
@@ -376,6 +425,17 @@ class HttpAppFrameworkImpl : public HttpAppFramework
     {
         return _useSendfile;
     }
+    size_t sendfileThreshold() const
+    {
+        return _sendfileThreshold;
+    }
+    /// Get the asynchronous file I/O of the current event loop, nullptr is
+    /// returned if the current thread doesn't run an event loop of the
+    /// framework.
+    AsyncFileIO *getAsyncFileIO() const;
+    /// Get the worker threads of WebSocket controllers, they are created when
+    /// this method is called for the first time.
+    trantor::ConcurrentTaskQueue *getWebSocketWorkerQueue();
     void callCallback(
         const HttpRequestImplPtr &req,
         const HttpResponsePtr &resp,
@@ -437,6 +497,9 @@ class HttpAppFrameworkImpl : public HttpAppFramework
     const std::unique_ptr<ListenerManager> _listenerManagerPtr;
     const std::unique_ptr<PluginsManager> _pluginsManagerPtr;
     const std::unique_ptr<orm::DbClientManager> _dbClientManagerPtr;
+    // One instance for each IO loop and the main loop, indexed by the loop
+    // index.
+    std::vector<std::unique_ptr<AsyncFileIO>> _asyncFileIOs;
 
     std::string _rootPath = "./";
     std::string _uploadPath;
@@ -464,10 +527,40 @@ class HttpAppFrameworkImpl : public HttpAppFramework
     size_t _keepaliveRequestsNumber = 0;
     size_t _pipeliningRequestsNumber = 0;
     bool _useSendfile = true;
+    size_t _sendfileThreshold = 64 * 1024;
     bool _useGzip = true;
     size_t _clientMaxBodySize = 1024 * 1024;
     size_t _clientMaxMemoryBodySize = 64 * 1024;
     size_t _clientMaxWebSocketMessageSize = 128 * 1024;
+    bool _webSocketCompression = false;
+    int _webSocketMaxWindowBits = 15;
+    size_t _webSocketWorkerThreadNum = 0;
+    // The clients of the forward() method, keyed by host strings.
+    typedef std::unordered_map<std::string, HttpClientImplPtr>
+        ForwardingClients;
+    std::unique_ptr<IOThreadStorage<ForwardingClients>> _forwardingClients;
+    size_t _maxForwardingConnectionNum = 1;
+    HttpClientImplPtr getForwardingClient(const std::string &hostString);
+    std::unordered_map<std::string, UpstreamGroupPtr> _upstreamGroups;
+    void sendForwardingRequest(
+        const HttpRequestPtr &req,
+        std::function<void(const HttpResponsePtr &)> &&callback,
+        const std::string &hostString,
+        bool streaming);
+    void sendToUpstreamGroup(
+        const HttpRequestPtr &req,
+        const std::shared_ptr<std::function<void(const HttpResponsePtr &)>>
+            &callbackPtr,
+        const UpstreamGroupPtr &group,
+        bool streaming,
+        size_t retries,
+        size_t lastIndex);
+    void sendToHost(const HttpRequestPtr &req,
+                    const std::string &hostString,
+                    bool streaming,
+                    HttpReqCallback &&callback);
+    std::unique_ptr<trantor::ConcurrentTaskQueue> _webSocketWorkerQueue;
+    std::once_flag _webSocketWorkerQueueFlag;
     std::string _homePageFile = "index.html";
     std::unique_ptr<SessionManager> _sessionManagerPtr;
     // Json::Value _customConfig;
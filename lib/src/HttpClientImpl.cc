@@ -16,7 +16,10 @@
 #include "HttpResponseImpl.h"
 #include "HttpRequestImpl.h"
 #include "HttpResponseParser.h"
+#include "DnsCache.h"
 #include "HttpAppFrameworkImpl.h"
+#include "HttpProxyStream.h"
+#include "RequestTimingWheel.h"
 #include <drogon/config.h>
 #include <algorithm>
 #include <stdlib.h>
@@ -25,65 +28,150 @@ using namespace trantor;
 using namespace drogon;
 using namespace std::placeholders;
 
-void HttpClientImpl::createTcpClient()
+constexpr double HttpClientImpl::kDnsRetryInterval;
+
+void HttpClientImpl::createConnection()
 {
     LOG_TRACE << "New TcpClient," << _server.toIpPort();
-    _tcpClient =
+    auto conn = std::make_shared<Connection>();
+    conn->_tcpClient =
         std::make_shared<trantor::TcpClient>(_loop, _server, "httpClient");
 
 #ifdef OpenSSL_FOUND
     if (_useSSL)
     {
-        _tcpClient->enableSSL();
+        conn->_tcpClient->enableSSL();
     }
 #endif
     auto thisPtr = shared_from_this();
     std::weak_ptr<HttpClientImpl> weakPtr = thisPtr;
+    std::weak_ptr<Connection> weakConn = conn;
 
-    _tcpClient->setConnectionCallback(
-        [weakPtr](const trantor::TcpConnectionPtr &connPtr) {
+    conn->_tcpClient->setConnectionCallback(
+        [weakPtr, weakConn](const trantor::TcpConnectionPtr &connPtr) {
             auto thisPtr = weakPtr.lock();
-            if (!thisPtr)
+            auto conn = weakConn.lock();
+            if (!thisPtr || !conn)
                 return;
             if (connPtr->connected())
             {
                 connPtr->setContext(std::make_shared<HttpResponseParser>());
+                conn->_connPtr = connPtr;
+                conn->_lastActive = trantor::Date::now();
                 // send request;
                 LOG_TRACE << "Connection established!";
-                while (thisPtr->_pipeliningCallbacks.size() <=
-                           thisPtr->_pipeliningDepth &&
-                       !thisPtr->_requestsBuffer.empty())
-                {
-                    thisPtr->sendReq(connPtr,
-                                     thisPtr->_requestsBuffer.front().first);
-                    thisPtr->_pipeliningCallbacks.push(
-                        std::move(thisPtr->_requestsBuffer.front()));
-                    thisPtr->_requestsBuffer.pop();
-                }
+                thisPtr->sendRequestsInQueue();
             }
             else
             {
                 LOG_TRACE << "connection disconnect";
-                thisPtr->onError(ReqResult::NetworkFailure);
+                thisPtr->onError(conn, ReqResult::NetworkFailure);
             }
         });
-    _tcpClient->setConnectionErrorCallback([weakPtr]() {
+    conn->_tcpClient->setConnectionErrorCallback([weakPtr, weakConn]() {
         auto thisPtr = weakPtr.lock();
-        if (!thisPtr)
+        auto conn = weakConn.lock();
+        if (!thisPtr || !conn)
             return;
         // can't connect to server
-        thisPtr->onError(ReqResult::BadServerAddress);
+        thisPtr->onError(conn, ReqResult::BadServerAddress);
     });
-    _tcpClient->setMessageCallback(
-        [weakPtr](const trantor::TcpConnectionPtr &connPtr,
-                  trantor::MsgBuffer *msg) {
+    conn->_tcpClient->setMessageCallback(
+        [weakPtr, weakConn](const trantor::TcpConnectionPtr &connPtr,
+                            trantor::MsgBuffer *msg) {
             auto thisPtr = weakPtr.lock();
-            if (thisPtr)
+            auto conn = weakConn.lock();
+            if (thisPtr && conn)
             {
-                thisPtr->onRecvMessage(connPtr, msg);
+                thisPtr->onRecvMessage(conn, connPtr, msg);
             }
         });
-    _tcpClient->connect();
+    _connections.push_back(conn);
+    if (_connections.size() > 1 && _idleTimerId == trantor::InvalidTimerId)
+    {
+        _idleTimerId = _loop->runEvery(_idleTimeout, [weakPtr]() {
+            auto thisPtr = weakPtr.lock();
+            if (thisPtr)
+                thisPtr->closeIdleConnections();
+        });
+    }
+    conn->_tcpClient->connect();
+}
+
+void HttpClientImpl::removeConnection(const ConnectionPtr &conn)
+{
+    auto iter = std::find(_connections.begin(), _connections.end(), conn);
+    if (iter == _connections.end())
+        return;
+    _connections.erase(iter);
+    // Destroy the TcpClient after its callback returns.
+    _loop->queueInLoop([conn]() {});
+}
+
+void HttpClientImpl::closeIdleConnections()
+{
+    auto now = trantor::Date::now();
+    for (auto iter = _connections.begin();
+         iter != _connections.end() && _connections.size() > 1;)
+    {
+        auto &conn = *iter;
+        if (conn->_connPtr && conn->_pipeliningCallbacks.empty() &&
+            conn->_lastActive.after(_idleTimeout) < now)
+        {
+            LOG_TRACE << "Close an idle connection";
+            _loop->queueInLoop([conn]() {});
+            iter = _connections.erase(iter);
+        }
+        else
+        {
+            ++iter;
+        }
+    }
+}
+
+void HttpClientImpl::sendRequestsInQueue()
+{
+    _loop->assertInLoopThread();
+    while (!_requestsBuffer.empty())
+    {
+        // Find the least loaded connection which can take more requests.
+        ConnectionPtr connToSend;
+        size_t connectingNum = 0;
+        for (auto &conn : _connections)
+        {
+            if (!conn->_connPtr)
+            {
+                ++connectingNum;
+                continue;
+            }
+            auto load = conn->_pipeliningCallbacks.size();
+            if (load > _pipeliningDepth)
+                continue;
+            if (!connToSend ||
+                load < connToSend->_pipeliningCallbacks.size())
+                connToSend = conn;
+        }
+        // Grow the pool when all connections are busy, a connection being
+        // established is counted for one of the waiting requests. Requests
+        // are only pipelined behind in-flight responses when the pool can't
+        // grow, otherwise they wait for the connections being established.
+        if ((!connToSend || !connToSend->_pipeliningCallbacks.empty()) &&
+            _connections.size() < _maxConnectionNum)
+        {
+            if (connectingNum < _requestsBuffer.size())
+            {
+                createConnection();
+                continue;
+            }
+            break;
+        }
+        if (!connToSend)
+            break;
+        auto &item = _requestsBuffer.front();
+        sendReq(connToSend->_connPtr, item._req);
+        connToSend->_pipeliningCallbacks.push_back(std::move(item));
+        _requestsBuffer.pop_front();
+    }
 }
 
 HttpClientImpl::HttpClientImpl(trantor::EventLoop *loop,
@@ -183,36 +271,74 @@ HttpClientImpl::HttpClientImpl(trantor::EventLoop *loop,
             }
         }
     }
+    // The address of a domain name is resolved before connecting, and again
+    // when it expires in the DNS cache.
+    _resolveByDns = !_domain.empty() && _server.portNetEndian() != 0 &&
+                    !hasIpAddress();
     LOG_TRACE << "userSSL=" << _useSSL << " domain=" << _domain;
 }
 
 HttpClientImpl::~HttpClientImpl()
 {
     LOG_TRACE << "Deconstruction HttpClient";
+    if (_idleTimerId != trantor::InvalidTimerId)
+        _loop->invalidateTimer(_idleTimerId);
 }
 
 void HttpClientImpl::sendRequest(const drogon::HttpRequestPtr &req,
-                                 const drogon::HttpReqCallback &callback)
+                                 const drogon::HttpReqCallback &callback,
+                                 double timeout)
 {
     auto thisPtr = shared_from_this();
-    _loop->runInLoop([thisPtr, req, callback]() {
-        thisPtr->sendRequestInLoop(req, callback);
+    _loop->runInLoop([thisPtr, req, callback, timeout]() {
+        thisPtr->sendRequestInLoop(req, callback, nullptr, timeout);
     });
 }
 
 void HttpClientImpl::sendRequest(const drogon::HttpRequestPtr &req,
-                                 drogon::HttpReqCallback &&callback)
+                                 drogon::HttpReqCallback &&callback,
+                                 double timeout)
 {
     auto thisPtr = shared_from_this();
-    _loop->runInLoop([thisPtr, req, callback = std::move(callback)]() {
-        thisPtr->sendRequestInLoop(req, callback);
-    });
+    _loop->runInLoop(
+        [thisPtr, req, callback = std::move(callback), timeout]() {
+            thisPtr->sendRequestInLoop(req, callback, nullptr, timeout);
+        });
+}
+
+void HttpClientImpl::sendStreamingRequest(const HttpRequestPtr &req,
+                                          const HttpProxyStreamPtr &stream,
+                                          HttpReqCallback &&callback)
+{
+    auto thisPtr = shared_from_this();
+    _loop->runInLoop(
+        [thisPtr, req, stream, callback = std::move(callback)]() {
+            thisPtr->sendRequestInLoop(req, callback, stream, 0);
+        });
 }
 
 void HttpClientImpl::sendRequestInLoop(const drogon::HttpRequestPtr &req,
-                                       const drogon::HttpReqCallback &callback)
+                                       const drogon::HttpReqCallback &callback,
+                                       const HttpProxyStreamPtr &stream,
+                                       double timeout)
 {
     _loop->assertInLoopThread();
+    if (timeout <= 0)
+        timeout = _timeout;
+    auto deadline = req->deadline().microSecondsSinceEpoch();
+    if (deadline > 0)
+    {
+        double timeLeft =
+            (deadline - trantor::Date::now().microSecondsSinceEpoch()) /
+            1000000.0;
+        if (timeLeft <= 0)
+        {
+            callback(ReqResult::Timeout, nullptr);
+            return;
+        }
+        if (timeout <= 0 || timeLeft < timeout)
+            timeout = timeLeft;
+    }
     req->addHeader("Connection", "Keep-Alive");
     // req->addHeader("Accept", "*/*");
     if (!_domain.empty())
@@ -231,126 +357,142 @@ void HttpClientImpl::sendRequestInLoop(const drogon::HttpRequestPtr &req,
         }
     }
 
-    if (!_tcpClient)
+    auto requestId = ++_nextRequestId;
+    uint64_t timeoutKey = 0;
+    if (timeout > 0)
     {
-        _requestsBuffer.push(
-            {req,
-             [thisPtr = shared_from_this(),
-              callback](ReqResult result, const HttpResponsePtr &response) {
-                 callback(result, response);
-             }});
-        if (!_dns)
+        timeoutKey = RequestTimingWheel::get(_loop)->schedule(
+            shared_from_this(), requestId, timeout);
+    }
+    // The timeout is cancelled when the request is done, the callback of a
+    // streaming response is called with its headers, its timeout is
+    // cancelled when the body ends.
+    _requestsBuffer.push_back(
+        {req,
+         [thisPtr = shared_from_this(), callback, timeoutKey, stream](
+             ReqResult result, const HttpResponsePtr &response) {
+             if (timeoutKey != 0 && (!stream || result != ReqResult::Ok))
+                 RequestTimingWheel::get(thisPtr->_loop)->cancel(timeoutKey);
+             callback(result, response);
+         },
+         stream,
+         requestId,
+         timeoutKey});
+    if (!_dns && _resolveByDns && _dnsExpiry < trantor::Date::now())
+    {
+        // Requests are sent over the existing connections while the name is
+        // resolved again.
+        resolveServer();
+    }
+    if (_connections.empty())
+    {
+        if (_dns)
+            return;
+        if (!hasIpAddress() || _server.portNetEndian() == 0)
         {
-            bool hasIpv6Address = false;
-            if (_server.isIpV6())
+            auto cb = std::move(_requestsBuffer.front()._callback);
+            _requestsBuffer.pop_front();
+            cb(ReqResult::BadServerAddress, nullptr);
+            assert(_requestsBuffer.empty());
+            return;
+        }
+    }
+    sendRequestsInQueue();
+}
+
+bool HttpClientImpl::hasIpAddress() const
+{
+    if (_server.isIpV6())
+    {
+        auto ipaddr = _server.ip6NetEndian();
+        for (int i = 0; i < 4; i++)
+        {
+            if (ipaddr[i] != 0)
             {
-                auto ipaddr = _server.ip6NetEndian();
-                for (int i = 0; i < 4; i++)
-                {
-                    if (ipaddr[i] != 0)
-                    {
-                        hasIpv6Address = true;
-                        break;
-                    }
-                }
+                return true;
             }
+        }
+    }
+    return _server.ipNetEndian() != 0;
+}
 
-            if (_server.ipNetEndian() == 0 && !hasIpv6Address &&
-                !_domain.empty() && _server.portNetEndian() != 0)
+void HttpClientImpl::resolveServer()
+{
+    _dns = true;
+    DnsCache::instance().resolve(
+        _domain,
+        _loop,
+        [thisPtr = shared_from_this()](const trantor::InetAddress &addr,
+                                       const trantor::Date &expiry) {
+            thisPtr->_dns = false;
+            auto port = thisPtr->_server.portNetEndian();
+            if (addr.ipNetEndian() == 0 && !addr.isIpV6())
             {
-                _dns = true;
-                if (!_resolver)
+                if (thisPtr->hasIpAddress())
+                {
+                    // Keep the last address until the name is resolved.
+                    LOG_WARN << "Failed to resolve " << thisPtr->_domain
+                             << " again, use " << thisPtr->_server.toIp();
+                    thisPtr->_dnsExpiry =
+                        trantor::Date::now().after(kDnsRetryInterval);
+                    thisPtr->createPreconnections();
+                    thisPtr->sendRequestsInQueue();
+                    return;
+                }
+                if (!thisPtr->_connections.empty())
+                    return;
+                while (!(thisPtr->_requestsBuffer).empty())
                 {
-                    _resolver = trantor::Resolver::newResolver(_loop);
+                    auto &item = (thisPtr->_requestsBuffer).front();
+                    item._callback(ReqResult::BadServerAddress, nullptr);
+                    (thisPtr->_requestsBuffer).pop_front();
                 }
-                _resolver->resolve(
-                    _domain,
-                    [thisPtr = shared_from_this(),
-                     hasIpv6Address](const trantor::InetAddress &addr) {
-                        thisPtr->_loop->runInLoop([thisPtr,
-                                                   addr,
-                                                   hasIpv6Address]() {
-                            auto port = thisPtr->_server.portNetEndian();
-                            thisPtr->_server = addr;
-                            thisPtr->_server.setPortNetEndian(port);
-                            LOG_TRACE << "dns:domain=" << thisPtr->_domain
-                                      << ";ip=" << thisPtr->_server.toIp();
-                            thisPtr->_dns = false;
-                            if ((thisPtr->_server.ipNetEndian() != 0 ||
-                                 hasIpv6Address) &&
-                                thisPtr->_server.portNetEndian() != 0)
-                            {
-                                thisPtr->createTcpClient();
-                            }
-                            else
-                            {
-                                while (!(thisPtr->_requestsBuffer).empty())
-                                {
-                                    auto &reqAndCb =
-                                        (thisPtr->_requestsBuffer).front();
-                                    reqAndCb.second(ReqResult::BadServerAddress,
-                                                    nullptr);
-                                    (thisPtr->_requestsBuffer).pop();
-                                }
-                                return;
-                            }
-                        });
-                    });
                 return;
             }
+            thisPtr->_server = addr;
+            thisPtr->_server.setPortNetEndian(port);
+            thisPtr->_dnsExpiry = expiry;
+            LOG_TRACE << "dns:domain=" << thisPtr->_domain
+                      << ";ip=" << thisPtr->_server.toIp();
+            thisPtr->createPreconnections();
+            thisPtr->sendRequestsInQueue();
+        });
+}
 
-            if ((_server.ipNetEndian() != 0 || hasIpv6Address) &&
-                _server.portNetEndian() != 0)
-            {
-                createTcpClient();
-            }
-            else
-            {
-                _requestsBuffer.pop();
-                callback(ReqResult::BadServerAddress, nullptr);
-                assert(_requestsBuffer.empty());
-                return;
-            }
-        }
-    }
-    else
-    {
-        // send request;
-        auto connPtr = _tcpClient->connection();
-        auto thisPtr = shared_from_this();
-        if (connPtr && connPtr->connected())
+void HttpClientImpl::preconnect(size_t num)
+{
+    auto thisPtr = shared_from_this();
+    _loop->runInLoop([thisPtr, num]() {
+        thisPtr->_preconnectNum =
+            (std::max)(thisPtr->_preconnectNum,
+                       (std::min)(num, thisPtr->_maxConnectionNum));
+        if (thisPtr->_dns)
+            return;
+        if (thisPtr->_resolveByDns &&
+            thisPtr->_dnsExpiry < trantor::Date::now())
         {
-            if (_pipeliningCallbacks.size() <= _pipeliningDepth &&
-                _requestsBuffer.empty())
-            {
-                sendReq(connPtr, req);
-                _pipeliningCallbacks.push(
-                    {req,
-                     [thisPtr, callback](ReqResult result,
-                                         const HttpResponsePtr &response) {
-                         callback(result, response);
-                     }});
-            }
-            else
-            {
-                _requestsBuffer.push(
-                    {req,
-                     [thisPtr, callback](ReqResult result,
-                                         const HttpResponsePtr &response) {
-                         callback(result, response);
-                     }});
-            }
+            thisPtr->resolveServer();
+            return;
         }
-        else
+        if (!thisPtr->hasIpAddress() ||
+            thisPtr->_server.portNetEndian() == 0)
         {
-            _requestsBuffer.push(
-                {req,
-                 [thisPtr, callback](ReqResult result,
-                                     const HttpResponsePtr &response) {
-                     callback(result, response);
-                 }});
+            LOG_ERROR << "Can't connect to an invalid address: "
+                      << thisPtr->_server.toIpPort();
+            thisPtr->_preconnectNum = 0;
+            return;
         }
+        thisPtr->createPreconnections();
+    });
+}
+
+void HttpClientImpl::createPreconnections()
+{
+    while (_connections.size() < _preconnectNum)
+    {
+        createConnection();
     }
+    _preconnectNum = 0;
 }
 
 void HttpClientImpl::sendReq(const trantor::TcpConnectionPtr &connPtr,
@@ -366,24 +508,30 @@ void HttpClientImpl::sendReq(const trantor::TcpConnectionPtr &connPtr,
     connPtr->send(std::move(buffer));
 }
 
-void HttpClientImpl::onRecvMessage(const trantor::TcpConnectionPtr &connPtr,
+void HttpClientImpl::onRecvMessage(const ConnectionPtr &conn,
+                                   const trantor::TcpConnectionPtr &connPtr,
                                    trantor::MsgBuffer *msg)
 {
     auto responseParser = connPtr->getContext<HttpResponseParser>();
+    auto &pipeliningCallbacks = conn->_pipeliningCallbacks;
 
     // LOG_TRACE << "###:" << msg->readableBytes();
     auto msgSize = msg->readableBytes();
     while (msg->readableBytes() > 0)
     {
-        assert(!_pipeliningCallbacks.empty());
-        auto &firstReq = _pipeliningCallbacks.front();
-        if (firstReq.first->method() == Head)
+        assert(!pipeliningCallbacks.empty());
+        auto &firstReq = pipeliningCallbacks.front();
+        if (firstReq._req->method() == Head)
         {
             responseParser->setForHeadMethod();
         }
+        if (firstReq._stream && !firstReq._headersSent)
+        {
+            setStreamCallbacks(conn, responseParser.get());
+        }
         if (!responseParser->parseResponse(msg))
         {
-            onError(ReqResult::BadResponse);
+            onError(conn, ReqResult::BadResponse);
             _bytesReceived += (msgSize - msg->readableBytes());
             return;
         }
@@ -391,41 +539,45 @@ void HttpClientImpl::onRecvMessage(const trantor::TcpConnectionPtr &connPtr,
         {
             auto resp = responseParser->responseImpl();
             responseParser->reset();
-            assert(!_pipeliningCallbacks.empty());
-            auto &type = resp->getHeaderBy("content-type");
-            if (resp->getHeaderBy("content-encoding") == "gzip")
+            assert(!pipeliningCallbacks.empty());
+            if (!firstReq._stream)
             {
-                resp->gunzip();
-            }
-            if (type.find("application/json") != std::string::npos)
-            {
-                resp->parseJson();
+                // The body is decoded when it's accessed, the JSON object
+                // is parsed by the jsonObject() method.
+                if (!_rawBody &&
+                    resp->getHeaderBy("content-encoding") == "gzip")
+                {
+                    resp->setLazyGunzip();
+                }
+                handleCookies(resp);
             }
             auto cb = std::move(firstReq);
-            _pipeliningCallbacks.pop();
-            handleCookies(resp);
+            pipeliningCallbacks.pop_front();
+            conn->_lastActive = trantor::Date::now();
             _bytesReceived += (msgSize - msg->readableBytes());
             msgSize = msg->readableBytes();
-            cb.second(ReqResult::Ok, resp);
-
-            // LOG_TRACE << "pipelining buffer size=" <<
-            // _pipeliningCallbacks.size(); LOG_TRACE << "requests buffer size="
-            // << _requestsBuffer.size();
-
-            if (!_requestsBuffer.empty())
+            if (resp->ifCloseConnection())
             {
-                auto &reqAndCb = _requestsBuffer.front();
-                sendReq(connPtr, reqAndCb.first);
-                _pipeliningCallbacks.push(std::move(reqAndCb));
-                _requestsBuffer.pop();
-            }
-            else
-            {
-                if (resp->ifCloseConnection() && _pipeliningCallbacks.empty())
+                // No more responses come from the connection, the requests
+                // in the queue are sent over other connections.
+                removeConnection(conn);
+                finishRequest(cb, ReqResult::Ok, resp);
+                while (!pipeliningCallbacks.empty())
                 {
-                    _tcpClient.reset();
+                    auto cb = std::move(pipeliningCallbacks.front());
+                    pipeliningCallbacks.pop_front();
+                    cb._callback(ReqResult::NetworkFailure, nullptr);
                 }
+                sendRequestsInQueue();
+                return;
             }
+            finishRequest(cb, ReqResult::Ok, resp);
+
+            // LOG_TRACE << "pipelining buffer size=" <<
+            // pipeliningCallbacks.size(); LOG_TRACE << "requests buffer size="
+            // << _requestsBuffer.size();
+
+            sendRequestsInQueue();
         }
         else
         {
@@ -446,6 +598,11 @@ HttpClientPtr HttpClient::newHttpClient(const std::string &ip,
         useSSL);
 }
 
+void HttpClient::setDnsCacheTtl(double ttl)
+{
+    DnsCache::instance().setTtl(ttl);
+}
+
 HttpClientPtr HttpClient::newHttpClient(const std::string &hostString,
                                         trantor::EventLoop *loop)
 {
@@ -454,21 +611,180 @@ HttpClientPtr HttpClient::newHttpClient(const std::string &hostString,
         hostString);
 }
 
-void HttpClientImpl::onError(ReqResult result)
+void HttpClientImpl::onError(const ConnectionPtr &conn, ReqResult result)
 {
-    while (!_pipeliningCallbacks.empty())
+    removeConnection(conn);
+    auto &pipeliningCallbacks = conn->_pipeliningCallbacks;
+    if (!pipeliningCallbacks.empty() &&
+        pipeliningCallbacks.front()._headersSent)
+    {
+        // The body of a response without a length ends with the connection.
+        auto responseParser = conn->_connPtr->getContext<HttpResponseParser>();
+        cancelTimeout(pipeliningCallbacks.front());
+        pipeliningCallbacks.front()._stream->onEnd(
+            pipeliningCallbacks.front()._result == ReqResult::Ok &&
+            result == ReqResult::NetworkFailure &&
+            responseParser->waitingForClose());
+        pipeliningCallbacks.pop_front();
+    }
+    while (!pipeliningCallbacks.empty())
     {
-        auto cb = std::move(_pipeliningCallbacks.front());
-        _pipeliningCallbacks.pop();
-        cb.second(result, nullptr);
+        auto cb = std::move(pipeliningCallbacks.front());
+        pipeliningCallbacks.pop_front();
+        cb._callback(cb._result != ReqResult::Ok ? cb._result : result,
+                     nullptr);
     }
+    if (!_connections.empty() || result != ReqResult::BadServerAddress)
+    {
+        // A new connection is established for the requests in the buffer
+        // if there is no other connection.
+        sendRequestsInQueue();
+        return;
+    }
+    // The server can't be reached.
     while (!_requestsBuffer.empty())
     {
-        auto cb = std::move(_requestsBuffer.front().second);
-        _requestsBuffer.pop();
+        auto cb = std::move(_requestsBuffer.front()._callback);
+        _requestsBuffer.pop_front();
         cb(result, nullptr);
     }
-    _tcpClient.reset();
+}
+
+void HttpClientImpl::finishRequest(RequestItem &item,
+                                   ReqResult result,
+                                   const HttpResponseImplPtr &resp)
+{
+    if (item._headersSent)
+    {
+        cancelTimeout(item);
+        item._stream->onEnd(true);
+    }
+    else
+        item._callback(result, resp);
+}
+
+void HttpClientImpl::setStreamCallbacks(const ConnectionPtr &conn,
+                                        HttpResponseParser *parser)
+{
+    // The callbacks are only called in parseResponse() and are cleared when
+    // the response is parsed, the parser is owned by the connection, so no
+    // owning pointers are captured.
+    std::weak_ptr<Connection> weakConn = conn;
+    parser->setStreamCallbacks(
+        [this, weakConn, parser]() {
+            auto conn = weakConn.lock();
+            assert(conn);
+            auto &item = conn->_pipeliningCallbacks.front();
+            item._headersSent = true;
+            // Closing the connection stops the response, the disconnection
+            // is handled by onError().
+            item._stream->setAbortCallback([weakConn]() {
+                auto conn = weakConn.lock();
+                if (conn && conn->_connPtr)
+                    conn->_connPtr->forceClose();
+            });
+            auto resp = parser->responseImpl();
+            handleCookies(resp);
+            item._callback(ReqResult::Ok, resp);
+        },
+        [connRaw = conn.get()](const char *data, size_t len) {
+            connRaw->_pipeliningCallbacks.front()._stream->onData(data, len);
+        });
+}
+
+void HttpClientImpl::cancelRequest(const HttpRequestPtr &req)
+{
+    auto thisPtr = shared_from_this();
+    _loop->runInLoop([thisPtr, req]() {
+        thisPtr->abortRequest(
+            [&req](const RequestItem &item) { return item._req == req; },
+            ReqResult::Cancelled);
+    });
+}
+
+void HttpClientImpl::onRequestTimeout(uint64_t requestId)
+{
+    _loop->assertInLoopThread();
+    // Requests are queued and sent in the order of their ids, so the
+    // request is found by binary search in the buffer and in the pipelines.
+    auto lessThanId = [](const RequestItem &item, uint64_t id) {
+        return item._id < id;
+    };
+    auto iter = std::lower_bound(_requestsBuffer.begin(),
+                                 _requestsBuffer.end(),
+                                 requestId,
+                                 lessThanId);
+    if (iter != _requestsBuffer.end() && iter->_id == requestId)
+    {
+        abortQueuedRequest(iter, ReqResult::Timeout);
+        return;
+    }
+    for (auto &conn : _connections)
+    {
+        auto &pipeliningCallbacks = conn->_pipeliningCallbacks;
+        auto iter = std::lower_bound(pipeliningCallbacks.begin(),
+                                     pipeliningCallbacks.end(),
+                                     requestId,
+                                     lessThanId);
+        if (iter != pipeliningCallbacks.end() && iter->_id == requestId)
+        {
+            abortSentRequest(conn, *iter, ReqResult::Timeout);
+            return;
+        }
+    }
+}
+
+void HttpClientImpl::abortRequest(
+    const std::function<bool(const RequestItem &)> &match,
+    ReqResult result)
+{
+    _loop->assertInLoopThread();
+    for (auto iter = _requestsBuffer.begin(); iter != _requestsBuffer.end();
+         ++iter)
+    {
+        if (match(*iter))
+        {
+            abortQueuedRequest(iter, result);
+            return;
+        }
+    }
+    for (auto &conn : _connections)
+    {
+        for (auto &item : conn->_pipeliningCallbacks)
+        {
+            if (match(item))
+            {
+                abortSentRequest(conn, item, result);
+                return;
+            }
+        }
+    }
+}
+
+void HttpClientImpl::abortQueuedRequest(
+    std::deque<RequestItem>::iterator iter,
+    ReqResult result)
+{
+    auto callback = std::move(iter->_callback);
+    _requestsBuffer.erase(iter);
+    callback(result, nullptr);
+}
+
+void HttpClientImpl::abortSentRequest(ConnectionPtr conn,
+                                      RequestItem &item,
+                                      ReqResult result)
+{
+    LOG_DEBUG << "Close the connection of a request given up";
+    // The response can't be skipped, so the connection is closed, the
+    // requests sent after this one fail too.
+    item._result = result;
+    onError(conn, ReqResult::NetworkFailure);
+}
+
+void HttpClientImpl::cancelTimeout(const RequestItem &item)
+{
+    if (item._timeoutKey != 0)
+        RequestTimingWheel::get(_loop)->cancel(item._timeoutKey);
 }
 
 void HttpClientImpl::handleCookies(const HttpResponseImplPtr &resp)
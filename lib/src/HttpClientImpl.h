@@ -19,9 +19,8 @@
 #include <drogon/Cookie.h>
 #include <trantor/net/EventLoop.h>
 #include <trantor/net/TcpClient.h>
-#include <trantor/net/Resolver.h>
+#include <deque>
 #include <mutex>
-#include <queue>
 #include <vector>
 
 namespace drogon
@@ -35,9 +34,28 @@ class HttpClientImpl : public HttpClient,
                    bool useSSL = false);
     HttpClientImpl(trantor::EventLoop *loop, const std::string &hostString);
     virtual void sendRequest(const HttpRequestPtr &req,
-                             const HttpReqCallback &callback) override;
+                             const HttpReqCallback &callback,
+                             double timeout = 0) override;
     virtual void sendRequest(const HttpRequestPtr &req,
-                             HttpReqCallback &&callback) override;
+                             HttpReqCallback &&callback,
+                             double timeout = 0) override;
+    virtual void cancelRequest(const HttpRequestPtr &req) override;
+    virtual void setTimeout(double timeout) override
+    {
+        _timeout = timeout;
+    }
+    /// Called by the RequestTimingWheel.
+    void onRequestTimeout(uint64_t requestId);
+    /**
+     * @brief Send a request whose response body is relayed to the stream.
+     *
+     * The callback is called with the response when all headers are
+     * received, the response has no body, the bytes of the body (including
+     * the chunk framing) are passed to the stream as they arrive.
+     */
+    void sendStreamingRequest(const HttpRequestPtr &req,
+                              const HttpProxyStreamPtr &stream,
+                              HttpReqCallback &&callback);
     virtual trantor::EventLoop *getLoop() override
     {
         return _loop;
@@ -46,8 +64,21 @@ class HttpClientImpl : public HttpClient,
     {
         _pipeliningDepth = depth;
     }
+    virtual void setMaxConnectionNum(size_t num,
+                                     double idleTimeout = 60.0) override
+    {
+        _maxConnectionNum = num > 0 ? num : 1;
+        _idleTimeout = idleTimeout;
+    }
     ~HttpClientImpl();
 
+    virtual void preconnect(size_t num = 1) override;
+
+    virtual void enableRawBody(bool flag = true) override
+    {
+        _rawBody = flag;
+    }
+
     virtual void enableCookies(bool flag = true) override
     {
         _enableCookies = flag;
@@ -74,28 +105,89 @@ class HttpClientImpl : public HttpClient,
     }
 
   private:
-    std::shared_ptr<trantor::TcpClient> _tcpClient;
+    // A request waiting for its response.
+    struct RequestItem
+    {
+        HttpRequestPtr _req;
+        HttpReqCallback _callback;
+        // Set if the body of the response is relayed to the stream.
+        HttpProxyStreamPtr _stream;
+        uint64_t _id = 0;
+        // The key of the entry in the RequestTimingWheel, 0 if the request
+        // has no timeout.
+        uint64_t _timeoutKey = 0;
+        // Set when the request is given up after it's sent.
+        ReqResult _result = ReqResult::Ok;
+        // Set when the callback is called with the headers of a streaming
+        // response.
+        bool _headersSent = false;
+    };
+    // A keep-alive connection to the server and the requests sent over it.
+    struct Connection
+    {
+        std::shared_ptr<trantor::TcpClient> _tcpClient;
+        // Set when the connection is established.
+        trantor::TcpConnectionPtr _connPtr;
+        std::deque<RequestItem> _pipeliningCallbacks;
+        trantor::Date _lastActive;
+    };
+    typedef std::shared_ptr<Connection> ConnectionPtr;
+
     trantor::EventLoop *_loop;
     trantor::InetAddress _server;
     bool _useSSL;
     void sendReq(const trantor::TcpConnectionPtr &connPtr,
                  const HttpRequestPtr &req);
     void sendRequestInLoop(const HttpRequestPtr &req,
-                           const HttpReqCallback &callback);
+                           const HttpReqCallback &callback,
+                           const HttpProxyStreamPtr &stream,
+                           double timeout);
+    void abortRequest(const std::function<bool(const RequestItem &)> &match,
+                      ReqResult result);
+    void abortQueuedRequest(std::deque<RequestItem>::iterator iter,
+                            ReqResult result);
+    void abortSentRequest(ConnectionPtr conn,
+                          RequestItem &item,
+                          ReqResult result);
+    void cancelTimeout(const RequestItem &item);
     void handleCookies(const HttpResponseImplPtr &resp);
-    void createTcpClient();
-    std::queue<std::pair<HttpRequestPtr, HttpReqCallback>> _pipeliningCallbacks;
-    std::queue<std::pair<HttpRequestPtr, HttpReqCallback>> _requestsBuffer;
-    void onRecvMessage(const trantor::TcpConnectionPtr &, trantor::MsgBuffer *);
-    void onError(ReqResult result);
+    bool hasIpAddress() const;
+    void resolveServer();
+    void createPreconnections();
+    void createConnection();
+    void removeConnection(const ConnectionPtr &conn);
+    void sendRequestsInQueue();
+    void closeIdleConnections();
+    std::vector<ConnectionPtr> _connections;
+    std::deque<RequestItem> _requestsBuffer;
+    void onRecvMessage(const ConnectionPtr &conn,
+                       const trantor::TcpConnectionPtr &,
+                       trantor::MsgBuffer *);
+    void onError(const ConnectionPtr &conn, ReqResult result);
+    void finishRequest(RequestItem &item,
+                       ReqResult result,
+                       const HttpResponseImplPtr &resp);
+    void setStreamCallbacks(const ConnectionPtr &conn,
+                            HttpResponseParser *parser);
     std::string _domain;
     size_t _pipeliningDepth = 0;
+    size_t _maxConnectionNum = 1;
+    double _idleTimeout = 60.0;
+    trantor::TimerId _idleTimerId = trantor::InvalidTimerId;
+    double _timeout = 0;
+    uint64_t _nextRequestId = 0;
     bool _enableCookies = false;
+    bool _rawBody = false;
     std::vector<Cookie> _validCookies;
     size_t _bytesSent = 0;
     size_t _bytesReceived = 0;
+    // True while the name of the server is being resolved.
     bool _dns = false;
-    std::shared_ptr<trantor::Resolver> _resolver;
+    bool _resolveByDns = false;
+    trantor::Date _dnsExpiry;
+    // The number of connections to establish when the address is known.
+    size_t _preconnectNum = 0;
+    static constexpr double kDnsRetryInterval = 5.0;
 };
 typedef std::shared_ptr<HttpClientImpl> HttpClientImplPtr;
 }  // namespace drogon
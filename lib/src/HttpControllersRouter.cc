@@ -556,6 +556,7 @@ void HttpControllersRouter::doControllerHandler(
             if (resp->expiredTime() >= 0 && resp->statusCode() != k404NotFound)
             {
                 // cache the response;
+                static_cast<HttpResponseImpl *>(resp.get())->makeETag();
                 static_cast<HttpResponseImpl *>(resp.get())->makeHeaderString();
                 auto loop = req->getLoop();
                 if (loop->isInLoopThread())
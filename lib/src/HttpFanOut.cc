@@ -0,0 +1,173 @@
+/**
+ *
+ *  HttpFanOut.cc
+ *  An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#include <drogon/HttpFanOut.h>
+#include "HttpAppFrameworkImpl.h"
+#include "HttpRequestImpl.h"
+#include "HttpFileUploadRequest.h"
+
+using namespace drogon;
+
+HttpFanOutPtr HttpFanOut::newHttpFanOut(trantor::EventLoop *loop)
+{
+    if (!loop)
+        loop = trantor::EventLoop::getEventLoopOfCurrentThread();
+    if (!loop)
+        loop = HttpAppFrameworkImpl::instance().getLoop();
+    return std::make_shared<HttpFanOut>(loop);
+}
+
+HttpFanOut::HttpFanOut(trantor::EventLoop *loop) : _loop(loop)
+{
+}
+
+size_t HttpFanOut::addRequest(const HttpRequestPtr &req,
+                              const std::vector<HttpClientPtr> &clients,
+                              double timeout)
+{
+    assert(!clients.empty());
+    Call call;
+    call._req = req;
+    call._clients = clients;
+    call._timeout = timeout;
+    _calls.push_back(std::move(call));
+    return _calls.size() - 1;
+}
+
+void HttpFanOut::send(Callback &&callback)
+{
+    auto thisPtr = shared_from_this();
+    _loop->runInLoop([thisPtr, callback = std::move(callback)]() mutable {
+        thisPtr->_callback = std::move(callback);
+        thisPtr->_results.resize(thisPtr->_calls.size());
+        if (thisPtr->_calls.empty())
+        {
+            thisPtr->complete();
+            return;
+        }
+        for (size_t i = 0; i < thisPtr->_calls.size(); ++i)
+        {
+            auto &call = thisPtr->_calls[i];
+            // The files of upload requests are read when they are sent, so
+            // such requests can't be copied and are not hedged.
+            if (thisPtr->_hedgeDelay > 0 && call._req->method() != Post &&
+                !dynamic_cast<HttpFileUploadRequest *>(call._req.get()))
+            {
+                call._hedgeReq =
+                    std::static_pointer_cast<HttpRequestImpl>(call._req)
+                        ->copy();
+            }
+            thisPtr->sendCall(i, call._req, call._clients[0], call._timeout);
+        }
+        if (thisPtr->_hedgeDelay > 0)
+        {
+            std::weak_ptr<HttpFanOut> weakPtr = thisPtr;
+            thisPtr->_hedgeTimerId =
+                thisPtr->_loop->runAfter(thisPtr->_hedgeDelay, [weakPtr]() {
+                    auto thisPtr = weakPtr.lock();
+                    if (thisPtr)
+                        thisPtr->hedge();
+                });
+        }
+    });
+}
+
+void HttpFanOut::sendCall(size_t index,
+                          const HttpRequestPtr &req,
+                          const HttpClientPtr &client,
+                          double timeout)
+{
+    auto &call = _calls[index];
+    ++call._sent;
+    ++call._pending;
+    auto thisPtr = shared_from_this();
+    client->sendRequest(
+        req,
+        [thisPtr, index](ReqResult result, const HttpResponsePtr &resp) {
+            thisPtr->_loop->runInLoop([thisPtr, index, result, resp]() {
+                thisPtr->onResponse(index, result, resp);
+            });
+        },
+        timeout);
+}
+
+void HttpFanOut::onResponse(size_t index,
+                            ReqResult result,
+                            const HttpResponsePtr &resp)
+{
+    auto &call = _calls[index];
+    --call._pending;
+    if (call._done || _completed)
+        return;
+    // Wait for the other copy if one of them fails.
+    if (result != ReqResult::Ok && call._pending > 0)
+        return;
+    call._done = true;
+    _results[index]._result = result;
+    _results[index]._response = resp;
+    ++_finished;
+    if (result == ReqResult::Ok)
+        ++_succeeded;
+    if (_finished == _calls.size())
+    {
+        complete();
+        return;
+    }
+    if (_quorum == 0)
+        return;
+    if (_succeeded >= _quorum ||
+        _succeeded + (_calls.size() - _finished) < _quorum)
+    {
+        complete();
+    }
+}
+
+void HttpFanOut::hedge()
+{
+    _hedgeTimerId = trantor::InvalidTimerId;
+    if (_completed)
+        return;
+    for (size_t i = 0; i < _calls.size(); ++i)
+    {
+        auto &call = _calls[i];
+        if (call._done || call._pending == 0 || call._sent > 1 ||
+            !call._hedgeReq)
+            continue;
+        double timeout = 0;
+        if (call._timeout > 0)
+        {
+            timeout = call._timeout - _hedgeDelay;
+            if (timeout <= 0)
+                continue;
+        }
+        sendCall(i,
+                 call._hedgeReq,
+                 call._clients[call._sent % call._clients.size()],
+                 timeout);
+    }
+}
+
+void HttpFanOut::complete()
+{
+    _completed = true;
+    if (_hedgeTimerId != trantor::InvalidTimerId)
+    {
+        _loop->invalidateTimer(_hedgeTimerId);
+        _hedgeTimerId = trantor::InvalidTimerId;
+    }
+    auto callback = std::move(_callback);
+    _callback = nullptr;
+    if (callback)
+        callback(_results);
+}
@@ -0,0 +1,137 @@
+/**
+ *
+ *  HttpProxyStream.cc
+ *  An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#include "HttpProxyStream.h"
+#include <trantor/utils/Logger.h>
+#include <limits>
+
+using namespace drogon;
+
+void HttpProxyStream::onData(const char *data, size_t len)
+{
+    _loop->assertInLoopThread();
+    if (_aborted || len == 0)
+        return;
+    if (!_conn)
+    {
+        // The headers of the response are not sent yet.
+        _buffer.append(data, len);
+        if (_buffer.readableBytes() > HTTP_PROXY_MAX_BACKLOG)
+        {
+            LOG_ERROR << "The proxied response is not sent to the client";
+            abort();
+        }
+        return;
+    }
+    if (!_conn->connected())
+    {
+        // The client has gone, stop receiving the body.
+        abort();
+        return;
+    }
+    // TcpConnection::send() copies the data when it's called in another
+    // thread or the data can't be written at once.
+    _conn->send(data, len);
+}
+
+void HttpProxyStream::onEnd(bool success)
+{
+    _loop->assertInLoopThread();
+    if (_ended || _aborted)
+        return;
+    _ended = true;
+    _success = success;
+    if (_conn)
+        finish();
+}
+
+void HttpProxyStream::start(const trantor::TcpConnectionPtr &conn,
+                            std::function<void()> &&finishCallback)
+{
+    auto thisPtr = shared_from_this();
+    _loop->runInLoop([thisPtr,
+                      conn,
+                      finishCallback = std::move(finishCallback)]() mutable {
+        thisPtr->startInLoop(conn, std::move(finishCallback));
+    });
+}
+
+void HttpProxyStream::startInLoop(const trantor::TcpConnectionPtr &conn,
+                                  std::function<void()> &&finishCallback)
+{
+    if (_aborted)
+    {
+        conn->forceClose();
+        return;
+    }
+    _conn = conn;
+    _finishCallback = std::move(finishCallback);
+    // Trantor can't stop reading the upstream connection when the client
+    // is slower than the server, so the backlog is limited instead.
+    std::weak_ptr<HttpProxyStream> weakPtr = shared_from_this();
+    _conn->setHighWaterMarkCallback(
+        [weakPtr](const trantor::TcpConnectionPtr &, size_t) {
+            auto thisPtr = weakPtr.lock();
+            if (thisPtr)
+            {
+                LOG_ERROR << "The client of the proxied response is too slow";
+                thisPtr->abort();
+            }
+        },
+        HTTP_PROXY_MAX_BACKLOG);
+    if (_buffer.readableBytes() > 0)
+    {
+        _conn->send(_buffer.peek(), _buffer.readableBytes());
+        _buffer.retrieveAll();
+    }
+    if (_ended)
+        finish();
+}
+
+void HttpProxyStream::finish()
+{
+    auto conn = std::move(_conn);
+    conn->setHighWaterMarkCallback(
+        [](const trantor::TcpConnectionPtr &, size_t) {},
+        std::numeric_limits<size_t>::max());
+    if (!_success)
+    {
+        // The client can't tell a truncated body from a complete one
+        // unless the connection is closed.
+        conn->forceClose();
+        return;
+    }
+    conn->getLoop()->runInLoop(std::move(_finishCallback));
+}
+
+void HttpProxyStream::abort()
+{
+    auto thisPtr = shared_from_this();
+    // Aborting may destroy the upstream connection, never do it in the
+    // callbacks of the connection.
+    _loop->queueInLoop([thisPtr]() {
+        if (thisPtr->_aborted || thisPtr->_ended)
+            return;
+        thisPtr->_aborted = true;
+        thisPtr->_buffer.retrieveAll();
+        thisPtr->_finishCallback = nullptr;
+        if (thisPtr->_conn)
+        {
+            thisPtr->_conn->forceClose();
+            thisPtr->_conn.reset();
+        }
+        if (thisPtr->_abortCallback)
+            thisPtr->_abortCallback();
+    });
+}
@@ -0,0 +1,93 @@
+/**
+ *
+ *  HttpProxyStream.h
+ *  An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#pragma once
+
+#include "impl_forwards.h"
+#include <trantor/net/EventLoop.h>
+#include <trantor/net/TcpConnection.h>
+#include <trantor/utils/MsgBuffer.h>
+#include <trantor/utils/NonCopyable.h>
+#include <functional>
+#include <memory>
+
+/// The max number of bytes of a relayed body waiting to be sent to the
+/// client, the stream is aborted when it's exceeded.
+#define HTTP_PROXY_MAX_BACKLOG (64 * 1024 * 1024)
+
+namespace drogon
+{
+/**
+ * @brief Relay the body of an upstream response to the downstream connection
+ * while it's being received.
+ *
+ * The upstream side (the HTTP client) calls onData() with the raw bytes of
+ * the body, including the chunk framing, and onEnd() when the response ends.
+ * The downstream side (the HTTP server) calls start() after the headers of
+ * the response are sent, the bytes received before are kept until then.
+ *
+ * All state is kept in the loop of the upstream connection.
+ */
+class HttpProxyStream : public trantor::NonCopyable,
+                        public std::enable_shared_from_this<HttpProxyStream>
+{
+  public:
+    explicit HttpProxyStream(trantor::EventLoop *loop) : _loop(loop)
+    {
+    }
+
+    /// Called by the client when a part of the body is received.
+    void onData(const char *data, size_t len);
+
+    /// Called by the client when the response ends, success is false if the
+    /// upstream connection is broken before the end of the body.
+    void onEnd(bool success);
+
+    /// Set the callback which closes the upstream connection when the
+    /// stream is aborted.
+    void setAbortCallback(std::function<void()> &&callback)
+    {
+        _abortCallback = std::move(callback);
+    }
+
+    /**
+     * @brief Start relaying the body to the downstream connection.
+     *
+     * @param finishCallback is called in the loop of the connection after
+     * the whole body is sent, it's not called if the stream is aborted or
+     * broken, the connection is closed then.
+     */
+    void start(const trantor::TcpConnectionPtr &conn,
+               std::function<void()> &&finishCallback);
+
+    /// Stop the stream and close the upstream connection, it can be called
+    /// in any thread.
+    void abort();
+
+  private:
+    void startInLoop(const trantor::TcpConnectionPtr &conn,
+                     std::function<void()> &&finishCallback);
+    void finish();
+
+    trantor::EventLoop *_loop;
+    trantor::TcpConnectionPtr _conn;
+    std::function<void()> _finishCallback;
+    std::function<void()> _abortCallback;
+    trantor::MsgBuffer _buffer;
+    bool _ended = false;
+    bool _success = false;
+    bool _aborted = false;
+};
+
+}  // namespace drogon
@@ -466,6 +466,28 @@ HttpRequestPtr HttpRequest::newHttpJsonRequest(const Json::Value &data)
     return req;
 }
 
+std::shared_ptr<HttpRequestImpl> HttpRequestImpl::copy() const
+{
+    assert(!dynamic_cast<const HttpFileUploadRequest *>(this));
+    auto req = std::make_shared<HttpRequestImpl>(_loop);
+    req->_method = _method;
+    req->_version = _version;
+    req->_path = _path;
+    req->_query = _query;
+    req->_headers = _headers;
+    req->_cookies = _cookies;
+    req->_flagForParsingParameters = _flagForParsingParameters;
+    req->_parameters = _parameters;
+    req->_deadline = _deadline;
+    req->_expect = _expect;
+    req->_keepAlive = _keepAlive;
+    // A big body received by the server is kept in a cache file.
+    req->_content.assign(bodyData(), bodyLength());
+    req->_contentType = _contentType;
+    req->_contentTypeString = _contentTypeString;
+    return req;
+}
+
 HttpRequestPtr HttpRequest::newFileUploadRequest(
     const std::vector<UploadFile> &files)
 {
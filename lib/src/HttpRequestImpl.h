@@ -67,6 +67,7 @@ class HttpRequestImpl : public HttpRequest
         _contentType = CT_TEXT_PLAIN;
         _contentTypeString.clear();
         _keepAlive = true;
+        _deadline = trantor::Date();
     }
     trantor::EventLoop *getLoop()
     {
@@ -228,6 +229,16 @@ class HttpRequestImpl : public HttpRequest
         _date = date;
     }
 
+    virtual void setDeadline(const trantor::Date &deadline) override
+    {
+        _deadline = deadline;
+    }
+
+    virtual const trantor::Date &deadline() const override
+    {
+        return _deadline;
+    }
+
     void setPeerAddr(const trantor::InetAddress &peer)
     {
         _peer = peer;
@@ -331,6 +342,11 @@ class HttpRequestImpl : public HttpRequest
 
     void appendToBuffer(trantor::MsgBuffer *output) const;
 
+    /// Return a copy of the request which can be sent by a client again, the
+    /// body is copied into memory. Requests with uploaded files must not be
+    /// copied.
+    std::shared_ptr<HttpRequestImpl> copy() const;
+
     virtual SessionPtr session() const override
     {
         return _sessionPtr;
@@ -450,6 +466,7 @@ class HttpRequestImpl : public HttpRequest
     trantor::InetAddress _peer;
     trantor::InetAddress _local;
     trantor::Date _date;
+    trantor::Date _deadline;
     std::unique_ptr<CacheFile> _cacheFilePtr;
     std::string _expect;
     bool _keepAlive = true;
@@ -114,6 +114,20 @@ class HttpRequestParser : public trantor::NonCopyable,
         }
         return *_responseBuffer;
     }
+    /// True while the body of a proxied response is being sent, the
+    /// responses after it are kept in the pending responses until then.
+    bool isStreaming() const
+    {
+        return _streaming;
+    }
+    void setStreaming(bool flag)
+    {
+        _streaming = flag;
+    }
+    std::vector<std::pair<HttpResponsePtr, bool>> &getPendingResponses()
+    {
+        return _pendingResponses;
+    }
     std::vector<HttpRequestImplPtr> &getRequestBuffer()
     {
         assert(_loop->isInLoopThread());
@@ -143,6 +157,8 @@ class HttpRequestParser : public trantor::NonCopyable,
     std::unique_ptr<std::vector<std::pair<HttpResponsePtr, bool>>>
         _responseBuffer;
     std::unique_ptr<std::vector<HttpRequestImplPtr>> _requestBuffer;
+    bool _streaming = false;
+    std::vector<std::pair<HttpResponsePtr, bool>> _pendingResponses;
     std::vector<HttpRequestImplPtr> _requestsPool;
 };
 
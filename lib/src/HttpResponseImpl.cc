@@ -17,10 +17,11 @@
 #include "HttpUtils.h"
 #include <drogon/HttpViewData.h>
 #include <drogon/IOThreadStorage.h>
-#include <fstream>
 #include <memory>
 #include <stdio.h>
+#include <fcntl.h>
 #include <sys/stat.h>
+#include <unistd.h>
 #include <trantor/utils/Logger.h>
 
 using namespace trantor;
@@ -149,48 +150,30 @@ HttpResponsePtr HttpResponse::newFileResponse(
     const std::string &attachmentFileName,
     ContentType type)
 {
-    std::ifstream infile(fullPath, std::ifstream::binary);
     LOG_TRACE << "send http file:" << fullPath;
-    if (!infile)
+    struct stat fileStat;
+    if (stat(fullPath.c_str(), &fileStat) < 0 || !S_ISREG(fileStat.st_mode))
     {
         auto resp = HttpResponse::newNotFoundResponse();
         return resp;
     }
-    auto resp = std::make_shared<HttpResponseImpl>();
-    std::streambuf *pbuf = infile.rdbuf();
-    std::streamsize filesize = pbuf->pubseekoff(0, infile.end);
-    pbuf->pubseekoff(0, infile.beg);  // rewind
-    if (HttpAppFrameworkImpl::instance().useSendfile() && filesize > 1024 * 200)
-    // TODO : Is 200k an appropriate value? Or set it to be configurable
-    {
-        // The advantages of sendfile() can only be reflected in sending large
-        // files.
-        resp->setSendfile(fullPath);
-    }
-    else
-    {
-        std::string str;
-        str.resize(filesize);
-        pbuf->sgetn(&str[0], filesize);
-        resp->setBody(std::move(str));
-    }
-    resp->setStatusCode(k200OK);
-
     if (type == CT_NONE)
     {
         if (!attachmentFileName.empty())
         {
-            resp->setContentTypeCode(
-                drogon::getContentType(attachmentFileName));
+            type = drogon::getContentType(attachmentFileName);
         }
         else
         {
-            resp->setContentTypeCode(drogon::getContentType(fullPath));
+            type = drogon::getContentType(fullPath);
         }
     }
-    else
+    auto resp = HttpResponseImpl::newSizedFileResponse(fullPath,
+                                                       fileStat.st_size,
+                                                       type);
+    if (!resp)
     {
-        resp->setContentTypeCode(type);
+        return HttpResponse::newNotFoundResponse();
     }
 
     if (!attachmentFileName.empty())
@@ -202,6 +185,101 @@ HttpResponsePtr HttpResponse::newFileResponse(
     return resp;
 }
 
+void HttpResponseImpl::setSendfileDescriptor(
+    int fd,
+    const std::shared_ptr<void> &holder)
+{
+#ifdef __linux__
+    // trantor opens the file by name for every response, opening the /proc
+    // entry of the descriptor doesn't save that, but it always sends the
+    // inode described by the cached metadata, even if the path has been
+    // replaced. The path is kept if /proc is not mounted (e.g. in a chroot).
+    static const bool procFdAccessible = access("/proc/self/fd", X_OK) == 0;
+    if (!procFdAccessible)
+        return;
+    _sendfileName = "/proc/self/fd/" + std::to_string(fd);
+    _fileHolder = holder;
+#else
+    (void)fd;
+    (void)holder;
+#endif
+}
+
+HttpResponsePtr HttpResponseImpl::newSizedFileResponse(
+    const std::string &fullPath,
+    size_t fileSize,
+    ContentType type)
+{
+    auto &app = HttpAppFrameworkImpl::instance();
+    auto resp = std::make_shared<HttpResponseImpl>();
+    if (app.useSendfile() && fileSize > app.sendfileThreshold())
+    {
+        // The advantages of sendfile() can only be reflected in sending large
+        // files.
+        resp->setSendfile(fullPath, fileSize);
+    }
+    else
+    {
+        int fd = open(fullPath.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+        {
+            return nullptr;
+        }
+        // The file is read into the body instead of being mapped, a mapping
+        // kept by the cached response would crash the process with SIGBUS
+        // if the file were truncated in place.
+        std::string str;
+        str.resize(fileSize);
+        size_t offset = 0;
+        while (offset < fileSize)
+        {
+            auto n = read(fd, &str[offset], fileSize - offset);
+            if (n <= 0)
+                break;
+            offset += n;
+        }
+        str.resize(offset);
+        resp->setBody(std::move(str));
+        close(fd);
+    }
+    resp->setStatusCode(k200OK);
+    resp->setContentTypeCode(type);
+    return resp;
+}
+
+void HttpResponseImpl::makeETag()
+{
+    if (!_sendfileName.empty() || _headers.find("etag") != _headers.end())
+        return;
+    generateBodyFromJson();
+    const char *body = nullptr;
+    size_t bodyLength = 0;
+    if (_bodyPtr)
+    {
+        body = _bodyPtr->data();
+        bodyLength = _bodyPtr->length();
+    }
+    else if (_bodyViewPtr)
+    {
+        body = _bodyViewPtr->data();
+        bodyLength = _bodyViewPtr->length();
+    }
+    // 64-bit FNV-1a, fast enough to be computed once per cached body.
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < bodyLength; ++i)
+    {
+        hash ^= static_cast<unsigned char>(body[i]);
+        hash *= 1099511628211ULL;
+    }
+    char buf[64];
+    auto len = snprintf(buf,
+                        sizeof buf,
+                        "\"%llx-%llx\"",
+                        static_cast<long long unsigned int>(bodyLength),
+                        static_cast<long long unsigned int>(hash));
+    addHeader("ETag", std::string(buf, len));
+}
+
 void HttpResponseImpl::makeHeaderString(
     const std::shared_ptr<std::string> &headerStringPtr)
 {
@@ -213,7 +291,12 @@ void HttpResponseImpl::makeHeaderString(
         headerStringPtr->append(_statusMessage.data(), _statusMessage.length());
     headerStringPtr->append("\r\n");
     generateBodyFromJson();
-    if (_sendfileName.empty())
+    if (_proxyStream)
+    {
+        // The framing headers of the upstream response are kept.
+        len = 0;
+    }
+    else if (_sendfileName.empty())
     {
         long unsigned int bodyLength =
             _bodyPtr ? _bodyPtr->length()
@@ -222,16 +305,10 @@ void HttpResponseImpl::makeHeaderString(
     }
     else
     {
-        struct stat filestat;
-        if (stat(_sendfileName.c_str(), &filestat) < 0)
-        {
-            LOG_SYSERR << _sendfileName << " stat error";
-            return;
-        }
         len = snprintf(buf,
                        sizeof buf,
                        "Content-Length: %llu\r\n",
-                       static_cast<long long unsigned int>(filestat.st_size));
+                       static_cast<long long unsigned int>(_sendfileSize));
     }
 
     headerStringPtr->append(buf, len);
@@ -291,17 +368,10 @@ void HttpResponseImpl::renderToBuffer(trantor::MsgBuffer &buffer)
         }
         else
         {
-            struct stat filestat;
-            if (stat(_sendfileName.c_str(), &filestat) < 0)
-            {
-                LOG_SYSERR << _sendfileName << " stat error";
-                return;
-            }
-            len =
-                snprintf(buf,
-                         sizeof buf,
-                         "Content-Length: %llu\r\n",
-                         static_cast<long long unsigned int>(filestat.st_size));
+            len = snprintf(buf,
+                           sizeof buf,
+                           "Content-Length: %llu\r\n",
+                           static_cast<long long unsigned int>(_sendfileSize));
         }
 
         buffer.append(buf, len);
@@ -593,6 +663,7 @@ void HttpResponseImpl::swap(HttpResponseImpl &that) noexcept
     _fullHeaderString.swap(that._fullHeaderString);
     _httpString.swap(that._httpString);
     swap(_datePos, that._datePos);
+    _gunzippedBody.swap(that._gunzippedBody);
 }
 
 void HttpResponseImpl::clear()
@@ -610,6 +681,22 @@ void HttpResponseImpl::clear()
     _jsonPtr.reset();
     _expriedTime = -1;
     _datePos = std::string::npos;
+    _proxyStream.reset();
+    _gunzippedBody.reset();
+}
+
+const std::string &HttpResponseImpl::gunzippedBody() const
+{
+    auto gunzipped = _gunzippedBody.get();
+    std::call_once(gunzipped->_once, [this, gunzipped]() {
+        if (_bodyPtr)
+            gunzipped->_body = utils::gzipDecompress(_bodyPtr->data(),
+                                                     _bodyPtr->length());
+        else if (_bodyViewPtr)
+            gunzipped->_body = utils::gzipDecompress(_bodyViewPtr->data(),
+                                                     _bodyViewPtr->length());
+    });
+    return gunzipped->_body;
 }
 
 void HttpResponseImpl::parseJson() const
@@ -620,7 +707,19 @@ void HttpResponseImpl::parseJson() const
     _jsonPtr = std::make_shared<Json::Value>();
     JSONCPP_STRING errs;
     std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
-    if (_bodyPtr)
+    if (_gunzippedBody)
+    {
+        auto &body = gunzippedBody();
+        if (!reader->parse(body.data(),
+                           body.data() + body.size(),
+                           _jsonPtr.get(),
+                           &errs))
+        {
+            LOG_ERROR << errs;
+            _jsonPtr.reset();
+        }
+    }
+    else if (_bodyPtr)
     {
         if (!reader->parse(_bodyPtr->data(),
                            _bodyPtr->data() + _bodyPtr->size(),
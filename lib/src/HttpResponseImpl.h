@@ -28,6 +28,8 @@
 
 namespace drogon
 {
+class HttpProxyStream;
+
 class HttpResponseImpl : public HttpResponse
 {
     friend class HttpResponseParser;
@@ -221,11 +223,13 @@ class HttpResponseImpl : public HttpResponse
     {
         _bodyPtr = std::make_shared<std::string>(body);
         _bodyViewPtr.reset();
+        _gunzippedBody.reset();
     }
     virtual void setBody(std::string &&body) override
     {
         _bodyPtr = std::make_shared<std::string>(std::move(body));
         _bodyViewPtr.reset();
+        _gunzippedBody.reset();
     }
 
     void redirect(const std::string &url)
@@ -250,6 +254,8 @@ class HttpResponseImpl : public HttpResponse
 
     virtual const std::string &body() const override
     {
+        if (_gunzippedBody)
+            return gunzippedBody();
         if (!_bodyPtr)
         {
             if (_bodyViewPtr)
@@ -267,6 +273,9 @@ class HttpResponseImpl : public HttpResponse
     }
     virtual std::string &body() override
     {
+        // The body may be modified, so it's decompressed in place.
+        if (_gunzippedBody)
+            gunzip();
         if (!_bodyPtr)
         {
             if (_bodyViewPtr)
@@ -308,18 +317,58 @@ class HttpResponseImpl : public HttpResponse
     {
         return _sendfileName;
     }
-    void setSendfile(const std::string &filename)
+    size_t sendfileSize() const
     {
-        _sendfileName = filename;
+        return _sendfileSize;
     }
+    void setSendfile(const std::string &filename, size_t fileSize)
+    {
+        _sendfileName = filename;
+        _sendfileSize = fileSize;
+    }
+    /// Send the file through a descriptor which is already open, the holder
+    /// keeps the descriptor open as long as the response is alive. This
+    /// only works on Linux when /proc is mounted, the file is sent by its
+    /// path otherwise.
+    void setSendfileDescriptor(int fd, const std::shared_ptr<void> &holder);
+    /// Relay the body of the response from an upstream server, the headers
+    /// of the response are sent as they are received and the body is sent
+    /// by the stream.
+    void setProxyStream(const std::shared_ptr<HttpProxyStream> &stream)
+    {
+        _proxyStream = stream;
+    }
+    const std::shared_ptr<HttpProxyStream> &proxyStream() const
+    {
+        return _proxyStream;
+    }
+    /// Create a response of a file whose size is already known, so the file
+    /// is not opened or stat()ed when it's sent by sendfile. nullptr is
+    /// returned if the file can't be read.
+    static HttpResponsePtr newSizedFileResponse(const std::string &fullPath,
+                                                size_t fileSize,
+                                                ContentType type);
+    /// Add a strong ETag generated from a hash of the body unless the
+    /// response already has one, it's used for cached responses.
+    void makeETag();
     void makeHeaderString()
     {
         _fullHeaderString = std::make_shared<std::string>();
         makeHeaderString(_fullHeaderString);
     }
 
+    /// Decompress the gzip body when it's accessed by the const methods for
+    /// the first time. The decompressed body is kept aside, so the received
+    /// body and its content-encoding header stay as they are and the const
+    /// methods can be called in several threads. The non-const body()
+    /// method decompresses the body in place and removes the header.
+    void setLazyGunzip()
+    {
+        _gunzippedBody = std::make_shared<GunzippedBody>();
+    }
     void gunzip()
     {
+        _gunzippedBody.reset();
         if (_bodyPtr)
         {
             auto gunzipBody =
@@ -345,6 +394,7 @@ class HttpResponseImpl : public HttpResponse
     {
         _bodyViewPtr = std::make_shared<string_view>(body, len);
         _bodyPtr.reset();
+        _gunzippedBody.reset();
     }
     std::unordered_map<std::string, std::string> _headers;
     std::unordered_map<std::string, Cookie> _cookies;
@@ -362,6 +412,9 @@ class HttpResponseImpl : public HttpResponse
     std::shared_ptr<string_view> _bodyViewPtr;
     ssize_t _expriedTime = -1;
     std::string _sendfileName;
+    size_t _sendfileSize = 0;
+    std::shared_ptr<void> _fileHolder;
+    std::shared_ptr<HttpProxyStream> _proxyStream;
     mutable std::shared_ptr<Json::Value> _jsonPtr;
 
     std::shared_ptr<std::string> _fullHeaderString;
@@ -370,6 +423,13 @@ class HttpResponseImpl : public HttpResponse
     mutable std::string::size_type _datePos = std::string::npos;
     mutable int64_t _httpStringDate = -1;
     mutable bool _flagForParsingJson = false;
+    struct GunzippedBody
+    {
+        std::once_flag _once;
+        std::string _body;
+    };
+    std::shared_ptr<GunzippedBody> _gunzippedBody;
+    const std::string &gunzippedBody() const;
     ContentType _contentType = CT_TEXT_HTML;
     string_view _contentTypeString =
         "Content-Type: text/html; charset=utf-8\r\n";
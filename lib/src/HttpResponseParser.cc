@@ -25,6 +25,8 @@ void HttpResponseParser::reset()
     _state = HttpResponseParseState::kExpectResponseLine;
     _response.reset(new HttpResponseImpl);
     _parseResponseForHeadMethod = false;
+    _headersCallback = nullptr;
+    _bodyCallback = nullptr;
 }
 
 HttpResponseParser::HttpResponseParser()
@@ -130,6 +132,7 @@ bool HttpResponseParser::parseResponse(MsgBuffer *buf)
                         else
                         {
                             if (_response->statusCode() == k204NoContent ||
+                                _response->statusCode() == k304NotModified ||
                                 (_response->statusCode() ==
                                      k101SwitchingProtocols &&
                                  _response->getHeaderBy("upgrade") ==
@@ -153,6 +156,10 @@ bool HttpResponseParser::parseResponse(MsgBuffer *buf)
                         _state = HttpResponseParseState::kGotAll;
                         hasMore = false;
                     }
+                    buf->retrieveUntil(crlf + 2);
+                    if (_headersCallback)
+                        _headersCallback();
+                    continue;
                 }
                 buf->retrieveUntil(crlf + 2);
             }
@@ -173,24 +180,35 @@ bool HttpResponseParser::parseResponse(MsgBuffer *buf)
                 }
                 break;
             }
-            if (!_response->_bodyPtr)
+            if (_bodyCallback)
             {
-                _response->_bodyPtr = std::make_shared<std::string>();
-            }
-            if (_response->_leftBodyLength >= buf->readableBytes())
-            {
-                _response->_leftBodyLength -= buf->readableBytes();
-
-                _response->_bodyPtr->append(
-                    std::string(buf->peek(), buf->readableBytes()));
-                buf->retrieveAll();
+                auto len =
+                    std::min(_response->_leftBodyLength, buf->readableBytes());
+                _bodyCallback(buf->peek(), len);
+                buf->retrieve(len);
+                _response->_leftBodyLength -= len;
             }
             else
             {
-                _response->_bodyPtr->append(
-                    std::string(buf->peek(), _response->_leftBodyLength));
-                buf->retrieve(_response->_leftBodyLength);
-                _response->_leftBodyLength = 0;
+                if (!_response->_bodyPtr)
+                {
+                    _response->_bodyPtr = std::make_shared<std::string>();
+                }
+                if (_response->_leftBodyLength >= buf->readableBytes())
+                {
+                    _response->_leftBodyLength -= buf->readableBytes();
+
+                    _response->_bodyPtr->append(
+                        std::string(buf->peek(), buf->readableBytes()));
+                    buf->retrieveAll();
+                }
+                else
+                {
+                    _response->_bodyPtr->append(
+                        std::string(buf->peek(), _response->_leftBodyLength));
+                    buf->retrieve(_response->_leftBodyLength);
+                    _response->_leftBodyLength = 0;
+                }
             }
             if (_response->_leftBodyLength == 0)
             {
@@ -203,6 +221,12 @@ bool HttpResponseParser::parseResponse(MsgBuffer *buf)
         }
         else if (_state == HttpResponseParseState::kExpectClose)
         {
+            if (_bodyCallback)
+            {
+                _bodyCallback(buf->peek(), buf->readableBytes());
+                buf->retrieveAll();
+                break;
+            }
             if (!_response->_bodyPtr)
             {
                 _response->_bodyPtr = std::make_shared<std::string>();
@@ -231,6 +255,13 @@ bool HttpResponseParser::parseResponse(MsgBuffer *buf)
                 {
                     _state = HttpResponseParseState::kExpectLastEmptyChunk;
                 }
+                if (_bodyCallback)
+                {
+                    // The relayed length includes the CRLF after the data.
+                    _bodyCallback(buf->peek(), crlf + 2 - buf->peek());
+                    if (_response->_currentChunkLength != 0)
+                        _response->_currentChunkLength += 2;
+                }
                 buf->retrieveUntil(crlf + 2);
             }
             else
@@ -238,6 +269,19 @@ bool HttpResponseParser::parseResponse(MsgBuffer *buf)
                 hasMore = false;
             }
         }
+        else if (_state == HttpResponseParseState::kExpectChunkBody &&
+                 _bodyCallback)
+        {
+            if (buf->readableBytes() == 0)
+                break;
+            auto len =
+                std::min(_response->_currentChunkLength, buf->readableBytes());
+            _bodyCallback(buf->peek(), len);
+            buf->retrieve(len);
+            _response->_currentChunkLength -= len;
+            if (_response->_currentChunkLength == 0)
+                _state = HttpResponseParseState::kExpectChunkLen;
+        }
         else if (_state == HttpResponseParseState::kExpectChunkBody)
         {
             // LOG_TRACE<<"expect chunk len="<<_response->_currentChunkLength;
@@ -275,6 +319,8 @@ bool HttpResponseParser::parseResponse(MsgBuffer *buf)
             const char *crlf = buf->findCRLF();
             if (crlf)
             {
+                if (_bodyCallback)
+                    _bodyCallback(buf->peek(), crlf + 2 - buf->peek());
                 buf->retrieveUntil(crlf + 2);
                 _state = HttpResponseParseState::kGotAll;
                 break;
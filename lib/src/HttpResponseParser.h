@@ -18,6 +18,7 @@
 #include <trantor/utils/NonCopyable.h>
 #include <trantor/net/TcpConnection.h>
 #include <trantor/utils/MsgBuffer.h>
+#include <functional>
 #include <list>
 #include <mutex>
 
@@ -55,6 +56,24 @@ class HttpResponseParser : public trantor::NonCopyable
         _parseResponseForHeadMethod = true;
     }
 
+    /// Relay the body instead of keeping it in the response. The
+    /// headersCallback is called when all headers are received, then the
+    /// bodyCallback is called with the raw bytes of the body, including the
+    /// chunk framing. The callbacks are cleared by reset().
+    void setStreamCallbacks(
+        std::function<void()> &&headersCallback,
+        std::function<void(const char *, size_t)> &&bodyCallback)
+    {
+        _headersCallback = std::move(headersCallback);
+        _bodyCallback = std::move(bodyCallback);
+    }
+
+    /// Return true if the end of the body is the end of the connection.
+    bool waitingForClose() const
+    {
+        return _state == HttpResponseParseState::kExpectClose;
+    }
+
     void reset();
 
     const HttpResponseImplPtr &responseImpl() const
@@ -68,6 +87,8 @@ class HttpResponseParser : public trantor::NonCopyable
     HttpResponseParseState _state;
     HttpResponseImplPtr _response;
     bool _parseResponseForHeadMethod = false;
+    std::function<void()> _headersCallback;
+    std::function<void(const char *, size_t)> _bodyCallback;
 };
 
 }  // namespace drogon
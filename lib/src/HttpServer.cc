@@ -17,6 +17,8 @@
 #include "HttpRequestParser.h"
 #include "HttpAppFrameworkImpl.h"
 #include "HttpResponseImpl.h"
+#include "HttpProxyStream.h"
+#include "HttpUtils.h"
 #include "WebSocketConnectionImpl.h"
 #include <drogon/HttpRequest.h>
 #include <drogon/HttpResponse.h>
@@ -58,6 +60,12 @@ static HttpResponsePtr getCompressedResponse(const HttpRequestImplPtr &req,
             }
             newResp->setBody(std::move(strCompress));
             newResp->addHeader("Content-Encoding", "gzip");
+            // The compressed body is not byte-identical to the original one,
+            // so a strong entity tag must be weakened.
+            auto &etag = static_cast<HttpResponseImpl *>(newResp.get())
+                             ->getHeaderBy("etag");
+            if (!etag.empty() && etag.compare(0, 2, "W/") != 0)
+                newResp->addHeader("ETag", "W/" + etag);
         }
         else
         {
@@ -127,6 +135,8 @@ HttpServer::HttpServer(
         std::bind(&HttpServer::onConnection, this, _1));
     _server.setRecvMessageCallback(
         std::bind(&HttpServer::onMessage, this, _1, _2));
+    _server.setWriteCompleteCallback(
+        std::bind(&HttpServer::onWriteComplete, this, _1));
 }
 
 HttpServer::~HttpServer()
@@ -165,6 +175,15 @@ void HttpServer::onConnection(const TcpConnectionPtr &conn)
     }
 }
 
+void HttpServer::onWriteComplete(const TcpConnectionPtr &conn)
+{
+    auto requestParser = conn->getContext<HttpRequestParser>();
+    if (requestParser && requestParser->webSocketConn())
+    {
+        requestParser->webSocketConn()->onWriteComplete();
+    }
+}
+
 void HttpServer::onMessage(const TcpConnectionPtr &conn, MsgBuffer *buf)
 {
     if (!conn->hasContext())
@@ -326,9 +345,27 @@ void HttpServer::onRequests(
                     return;
                 if (!conn->connected())
                     return;
-                response->setCloseConnection(_close);
-                auto newResp =
-                    getCompressedResponse(req, response, isHeadMethod);
+                HttpResponsePtr newResp;
+                if (static_cast<HttpResponseImpl *>(response.get())
+                        ->proxyStream())
+                {
+                    // The upstream server handles the conditional headers,
+                    // and a body delimited by the end of its connection is
+                    // delimited by the end of this one too.
+                    response->setCloseConnection(
+                        _close || response->ifCloseConnection());
+                    newResp = response;
+                }
+                else if (!(newResp = getNotModifiedResponse(req, response)))
+                {
+                    response->setCloseConnection(_close);
+                    newResp =
+                        getCompressedResponse(req, response, isHeadMethod);
+                }
+                else
+                {
+                    newResp->setCloseConnection(_close);
+                }
                 if (conn->getLoop()->isInLoopThread())
                 {
                     /*
@@ -372,7 +409,7 @@ void HttpServer::onRequests(
                             else
                                 break;
                         }
-                        sendResponses(conn, resps, requestParser->getBuffer());
+                        sendResponses(conn, resps, requestParser);
                     }
                     else
                     {
@@ -410,9 +447,7 @@ void HttpServer::onRequests(
                                     else
                                         break;
                                 }
-                                sendResponses(conn,
-                                              resps,
-                                              requestParser->getBuffer());
+                                sendResponses(conn, resps, requestParser);
                             }
                             else
                             {
@@ -433,9 +468,7 @@ void HttpServer::onRequests(
     *loopFlagPtr = false;
     if (conn->connected() && !requestParser->getResponseBuffer().empty())
     {
-        sendResponses(conn,
-                      requestParser->getResponseBuffer(),
-                      requestParser->getBuffer());
+        sendResponses(conn, requestParser->getResponseBuffer(), requestParser);
         requestParser->getResponseBuffer().clear();
     }
 }
@@ -453,7 +486,9 @@ void HttpServer::sendResponse(const TcpConnectionPtr &conn,
         auto &sendfileName = respImplPtr->sendfileName();
         if (!sendfileName.empty())
         {
-            conn->sendFile(sendfileName.c_str());
+            conn->sendFile(sendfileName.c_str(),
+                           0,
+                           respImplPtr->sendfileSize());
         }
     }
     else
@@ -471,19 +506,66 @@ void HttpServer::sendResponse(const TcpConnectionPtr &conn,
 void HttpServer::sendResponses(
     const TcpConnectionPtr &conn,
     const std::vector<std::pair<HttpResponsePtr, bool>> &responses,
-    trantor::MsgBuffer &buffer)
+    const std::shared_ptr<HttpRequestParser> &requestParser)
 {
     conn->getLoop()->assertInLoopThread();
     if (responses.empty())
         return;
-    if (responses.size() == 1)
+    if (requestParser->isStreaming())
+    {
+        auto &pendingResponses = requestParser->getPendingResponses();
+        pendingResponses.insert(pendingResponses.end(),
+                                responses.begin(),
+                                responses.end());
+        return;
+    }
+    if (responses.size() == 1 &&
+        !static_cast<HttpResponseImpl *>(responses[0].first.get())
+             ->proxyStream())
     {
         sendResponse(conn, responses[0].first, responses[0].second);
         return;
     }
-    for (auto const &resp : responses)
+    auto &buffer = requestParser->getBuffer();
+    for (auto iter = responses.begin(); iter != responses.end(); ++iter)
     {
+        auto const &resp = *iter;
         auto respImplPtr = static_cast<HttpResponseImpl *>(resp.first.get());
+        auto &proxyStream = respImplPtr->proxyStream();
+        if (proxyStream)
+        {
+            // The headers of a relayed response are rendered without the
+            // body for any method. A HEAD request is forwarded as is, so its
+            // stream ends without a body and the upstream connection is
+            // kept.
+            auto httpString = respImplPtr->renderHeaderForHeadMethod();
+            buffer.append(httpString->data(), httpString->length());
+            conn->send(buffer);
+            buffer.retrieveAll();
+            // The responses after this one are sent when the body is done.
+            requestParser->setStreaming(true);
+            requestParser->getPendingResponses().assign(iter + 1,
+                                                        responses.end());
+            proxyStream->start(
+                conn,
+                [this,
+                 conn,
+                 requestParser,
+                 closeConnection = respImplPtr->ifCloseConnection()]() {
+                    requestParser->setStreaming(false);
+                    if (!conn->connected())
+                        return;
+                    if (closeConnection)
+                    {
+                        conn->shutdown();
+                        return;
+                    }
+                    std::vector<std::pair<HttpResponsePtr, bool>> responses;
+                    responses.swap(requestParser->getPendingResponses());
+                    sendResponses(conn, responses, requestParser);
+                });
+            return;
+        }
         if (!resp.second)
         {
             // Not HEAD method
@@ -493,7 +575,9 @@ void HttpServer::sendResponses(
             {
                 conn->send(buffer);
                 buffer.retrieveAll();
-                conn->sendFile(sendfileName.c_str());
+                conn->sendFile(sendfileName.c_str(),
+                               0,
+                               respImplPtr->sendfileSize());
             }
         }
         else
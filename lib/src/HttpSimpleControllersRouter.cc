@@ -225,6 +225,7 @@ void HttpSimpleControllersRouter::doControllerHandler(
                     resp->statusCode() != k404NotFound)
                 {
                     // cache the response;
+                    static_cast<HttpResponseImpl *>(resp.get())->makeETag();
                     static_cast<HttpResponseImpl *>(resp.get())
                         ->makeHeaderString();
                     auto loop = req->getLoop();
@@ -488,4 +488,77 @@ ContentType getContentType(const std::string &fileName)
     }
 }
 
+bool isETagMatched(const std::string &ifNoneMatch, const std::string &etag)
+{
+    if (etag.empty())
+        return false;
+    // Weak comparison ignores the W/ prefix on both sides.
+    size_t tagStart = (etag.compare(0, 2, "W/") == 0) ? 2 : 0;
+    size_t tagLen = etag.length() - tagStart;
+    size_t pos = 0;
+    while (pos < ifNoneMatch.length())
+    {
+        auto ch = ifNoneMatch[pos];
+        if (ch == ' ' || ch == '\t' || ch == ',')
+        {
+            ++pos;
+            continue;
+        }
+        if (ch == '*')
+            return true;
+        if (ifNoneMatch.compare(pos, 2, "W/") == 0)
+            pos += 2;
+        size_t end;
+        if (pos < ifNoneMatch.length() && ifNoneMatch[pos] == '"')
+        {
+            // An opaque tag may contain commas, it ends with the next quote
+            // (rfc7232-2.3).
+            end = ifNoneMatch.find('"', pos + 1);
+            end = (end == std::string::npos) ? ifNoneMatch.length() : end + 1;
+        }
+        else
+        {
+            end = ifNoneMatch.find(',', pos);
+            if (end == std::string::npos)
+                end = ifNoneMatch.length();
+        }
+        auto len = end - pos;
+        while (len > 0 && (ifNoneMatch[pos + len - 1] == ' ' ||
+                           ifNoneMatch[pos + len - 1] == '\t'))
+            --len;
+        if (len == tagLen &&
+            ifNoneMatch.compare(pos, len, etag, tagStart, tagLen) == 0)
+            return true;
+        pos = end;
+    }
+    return false;
+}
+
+HttpResponsePtr getNotModifiedResponse(const HttpRequestPtr &req,
+                                       const HttpResponsePtr &response)
+{
+    if (response->statusCode() != k200OK ||
+        (req->method() != Get && req->method() != Head))
+        return nullptr;
+    auto &ifNoneMatch = req->getHeader("if-none-match");
+    if (ifNoneMatch.empty())
+        return nullptr;
+    auto &etag = response->getHeader("etag");
+    if (!isETagMatched(ifNoneMatch, etag))
+        return nullptr;
+    LOG_TRACE << "not Modified!";
+    auto resp = HttpResponse::newHttpResponse();
+    resp->setStatusCode(k304NotModified);
+    // The headers which would be sent in the 200 response are kept, so
+    // caches can update the stored response (rfc7232-4.1).
+    for (auto &name :
+         {"etag", "cache-control", "content-location", "expires", "vary"})
+    {
+        auto &value = response->getHeader(name);
+        if (!value.empty())
+            resp->addHeader(name, value);
+    }
+    return resp;
+}
+
 }  // namespace drogon
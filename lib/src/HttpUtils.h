@@ -16,6 +16,8 @@
 
 #include <drogon/utils/string_view.h>
 #include <drogon/HttpTypes.h>
+#include <drogon/HttpRequest.h>
+#include <drogon/HttpResponse.h>
 #include <string>
 #include <trantor/utils/MsgBuffer.h>
 
@@ -24,5 +26,14 @@ namespace drogon
 const string_view &webContentTypeToString(ContentType contenttype);
 const string_view &statusCodeToString(int code);
 ContentType getContentType(const std::string &fileName);
+/// Check if the value of an If-None-Match header matches the entity tag, the
+/// weak comparison function is used here (rfc7232-3.2).
+bool isETagMatched(const std::string &ifNoneMatch, const std::string &etag);
+/// Return the 304 response replacing the one to a GET or HEAD request whose
+/// If-None-Match header matches the entity tag of the response, or nullptr
+/// if the response is sent as is. Other methods are not checked because the
+/// handler has already performed them (rfc7232-5).
+HttpResponsePtr getNotModifiedResponse(const HttpRequestPtr &req,
+                                       const HttpResponsePtr &response);
 
 }  // namespace drogon
@@ -15,6 +15,7 @@
 #include "HttpRequestImpl.h"
 #include "HttpUtils.h"
 #include "HttpAppFrameworkImpl.h"
+#include "AsyncFileIO.h"
 #include <drogon/MultiPart.h>
 #include <drogon/utils/Utilities.h>
 #include <drogon/config.h>
@@ -138,12 +139,11 @@ int MultiPartParser::parse(const HttpRequestPtr &req,
     return 0;
 }
 
-int HttpFile::save(const std::string &path) const
+std::string HttpFile::getPathAndFilename(const std::string &path) const
 {
     assert(!path.empty());
     if (_fileName == "")
-        return -1;
-    std::string filename;
+        return std::string();
     auto tmpPath = path;
     if (path[0] == '/' ||
         (path.length() >= 2 && path[0] == '.' && path[1] == '/') ||
@@ -163,22 +163,17 @@ int HttpFile::save(const std::string &path) const
     }
 
     if (utils::createPath(tmpPath) < 0)
-        return -1;
+        return std::string();
 
     if (tmpPath[tmpPath.length() - 1] != '/')
     {
-        filename = tmpPath + "/" + _fileName;
+        return tmpPath + "/" + _fileName;
     }
     else
-        filename = tmpPath + _fileName;
-
-    return saveTo(filename);
+        return tmpPath + _fileName;
 }
-int HttpFile::save() const
-{
-    return save(HttpAppFrameworkImpl::instance().getUploadPath());
-}
-int HttpFile::saveAs(const std::string &filename) const
+std::string HttpFile::getPathAndFilenameOfSaveAs(
+    const std::string &filename) const
 {
     assert(!filename.empty());
     auto pathAndFileName = filename;
@@ -202,10 +197,54 @@ int HttpFile::saveAs(const std::string &filename) const
     {
         std::string path = pathAndFileName.substr(0, pathPos);
         if (utils::createPath(path) < 0)
-            return -1;
+            return std::string();
     }
+    return pathAndFileName;
+}
+int HttpFile::save(const std::string &path) const
+{
+    auto filename = getPathAndFilename(path);
+    if (filename.empty())
+        return -1;
+    return saveTo(filename);
+}
+int HttpFile::save() const
+{
+    return save(HttpAppFrameworkImpl::instance().getUploadPath());
+}
+int HttpFile::saveAs(const std::string &filename) const
+{
+    auto pathAndFileName = getPathAndFilenameOfSaveAs(filename);
+    if (pathAndFileName.empty())
+        return -1;
     return saveTo(pathAndFileName);
 }
+void HttpFile::save(const std::string &path,
+                    std::function<void(int)> &&callback) const
+{
+    auto filename = getPathAndFilename(path);
+    if (filename.empty())
+    {
+        callback(-1);
+        return;
+    }
+    saveTo(filename, std::move(callback));
+}
+void HttpFile::save(std::function<void(int)> &&callback) const
+{
+    save(HttpAppFrameworkImpl::instance().getUploadPath(), std::move(callback));
+}
+void HttpFile::saveAs(const std::string &filename,
+                      std::function<void(int)> &&callback) const
+{
+    auto pathAndFileName = getPathAndFilenameOfSaveAs(filename);
+    if (pathAndFileName.empty())
+    {
+        callback(-1);
+        return;
+    }
+    saveTo(pathAndFileName, std::move(callback));
+}
 int HttpFile::saveTo(const std::string &pathAndFilename) const
 {
     LOG_TRACE << "save uploaded file:" << pathAndFilename;
@@ -222,6 +261,41 @@ int HttpFile::saveTo(const std::string &pathAndFilename) const
         return -1;
     }
 }
+void HttpFile::saveTo(const std::string &pathAndFilename,
+                      std::function<void(int)> &&callback) const
+{
+    auto fileIO = HttpAppFrameworkImpl::instance().getAsyncFileIO();
+    if (!fileIO || !fileIO->isAsync())
+    {
+        callback(saveTo(pathAndFilename));
+        return;
+    }
+    LOG_TRACE << "save uploaded file:" << pathAndFilename;
+    int fd = open(pathAndFilename.c_str(),
+                  O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                  0666);
+    if (fd < 0)
+    {
+        LOG_SYSERR << "save failed!";
+        callback(-1);
+        return;
+    }
+    auto content = std::make_shared<std::string>(_fileContent);
+    fileIO->write(fd,
+                  content->data(),
+                  content->length(),
+                  0,
+                  [fd, content, callback = std::move(callback)](ssize_t n) {
+                      close(fd);
+                      if (n != static_cast<ssize_t>(content->length()))
+                      {
+                          LOG_ERROR << "save failed!";
+                          callback(-1);
+                          return;
+                      }
+                      callback(0);
+                  });
+}
 std::string HttpFile::getMd5() const
 {
 #ifdef OpenSSL_FOUND
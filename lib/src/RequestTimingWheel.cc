@@ -0,0 +1,106 @@
+/**
+ *
+ *  RequestTimingWheel.cc
+ *  An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#include "RequestTimingWheel.h"
+#include "HttpClientImpl.h"
+#include <cmath>
+
+using namespace drogon;
+
+#define REQUEST_WHEEL_BUCKETS 256
+
+constexpr double RequestTimingWheel::kTickInterval;
+
+RequestTimingWheel *RequestTimingWheel::get(trantor::EventLoop *loop)
+{
+    loop->assertInLoopThread();
+    // A thread may run several loops one after another, every loop has its
+    // own wheel.
+    static thread_local std::unordered_map<trantor::EventLoop *,
+                                           std::unique_ptr<RequestTimingWheel>>
+        wheels;
+    auto &wheel = wheels[loop];
+    if (!wheel)
+        wheel.reset(new RequestTimingWheel(loop));
+    return wheel.get();
+}
+
+RequestTimingWheel::RequestTimingWheel(trantor::EventLoop *loop)
+    : _loop(loop), _buckets(REQUEST_WHEEL_BUCKETS)
+{
+}
+
+uint64_t RequestTimingWheel::schedule(
+    const std::weak_ptr<HttpClientImpl> &client,
+    uint64_t requestId,
+    double timeout)
+{
+    if (_timerId == trantor::InvalidTimerId)
+    {
+        _timerId = _loop->runEvery(kTickInterval, [this]() { onTick(); });
+    }
+    auto ticks = std::ceil(timeout / kTickInterval);
+    auto tick = _ticks + (ticks < 1 ? 1 : static_cast<size_t>(ticks));
+    auto key = ++_nextKey;
+    _entries.emplace(key, Entry{client, requestId, tick});
+    _buckets[tick % _buckets.size()].push_back(key);
+    return key;
+}
+
+void RequestTimingWheel::cancel(uint64_t key)
+{
+    if (_entries.erase(key) > 0)
+        stopIfEmpty();
+}
+
+void RequestTimingWheel::stopIfEmpty()
+{
+    if (!_entries.empty() || _timerId == trantor::InvalidTimerId)
+        return;
+    // Nothing to time out, don't wake up the loop for nothing. The keys left
+    // in the buckets all belong to cancelled entries.
+    _loop->invalidateTimer(_timerId);
+    _timerId = trantor::InvalidTimerId;
+    for (auto &bucket : _buckets)
+        bucket.clear();
+}
+
+void RequestTimingWheel::onTick()
+{
+    ++_ticks;
+    auto &bucket = _buckets[_ticks % _buckets.size()];
+    if (!bucket.empty())
+    {
+        // Clients may schedule new entries into this bucket.
+        std::vector<uint64_t> keys;
+        keys.swap(bucket);
+        for (auto key : keys)
+        {
+            auto iter = _entries.find(key);
+            if (iter == _entries.end())
+                continue;
+            if (iter->second._tick > _ticks)
+            {
+                bucket.push_back(key);
+                continue;
+            }
+            auto client = iter->second._client.lock();
+            auto requestId = iter->second._requestId;
+            _entries.erase(iter);
+            if (client)
+                client->onRequestTimeout(requestId);
+        }
+    }
+    stopIfEmpty();
+}
@@ -0,0 +1,81 @@
+/**
+ *
+ *  RequestTimingWheel.h
+ *  An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#pragma once
+
+#include <trantor/net/EventLoop.h>
+#include <trantor/utils/NonCopyable.h>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace drogon
+{
+class HttpClientImpl;
+
+/**
+ * @brief A hashed timing wheel which drives the timeouts of the requests of
+ * all HTTP clients in one event loop.
+ *
+ * Like the WebSocketTimingWheel, there is only one trantor timer per loop and
+ * scheduling a request is O(1), but the resolution is finer and the timer is
+ * stopped when there is no request to time out. The entries of requests
+ * which are done are cancelled in O(1), so only the requests which really
+ * time out reach their clients. Entries don't own clients.
+ *
+ * All methods must be called in the thread of the event loop.
+ */
+class RequestTimingWheel : public trantor::NonCopyable
+{
+  public:
+    /// The resolution of the wheel in seconds.
+    static constexpr double kTickInterval = 0.05;
+
+    /// Return the wheel of the loop, which must run in the current thread,
+    /// it's created when it's used for the first time.
+    static RequestTimingWheel *get(trantor::EventLoop *loop);
+
+    /// Call the onRequestTimeout() method of the client with the id after
+    /// the timeout in seconds, return the key of the entry.
+    uint64_t schedule(const std::weak_ptr<HttpClientImpl> &client,
+                      uint64_t requestId,
+                      double timeout);
+
+    /// Remove the entry with the key, it's ignored if the entry has expired.
+    void cancel(uint64_t key);
+
+  private:
+    explicit RequestTimingWheel(trantor::EventLoop *loop);
+    void onTick();
+
+    struct Entry
+    {
+        std::weak_ptr<HttpClientImpl> _client;
+        uint64_t _requestId;
+        size_t _tick;
+    };
+    void stopIfEmpty();
+
+    trantor::EventLoop *_loop;
+    std::unordered_map<uint64_t, Entry> _entries;
+    // The keys of the entries, keys whose ticks are one or more rounds later
+    // are kept in their buckets until the wheel reaches them, keys of
+    // cancelled entries are skipped.
+    std::vector<std::vector<uint64_t>> _buckets;
+    size_t _ticks = 0;
+    uint64_t _nextKey = 0;
+    trantor::TimerId _timerId = trantor::InvalidTimerId;
+};
+
+}  // namespace drogon
@@ -13,19 +13,85 @@
  */
 
 #include "StaticFileRouter.h"
+#include "AsyncFileIO.h"
 #include "HttpAppFrameworkImpl.h"
 #include "HttpRequestImpl.h"
 #include "HttpResponseImpl.h"
+#include "HttpUtils.h"
 
 #include <fstream>
 #include <iostream>
 
-#include <fcntl.h>
-#include <sys/file.h>
-#include <sys/stat.h>
-
 using namespace drogon;
 
+// If-None-Match takes precedence over If-Modified-Since, rfc7232-6
+static bool isNotModified(const HttpRequestImplPtr &req,
+                          const std::string &lastModified,
+                          const std::string &etag)
+{
+    const std::string &ifNoneMatch = req->getHeaderBy("if-none-match");
+    if (!ifNoneMatch.empty() && !etag.empty())
+        return isETagMatched(ifNoneMatch, etag);
+    const std::string &ifModifiedSince = req->getHeaderBy("if-modified-since");
+    return !ifModifiedSince.empty() && ifModifiedSince == lastModified;
+}
+
+static void newFileResponse(
+    const std::unique_ptr<FileMetadataCache> &metadataCache,
+    const std::string &path,
+    const FileMetadataPtr &metadata,
+    ContentType type,
+    std::function<void(const HttpResponsePtr &)> &&callback)
+{
+    auto &app = HttpAppFrameworkImpl::instance();
+    auto fileIO = app.getAsyncFileIO();
+    if (fileIO && fileIO->isAsync() &&
+        !(app.useSendfile() && metadata->_size > app.sendfileThreshold()))
+    {
+        // Files not sent by sendfile() are read into the body, read them by
+        // the cached descriptor without blocking the event loop.
+        int fd = metadataCache->openFile(path, metadata);
+        if (fd >= 0)
+        {
+            auto buf = std::make_shared<std::string>(metadata->_size, '\0');
+            fileIO->read(fd,
+                         &(*buf)[0],
+                         buf->size(),
+                         0,
+                         [buf, metadata, type, callback = std::move(callback)](
+                             ssize_t n) {
+                             if (n < 0)
+                             {
+                                 callback(nullptr);
+                                 return;
+                             }
+                             buf->resize(n);
+                             auto resp = std::make_shared<HttpResponseImpl>();
+                             resp->setBody(std::move(*buf));
+                             resp->setStatusCode(k200OK);
+                             resp->setContentTypeCode(type);
+                             callback(resp);
+                         });
+            return;
+        }
+    }
+    auto resp =
+        HttpResponseImpl::newSizedFileResponse(path, metadata->_size, type);
+    if (resp)
+    {
+        auto respImpl = static_cast<HttpResponseImpl *>(resp.get());
+        if (!respImpl->sendfileName().empty())
+        {
+            // Send the file by the cached descriptor, so the response sends
+            // the file described by the metadata even if it's replaced.
+            int fd = metadataCache->openFile(path, metadata);
+            if (fd >= 0)
+                respImpl->setSendfileDescriptor(fd, metadata);
+        }
+    }
+    callback(resp);
+}
+
 void StaticFileRouter::init(const std::vector<trantor::EventLoop *> &ioloops)
 {
     // Max timeout up to about 70 days;
@@ -41,6 +107,14 @@ void StaticFileRouter::init(const std::vector<trantor::EventLoop *> &ioloops)
     _staticFilesCache = decltype(_staticFilesCache)(
         new IOThreadStorage<
             std::unordered_map<std::string, HttpResponsePtr>>{});
+    _fileMetadataCache = decltype(_fileMetadataCache)(
+        new IOThreadStorage<std::unique_ptr<FileMetadataCache>>);
+    _fileMetadataCache->init(
+        [&ioloops](std::unique_ptr<FileMetadataCache> &cachePtr, size_t i) {
+            auto loop = i < ioloops.size() ? ioloops[i] : app().getLoop();
+            cachePtr =
+                std::unique_ptr<FileMetadataCache>(new FileMetadataCache(loop));
+        });
 }
 
 void StaticFileRouter::route(
@@ -77,53 +151,28 @@ void StaticFileRouter::route(
 
             // check last modified time,rfc2616-14.25
             // If-Modified-Since: Mon, 15 Oct 2018 06:26:33 GMT
+            // and the entity tag, rfc7232-3.2
+            // If-None-Match: "2a4b1-1b3-5da52e7d"
 
-            std::string timeStr;
-            if (_enableLastModify)
+            if (cachedResp && (_enableLastModify || _enableETag))
             {
-                if (cachedResp)
+                auto cachedRespImpl =
+                    static_cast<HttpResponseImpl *>(cachedResp.get());
+                const std::string &cachedETag =
+                    cachedRespImpl->getHeaderBy("etag");
+                if (isNotModified(req,
+                                  cachedRespImpl->getHeaderBy("last-modified"),
+                                  cachedETag))
                 {
-                    if (static_cast<HttpResponseImpl *>(cachedResp.get())
-                            ->getHeaderBy("last-modified") ==
-                        req->getHeaderBy("if-modified-since"))
-                    {
-                        std::shared_ptr<HttpResponseImpl> resp =
-                            std::make_shared<HttpResponseImpl>();
-                        resp->setStatusCode(k304NotModified);
-                        HttpAppFrameworkImpl::instance().callCallback(req,
-                                                                      resp,
-                                                                      callback);
-                        return;
-                    }
-                }
-                else
-                {
-                    struct stat fileStat;
-                    LOG_TRACE << "enabled LastModify";
-                    if (stat(filePath.c_str(), &fileStat) >= 0)
-                    {
-                        LOG_TRACE << "last modify time:" << fileStat.st_mtime;
-                        struct tm tm1;
-                        gmtime_r(&fileStat.st_mtime, &tm1);
-                        timeStr.resize(64);
-                        auto len = strftime((char *)timeStr.data(),
-                                            timeStr.size(),
-                                            "%a, %d %b %Y %T GMT",
-                                            &tm1);
-                        timeStr.resize(len);
-                        const std::string &modiStr =
-                            req->getHeaderBy("if-modified-since");
-                        if (modiStr == timeStr && !modiStr.empty())
-                        {
-                            LOG_TRACE << "not Modified!";
-                            std::shared_ptr<HttpResponseImpl> resp =
-                                std::make_shared<HttpResponseImpl>();
-                            resp->setStatusCode(k304NotModified);
-                            HttpAppFrameworkImpl::instance().callCallback(
-                                req, resp, callback);
-                            return;
-                        }
-                    }
+                    std::shared_ptr<HttpResponseImpl> resp =
+                        std::make_shared<HttpResponseImpl>();
+                    resp->setStatusCode(k304NotModified);
+                    if (!cachedETag.empty())
+                        resp->addHeader("ETag", cachedETag);
+                    HttpAppFrameworkImpl::instance().callCallback(req,
+                                                                  resp,
+                                                                  callback);
+                    return;
                 }
             }
 
@@ -135,52 +184,109 @@ void StaticFileRouter::route(
                                                               callback);
                 return;
             }
-            HttpResponsePtr resp;
+            auto &metadataCache = _fileMetadataCache->getThreadData();
+            auto metadata = metadataCache->getMetadata(filePath);
+            if (!metadata)
+            {
+                callback(HttpResponse::newNotFoundResponse());
+                return;
+            }
+            std::string timeStr;
+            std::string etag;
+            if (_enableLastModify)
+                timeStr = metadata->_lastModified;
+            if (_enableETag)
+                etag = metadata->_etag;
+            if (isNotModified(req, timeStr, etag))
+            {
+                LOG_TRACE << "not Modified!";
+                std::shared_ptr<HttpResponseImpl> resp =
+                    std::make_shared<HttpResponseImpl>();
+                resp->setStatusCode(k304NotModified);
+                if (!etag.empty())
+                    resp->addHeader("ETag", etag);
+                HttpAppFrameworkImpl::instance().callCallback(req,
+                                                              resp,
+                                                              callback);
+                return;
+            }
+            auto filePathToSend = filePath;
+            auto metadataToSend = metadata;
             if (_gzipStaticFlag &&
                 req->getHeaderBy("accept-encoding").find("gzip") !=
                     std::string::npos)
             {
                 // Find compressed file first.
                 auto gzipFileName = filePath + ".gz";
-                std::ifstream infile(gzipFileName, std::ifstream::binary);
-                if (infile)
+                auto gzipMetadata = metadataCache->getMetadata(gzipFileName);
+                if (gzipMetadata)
                 {
-                    resp = HttpResponse::newFileResponse(
-                        gzipFileName, "", drogon::getContentType(filePath));
-                    resp->addHeader("Content-Encoding", "gzip");
+                    filePathToSend = std::move(gzipFileName);
+                    metadataToSend = std::move(gzipMetadata);
                 }
             }
-            if (!resp)
-                resp = HttpResponse::newFileResponse(filePath);
-            if (resp->statusCode() != k404NotFound)
-            {
-                if (!timeStr.empty())
-                {
-                    resp->addHeader("Last-Modified", timeStr);
-                    resp->addHeader("Expires", "Thu, 01 Jan 1970 00:00:00 GMT");
-                }
-                // cache the response for 5 seconds by default
-                if (_staticFilesCacheTime >= 0)
-                {
-                    LOG_TRACE << "Save in cache for " << _staticFilesCacheTime
-                              << " seconds";
-                    resp->setExpiredTime(_staticFilesCacheTime);
-                    _staticFilesCache->getThreadData()[filePath] = resp;
-                    _staticFilesCacheMap->getThreadData()->insert(
-                        filePath, 0, _staticFilesCacheTime, [this, filePath]() {
-                            LOG_TRACE << "Erase cache";
-                            assert(_staticFilesCache->getThreadData().find(
-                                       filePath) !=
-                                   _staticFilesCache->getThreadData().end());
-                            _staticFilesCache->getThreadData().erase(filePath);
-                        });
-                }
-                HttpAppFrameworkImpl::instance().callCallback(req,
-                                                              resp,
-                                                              callback);
-                return;
-            }
-            callback(resp);
+            bool gzipped = (metadataToSend != metadata);
+            newFileResponse(
+                metadataCache,
+                filePathToSend,
+                metadataToSend,
+                drogon::getContentType(filePath),
+                [this,
+                 req,
+                 filePath,
+                 timeStr,
+                 etag,
+                 gzipped,
+                 callback = std::move(callback)](const HttpResponsePtr &resp) {
+                    if (!resp)
+                    {
+                        callback(HttpResponse::newNotFoundResponse());
+                        return;
+                    }
+                    if (gzipped)
+                    {
+                        resp->addHeader("Content-Encoding", "gzip");
+                    }
+                    if (!timeStr.empty())
+                    {
+                        resp->addHeader("Last-Modified", timeStr);
+                        resp->addHeader("Expires",
+                                        "Thu, 01 Jan 1970 00:00:00 GMT");
+                    }
+                    if (!etag.empty())
+                    {
+                        // The compressed file is another representation of
+                        // the same resource, so its entity tag is a weak one.
+                        resp->addHeader("ETag", gzipped ? "W/" + etag : etag);
+                    }
+                    // cache the response for 5 seconds by default, the file
+                    // may have been cached by a concurrent read.
+                    auto &cache = _staticFilesCache->getThreadData();
+                    if (_staticFilesCacheTime >= 0 &&
+                        cache.find(filePath) == cache.end())
+                    {
+                        LOG_TRACE << "Save in cache for "
+                                  << _staticFilesCacheTime << " seconds";
+                        resp->setExpiredTime(_staticFilesCacheTime);
+                        cache[filePath] = resp;
+                        _staticFilesCacheMap->getThreadData()->insert(
+                            filePath,
+                            0,
+                            _staticFilesCacheTime,
+                            [this, filePath]() {
+                                LOG_TRACE << "Erase cache";
+                                assert(
+                                    _staticFilesCache->getThreadData().find(
+                                        filePath) !=
+                                    _staticFilesCache->getThreadData().end());
+                                _staticFilesCache->getThreadData().erase(
+                                    filePath);
+                            });
+                    }
+                    HttpAppFrameworkImpl::instance().callCallback(req,
+                                                                  resp,
+                                                                  callback);
+                });
             return;
         }
     }
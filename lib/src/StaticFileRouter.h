@@ -15,6 +15,7 @@
 #pragma once
 
 #include "impl_forwards.h"
+#include "FileMetadataCache.h"
 #include <drogon/CacheMap.h>
 #include <drogon/IOThreadStorage.h>
 #include <functional>
@@ -67,6 +68,7 @@ class StaticFileRouter
 
     int _staticFilesCacheTime = 5;
     bool _enableLastModify = true;
+    bool _enableETag = true;
     bool _gzipStaticFlag = true;
     std::unique_ptr<
         IOThreadStorage<std::unique_ptr<CacheMap<std::string, char>>>>
@@ -74,5 +76,7 @@ class StaticFileRouter
     std::unique_ptr<
         IOThreadStorage<std::unordered_map<std::string, HttpResponsePtr>>>
         _staticFilesCache;
+    std::unique_ptr<IOThreadStorage<std::unique_ptr<FileMetadataCache>>>
+        _fileMetadataCache;
 };
 }  // namespace drogon
@@ -0,0 +1,240 @@
+/**
+ *
+ *  UpstreamGroup.cc
+ *  An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#include "UpstreamGroup.h"
+#include <drogon/HttpResponse.h>
+#include <trantor/utils/Date.h>
+#include <trantor/utils/Logger.h>
+#include <algorithm>
+
+using namespace drogon;
+
+/// The number of points of every host on the hash ring.
+#define UPSTREAM_RING_POINTS 160
+
+// FNV-1a with the finalizer of MurmurHash3, so similar strings are spread
+// over the ring.
+static uint32_t hashString(const std::string &str)
+{
+    uint32_t hash = 2166136261u;
+    for (auto c : str)
+    {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 16777619u;
+    }
+    hash ^= hash >> 16;
+    hash *= 0x85ebca6bu;
+    hash ^= hash >> 13;
+    hash *= 0xc2b2ae35u;
+    hash ^= hash >> 16;
+    return hash;
+}
+
+UpstreamGroup::UpstreamGroup(const std::string &name,
+                             const std::vector<std::string> &hosts,
+                             const std::string &balancing,
+                             const std::string &hashKey,
+                             const std::string &healthCheckPath,
+                             double healthCheckInterval,
+                             size_t maxFails,
+                             double ejectionTime,
+                             size_t retries)
+    : _name(name),
+      _healthCheckPath(healthCheckPath),
+      _healthCheckInterval(healthCheckInterval),
+      _maxFails(maxFails),
+      _ejectionTime(ejectionTime),
+      _retries(retries)
+{
+    assert(!hosts.empty());
+    for (auto &host : hosts)
+    {
+        _hosts.emplace_back(new Host(host));
+    }
+    if (balancing == "least_connections")
+    {
+        _balancing = kLeastConnections;
+    }
+    else if (balancing == "consistent_hash")
+    {
+        _balancing = kConsistentHash;
+        auto pos = hashKey.find(':');
+        if (pos != std::string::npos)
+        {
+            _hashByCookie = hashKey.compare(0, pos, "cookie") == 0;
+            _hashKeyName = hashKey.substr(pos + 1);
+        }
+        if (_hashKeyName.empty())
+        {
+            LOG_ERROR << "Invalid hash key of the upstream group " << name
+                      << ": " << hashKey;
+            _balancing = kRoundRobin;
+        }
+        for (size_t i = 0; i < _hosts.size(); ++i)
+        {
+            for (size_t j = 0; j < UPSTREAM_RING_POINTS; ++j)
+            {
+                _ring.emplace_back(
+                    hashString(_hosts[i]->_hostString + "#" +
+                               std::to_string(j)),
+                    i);
+            }
+        }
+        std::sort(_ring.begin(), _ring.end());
+    }
+    else
+    {
+        if (balancing != "round_robin")
+        {
+            LOG_ERROR << "Unknown balancing method of the upstream group "
+                      << name << ": " << balancing;
+        }
+        _balancing = kRoundRobin;
+    }
+}
+
+bool UpstreamGroup::isAvailable(size_t index, int64_t now) const
+{
+    auto &host = *_hosts[index];
+    return host._healthy && host._ejectedUntil <= now;
+}
+
+size_t UpstreamGroup::choose(const HttpRequestPtr &req, size_t excluded)
+{
+    auto now = trantor::Date::now().microSecondsSinceEpoch();
+    auto index = chooseIn(req, excluded, now, true);
+    if (index >= _hosts.size())
+    {
+        // All hosts are down, it's better to try one than to fail.
+        index = chooseIn(req, excluded, now, false);
+    }
+    ++_hosts[index]->_activeRequests;
+    return index;
+}
+
+size_t UpstreamGroup::chooseIn(const HttpRequestPtr &req,
+                               size_t excluded,
+                               int64_t now,
+                               bool strict)
+{
+    auto isCandidate = [this, excluded, now, strict](size_t index) {
+        if (index == excluded && _hosts.size() > 1)
+            return false;
+        return !strict || isAvailable(index, now);
+    };
+    if (_balancing == kConsistentHash)
+    {
+        auto &key = _hashByCookie ? req->getCookie(_hashKeyName)
+                                  : req->getHeader(_hashKeyName);
+        if (!key.empty())
+        {
+            auto iter = std::lower_bound(_ring.begin(),
+                                         _ring.end(),
+                                         std::make_pair(hashString(key),
+                                                        size_t(0)));
+            // Walk clockwise to the next available host, so only the keys
+            // of a host which is down are moved.
+            for (size_t i = 0; i < _ring.size(); ++i, ++iter)
+            {
+                if (iter == _ring.end())
+                    iter = _ring.begin();
+                if (isCandidate(iter->second))
+                    return iter->second;
+            }
+            return -1;
+        }
+    }
+    auto start = _next++;
+    size_t chosen = -1;
+    for (size_t i = 0; i < _hosts.size(); ++i)
+    {
+        auto index = (start + i) % _hosts.size();
+        if (!isCandidate(index))
+            continue;
+        if (_balancing != kLeastConnections)
+            return index;
+        if (chosen == size_t(-1) || _hosts[index]->_activeRequests <
+                                        _hosts[chosen]->_activeRequests)
+            chosen = index;
+    }
+    return chosen;
+}
+
+void UpstreamGroup::finishRequest(size_t index, bool success)
+{
+    auto &host = *_hosts[index];
+    --host._activeRequests;
+    if (success)
+    {
+        host._fails = 0;
+        return;
+    }
+    if (_maxFails == 0 || ++host._fails < _maxFails)
+        return;
+    host._fails = 0;
+    host._ejectedUntil =
+        trantor::Date::now().after(_ejectionTime).microSecondsSinceEpoch();
+    LOG_WARN << "Eject " << host._hostString << " from the upstream group "
+             << _name << " for " << _ejectionTime << "s";
+}
+
+void UpstreamGroup::startHealthChecks(trantor::EventLoop *loop)
+{
+    if (_healthCheckPath.empty() || _healthCheckInterval <= 0)
+        return;
+    for (auto &host : _hosts)
+    {
+        host->_healthCheckClient =
+            HttpClient::newHttpClient(host->_hostString, loop);
+    }
+    std::weak_ptr<UpstreamGroup> weakPtr = shared_from_this();
+    loop->runEvery(_healthCheckInterval, [weakPtr]() {
+        auto thisPtr = weakPtr.lock();
+        if (thisPtr)
+            thisPtr->checkHealth();
+    });
+}
+
+void UpstreamGroup::checkHealth()
+{
+    std::weak_ptr<UpstreamGroup> weakPtr = shared_from_this();
+    for (size_t i = 0; i < _hosts.size(); ++i)
+    {
+        // The checks of a host don't pile up while it doesn't answer, the
+        // pending one times out at the end of the interval.
+        if (_hosts[i]->_healthCheckPending)
+            continue;
+        _hosts[i]->_healthCheckPending = true;
+        auto req = HttpRequest::newHttpRequest();
+        req->setPath(_healthCheckPath);
+        _hosts[i]->_healthCheckClient->sendRequest(
+            req,
+            [weakPtr, i](ReqResult result, const HttpResponsePtr &resp) {
+                auto thisPtr = weakPtr.lock();
+                if (!thisPtr)
+                    return;
+                auto &host = *thisPtr->_hosts[i];
+                host._healthCheckPending = false;
+                bool healthy =
+                    result == ReqResult::Ok && resp->statusCode() < 500;
+                if (host._healthy.exchange(healthy) != healthy)
+                {
+                    LOG_WARN << "The host " << host._hostString
+                             << " of the upstream group " << thisPtr->_name
+                             << " is " << (healthy ? "up" : "down");
+                }
+            },
+            _healthCheckInterval);
+    }
+}
@@ -0,0 +1,150 @@
+/**
+ *
+ *  UpstreamGroup.h
+ *  An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#pragma once
+
+#include <drogon/HttpClient.h>
+#include <drogon/HttpRequest.h>
+#include <trantor/net/EventLoop.h>
+#include <trantor/utils/NonCopyable.h>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace drogon
+{
+/**
+ * @brief A named group of upstream hosts for the forward() method.
+ *
+ * The group chooses a host for every request by its balancing method and
+ * keeps the health of the hosts:
+ * - A host is ejected for a while when its requests fail a number of times
+ *   in a row (passive checks and outlier ejection).
+ * - A host is marked down when the request to its health check path fails
+ *   (active checks).
+ * When all hosts are down, they are chosen anyway.
+ *
+ * The group is shared by all IO threads, all methods are thread safe.
+ */
+class UpstreamGroup : public trantor::NonCopyable,
+                      public std::enable_shared_from_this<UpstreamGroup>
+{
+  public:
+    enum Balancing
+    {
+        kRoundRobin = 0,
+        kLeastConnections,
+        kConsistentHash
+    };
+
+    /**
+     * @param balancing is one of "round_robin", "least_connections" and
+     * "consistent_hash".
+     * @param hashKey is the value hashed by the consistent hash method, it's
+     * "header:<name>" or "cookie:<name>". Requests without the value are
+     * balanced in round robin.
+     * @param healthCheckPath is the path of the active health checks, they
+     * are disabled if it's empty.
+     */
+    UpstreamGroup(const std::string &name,
+                  const std::vector<std::string> &hosts,
+                  const std::string &balancing,
+                  const std::string &hashKey,
+                  const std::string &healthCheckPath,
+                  double healthCheckInterval,
+                  size_t maxFails,
+                  double ejectionTime,
+                  size_t retries);
+
+    const std::string &name() const
+    {
+        return _name;
+    }
+
+    /// The number of times a failed idempotent request is sent to another
+    /// host.
+    size_t retries() const
+    {
+        return _retries;
+    }
+
+    const std::string &hostString(size_t index) const
+    {
+        return _hosts[index]->_hostString;
+    }
+
+    /// Choose a host for the request other than the excluded one if
+    /// possible, and return its index. Every chosen host must be released
+    /// by the finishRequest() method.
+    size_t choose(const HttpRequestPtr &req, size_t excluded = -1);
+
+    /// Record the outcome of a request sent to the host.
+    void finishRequest(size_t index, bool success);
+
+    /// Send a GET request to the health check path of every host
+    /// periodically in the loop, a host is down while the request fails,
+    /// isn't answered within the interval or gets a 5xx response.
+    void startHealthChecks(trantor::EventLoop *loop);
+
+    /// Return true if a request with the method can be sent again.
+    static bool isIdempotent(HttpMethod method)
+    {
+        return method != Post && method != Invalid;
+    }
+
+  private:
+    struct Host
+    {
+        explicit Host(const std::string &hostString)
+            : _hostString(hostString)
+        {
+        }
+        std::string _hostString;
+        std::atomic<size_t> _activeRequests{0};
+        std::atomic<size_t> _fails{0};
+        // In microseconds since the epoch.
+        std::atomic<int64_t> _ejectedUntil{0};
+        std::atomic<bool> _healthy{true};
+        HttpClientPtr _healthCheckClient;
+        // Only used in the loop of the health checks.
+        bool _healthCheckPending = false;
+    };
+    bool isAvailable(size_t index, int64_t now) const;
+    size_t chooseIn(const HttpRequestPtr &req,
+                    size_t excluded,
+                    int64_t now,
+                    bool strict);
+    void checkHealth();
+
+    std::string _name;
+    std::vector<std::unique_ptr<Host>> _hosts;
+    Balancing _balancing;
+    bool _hashByCookie = false;
+    std::string _hashKeyName;
+    std::string _healthCheckPath;
+    double _healthCheckInterval;
+    size_t _maxFails;
+    double _ejectionTime;
+    size_t _retries;
+    std::atomic<size_t> _next{0};
+    // The hash ring of the consistent hash method, every host has a number
+    // of points on it, sorted by the hashes.
+    std::vector<std::pair<uint32_t, size_t>> _ring;
+};
+
+typedef std::shared_ptr<UpstreamGroup> UpstreamGroupPtr;
+
+}  // namespace drogon
@@ -0,0 +1,65 @@
+/**
+ *
+ *  WebSocketAcceptKey.cc
+ *  An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#include "WebSocketAcceptKey.h"
+#include <drogon/config.h>
+#ifdef OpenSSL_FOUND
+#include <openssl/sha.h>
+#else
+#include "ssl_funcs/Sha1.h"
+#endif
+#include <stdint.h>
+#include <string.h>
+
+static const char webSocketGuid[] = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+static const char base64Chars[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+bool drogon::computeWebSocketAcceptKey(const char *key,
+                                       size_t len,
+                                       char *out)
+{
+    constexpr size_t guidLength = sizeof(webSocketGuid) - 1;
+    // Two SHA1 blocks, keys of up to 92 bytes fit. The 24-byte key of a
+    // client and the GUID take 60 bytes, so with the 9 bytes of padding they
+    // take two blocks as well.
+    unsigned char buf[128];
+    if (len == 0 || len > sizeof(buf) - guidLength)
+        return false;
+    memcpy(buf, key, len);
+    memcpy(buf + len, webSocketGuid, guidLength);
+    unsigned char digest[SHA_DIGEST_LENGTH];
+    SHA1(buf, len + guidLength, digest);
+
+    // 20 bytes are encoded into six 3-byte groups and a 2-byte group.
+    static_assert(SHA_DIGEST_LENGTH == 20, "Unexpected digest length");
+    static_assert(WEBSOCKET_ACCEPT_KEY_LENGTH == 28,
+                  "Unexpected accept key length");
+    size_t i = 0;
+    for (; i < 18; i += 3)
+    {
+        uint32_t group = (digest[i] << 16) | (digest[i + 1] << 8) |
+                         digest[i + 2];
+        *out++ = base64Chars[(group >> 18) & 0x3f];
+        *out++ = base64Chars[(group >> 12) & 0x3f];
+        *out++ = base64Chars[(group >> 6) & 0x3f];
+        *out++ = base64Chars[group & 0x3f];
+    }
+    uint32_t group = (digest[i] << 16) | (digest[i + 1] << 8);
+    *out++ = base64Chars[(group >> 18) & 0x3f];
+    *out++ = base64Chars[(group >> 12) & 0x3f];
+    *out++ = base64Chars[(group >> 6) & 0x3f];
+    *out = '=';
+    return true;
+}
@@ -0,0 +1,41 @@
+/**
+ *
+ *  WebSocketAcceptKey.h
+ *  An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#pragma once
+
+#include <stddef.h>
+
+/// The length of the base64 encoded SHA1 digest.
+#define WEBSOCKET_ACCEPT_KEY_LENGTH 28
+
+namespace drogon
+{
+/**
+ * @brief Compute the value of the Sec-WebSocket-Accept header for the value
+ * of the Sec-WebSocket-Key header (rfc6455-4.2.2).
+ *
+ * The key and the GUID are hashed in a buffer on the stack, and the digest is
+ * encoded into the output buffer directly, so no memory is allocated on the
+ * heap. A valid key is 24 characters long, longer keys are accepted as long
+ * as they fit into the buffer.
+ *
+ * @param key The value of the Sec-WebSocket-Key header.
+ * @param len The length of the key.
+ * @param out The buffer of WEBSOCKET_ACCEPT_KEY_LENGTH bytes, it's not
+ * terminated by '\0'.
+ * @return false if the key is empty or too long.
+ */
+bool computeWebSocketAcceptKey(const char *key, size_t len, char *out);
+
+}  // namespace drogon
@@ -17,16 +17,12 @@
 #include "HttpRequestImpl.h"
 #include "HttpResponseParser.h"
 #include "HttpUtils.h"
+#include "WebSocketAcceptKey.h"
 #include "WebSocketConnectionImpl.h"
 #include "HttpAppFrameworkImpl.h"
 #include <drogon/utils/Utilities.h>
 #include <drogon/config.h>
 #include <trantor/net/InetAddress.h>
-#ifdef OpenSSL_FOUND
-#include <openssl/sha.h>
-#else
-#include "ssl_funcs/Sha1.h"
-#endif
 
 using namespace drogon;
 using namespace trantor;
@@ -79,6 +75,14 @@ void WebSocketClientImpl::createTcpClient()
         thisPtr->_requestCallback(ReqResult::NetworkFailure, nullptr, thisPtr);
         thisPtr->_loop->runAfter(1.0, [thisPtr]() { thisPtr->reconnect(); });
     });
+    _tcpClient->setWriteCompleteCallback(
+        [weakPtr](const trantor::TcpConnectionPtr &) {
+            auto thisPtr = weakPtr.lock();
+            if (thisPtr && thisPtr->_websockConnPtr)
+            {
+                thisPtr->_websockConnPtr->onWriteComplete();
+            }
+        });
     _tcpClient->setMessageCallback(
         [weakPtr](const trantor::TcpConnectionPtr &connPtr,
                   trantor::MsgBuffer *msg) {
@@ -99,15 +103,17 @@ void WebSocketClientImpl::connectToServerInLoop()
     _wsKey = utils::base64Encode((const unsigned char *)randStr.data(),
                                  (unsigned int)randStr.length());
 
-    auto wsKey = _wsKey;
-    wsKey.append("258EAFA5-E914-47DA-95CA-C5AB0DC85B11");
-    unsigned char accKey[SHA_DIGEST_LENGTH];
-    SHA1(reinterpret_cast<const unsigned char *>(wsKey.c_str()),
-         wsKey.length(),
-         accKey);
-    _wsAccept = utils::base64Encode(accKey, SHA_DIGEST_LENGTH);
+    char accKey[WEBSOCKET_ACCEPT_KEY_LENGTH];
+    computeWebSocketAcceptKey(_wsKey.data(), _wsKey.length(), accKey);
+    _wsAccept.assign(accKey, WEBSOCKET_ACCEPT_KEY_LENGTH);
 
     _upgradeRequest->addHeader("Sec-WebSocket-Key", _wsKey);
+    if (_compressionWindowBits > 0)
+    {
+        _upgradeRequest->addHeader(
+            "Sec-WebSocket-Extensions",
+            WebSocketDeflate::makeOffer(_compressionWindowBits));
+    }
     //_upgradeRequest->addHeader("Sec-WebSocket-Version","13");
 
     assert(!_tcpClient);
@@ -210,9 +216,19 @@ void WebSocketClientImpl::onRecvMessage(
         auto resp = responseParser->responseImpl();
         responseParser->reset();
         auto acceptStr = resp->getHeaderBy("sec-websocket-accept");
+        auto &extension = resp->getHeaderBy("sec-websocket-extensions");
+        // The server must not use extensions which are not offered.
+        bool extensionValid = extension.empty();
+        std::unique_ptr<WebSocketDeflate> deflate;
+        if (_compressionWindowBits > 0)
+        {
+            deflate = WebSocketDeflate::acceptResponse(extension,
+                                                       _compressionWindowBits,
+                                                       extensionValid);
+        }
 
         if (resp->statusCode() != k101SwitchingProtocols ||
-            acceptStr != _wsAccept)
+            acceptStr != _wsAccept || !extensionValid)
         {
             _requestCallback(ReqResult::BadResponse,
                              nullptr,
@@ -237,6 +253,8 @@ void WebSocketClientImpl::onRecvMessage(
         _upgraded = true;
         _websockConnPtr =
             std::make_shared<WebSocketConnectionImpl>(connPtr, false);
+        if (deflate)
+            _websockConnPtr->setDeflate(std::move(deflate));
         auto thisPtr = shared_from_this();
         _websockConnPtr->setMessageCallback(
             [thisPtr](std::string &&message,
@@ -48,6 +48,12 @@ class WebSocketClientImpl
         _connectionClosedCallback = callback;
     }
 
+    virtual void enableCompression(int maxWindowBits = 15) override
+    {
+        assert(maxWindowBits >= 9 && maxWindowBits <= 15);
+        _compressionWindowBits = maxWindowBits;
+    }
+
     virtual void connectToServer(
         const HttpRequestPtr &request,
         const WebSocketRequestCallback &callback) override;
@@ -75,6 +81,8 @@ class WebSocketClientImpl
     bool _upgraded = false;
     std::string _wsKey;
     std::string _wsAccept;
+    // 0 means that the permessage-deflate extension is not offered.
+    int _compressionWindowBits = 0;
 
     HttpRequestPtr _upgradeRequest;
     std::function<void(std::string &&,
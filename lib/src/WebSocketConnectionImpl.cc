@@ -14,10 +14,76 @@
 
 #include "WebSocketConnectionImpl.h"
 #include "HttpAppFrameworkImpl.h"
+#include <algorithm>
 #include <thread>
+#include <string.h>
 #include <trantor/net/inner/TcpConnectionImpl.h>
+#include <trantor/utils/ConcurrentTaskQueue.h>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
 
 using namespace drogon;
+
+// The size of the messages of a connection waiting for the workers, the
+// connection is closed if its messages arrive faster than they are handled.
+#define WEBSOCKET_MAX_WORKER_BYTES (4 * 1024 * 1024)
+
+void drogon::applyWebSocketMask(char *dest,
+                                const char *src,
+                                size_t len,
+                                const char *maskingKey)
+{
+    // Every block below is a multiple of 4 bytes long, so the masking key
+    // repeated in a register keeps its phase across blocks.
+    uint32_t mask32;
+    memcpy(&mask32, maskingKey, 4);
+    size_t i = 0;
+#if defined(__AVX2__)
+    auto mask256 = _mm256_set1_epi32(static_cast<int>(mask32));
+    for (; i + 32 <= len; i += 32)
+    {
+        auto data = _mm256_loadu_si256(
+            reinterpret_cast<const __m256i *>(src + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dest + i),
+                            _mm256_xor_si256(data, mask256));
+    }
+#endif
+#if defined(__SSE2__)
+    auto mask128 = _mm_set1_epi32(static_cast<int>(mask32));
+    for (; i + 16 <= len; i += 16)
+    {
+        auto data =
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dest + i),
+                         _mm_xor_si128(data, mask128));
+    }
+#elif defined(__ARM_NEON)
+    auto mask128 = vreinterpretq_u8_u32(vdupq_n_u32(mask32));
+    for (; i + 16 <= len; i += 16)
+    {
+        auto data = vld1q_u8(reinterpret_cast<const uint8_t *>(src + i));
+        vst1q_u8(reinterpret_cast<uint8_t *>(dest + i),
+                 veorq_u8(data, mask128));
+    }
+#endif
+    uint64_t mask64 = (static_cast<uint64_t>(mask32) << 32) | mask32;
+    for (; i + 8 <= len; i += 8)
+    {
+        uint64_t data;
+        memcpy(&data, src + i, 8);
+        data ^= mask64;
+        memcpy(dest + i, &data, 8);
+    }
+    for (; i < len; ++i)
+    {
+        dest[i] = src[i] ^ maskingKey[i & 3];
+    }
+}
 WebSocketConnectionImpl::WebSocketConnectionImpl(
     const trantor::TcpConnectionPtr &conn,
     bool isServer)
@@ -28,79 +94,140 @@ WebSocketConnectionImpl::WebSocketConnectionImpl(
 {
 }
 
-void WebSocketConnectionImpl::send(const char *msg,
-                                   uint64_t len,
-                                   const WebSocketMessageType &type)
+WebSocketConnectionImpl::~WebSocketConnectionImpl()
+{
+    if (_pingTimerId != trantor::InvalidTimerId)
+        _tcpConn->getLoop()->invalidateTimer(_pingTimerId);
+}
+
+static unsigned char getOpcode(const WebSocketMessageType &type, uint64_t len)
 {
-    unsigned char opcode;
     if (type == WebSocketMessageType::Text)
-        opcode = 1;
+        return 1;
     else if (type == WebSocketMessageType::Binary)
-        opcode = 2;
+        return 2;
     else if (type == WebSocketMessageType::Close)
     {
         assert(len <= 125);
-        opcode = 8;
+        return 8;
     }
     else if (type == WebSocketMessageType::Ping)
     {
         assert(len <= 125);
-        opcode = 9;
+        return 9;
     }
     else if (type == WebSocketMessageType::Pong)
     {
         assert(len <= 125);
-        opcode = 10;
+        return 10;
     }
-    else
+    assert(0);
+    (void)len;
+    return 0;
+}
+
+// Write the header of an unmasked frame into buf, which must hold 10 bytes at
+// least, and return the length of the header.
+static size_t encodeFrameHeader(char *buf, uint64_t len, unsigned char opcode)
+{
+    buf[0] = char(0x80 | (opcode & 0x0f));
+    if (len <= 125)
+    {
+        buf[1] = len;
+        return 2;
+    }
+    else if (len <= 65535)
     {
-        opcode = 0;
-        assert(0);
+        buf[1] = 126;
+        buf[2] = ((len >> 8) & 255);
+        buf[3] = ((len)&255);
+        return 4;
+    }
+    buf[1] = 127;
+    buf[2] = ((len >> 56) & 255);
+    buf[3] = ((len >> 48) & 255);
+    buf[4] = ((len >> 40) & 255);
+    buf[5] = ((len >> 32) & 255);
+    buf[6] = ((len >> 24) & 255);
+    buf[7] = ((len >> 16) & 255);
+    buf[8] = ((len >> 8) & 255);
+    buf[9] = ((len)&255);
+    return 10;
+}
+
+WebSocketFramePtr WebSocketFrame::newFrame(const char *msg,
+                                           uint64_t len,
+                                           const WebSocketMessageType &type)
+{
+    WebSocketFramePtr frame(new WebSocketFrame);
+    char header[10];
+    frame->_headerLength =
+        encodeFrameHeader(header, len, getOpcode(type, len));
+    frame->_data.reserve(frame->_headerLength + len);
+    frame->_data.append(header, frame->_headerLength);
+    frame->_data.append(msg, len);
+    frame->_type = type;
+    return frame;
+}
+
+void WebSocketConnectionImpl::send(const char *msg,
+                                   uint64_t len,
+                                   const WebSocketMessageType &type)
+{
+    auto opcode = getOpcode(type, len);
+    // Check the limit before compressing, the compression context must not
+    // contain dropped messages.
+    if (exceedsSendQueueLimit(opcode, len))
+        return;
+    // Only data frames are compressed, rfc7692-6
+    if (_deflate && _deflate->canCompress() && (opcode == 1 || opcode == 2))
+    {
+        std::string compressedMsg;
+        std::lock_guard<std::mutex> guard(_deflateMutex);
+        if (_deflate->compress(msg, len, compressedMsg))
+        {
+            sendWsData(compressedMsg.data(),
+                       compressedMsg.length(),
+                       opcode,
+                       true);
+            return;
+        }
     }
     sendWsData(msg, len, opcode);
 }
 
+void WebSocketConnectionImpl::sendFrame(const WebSocketFramePtr &frame)
+{
+    if (!_isServer)
+    {
+        // The payload must be masked by clients.
+        send(frame->payload(), frame->payloadLength(), frame->type());
+        return;
+    }
+    if (exceedsSendQueueLimit(getOpcode(frame->type(), 0),
+                              frame->data().length()))
+        return;
+    LOG_TRACE << "send frame of " << frame->payloadLength() << " bytes";
+    // Share the frame with the connection instead of copying it, trantor
+    // never modifies the string.
+    sendToTcp(std::shared_ptr<std::string>(
+                  frame, const_cast<std::string *>(&frame->data())),
+              frame->data().length());
+}
+
 void WebSocketConnectionImpl::sendWsData(const char *msg,
                                          uint64_t len,
-                                         unsigned char opcode)
+                                         unsigned char opcode,
+                                         bool compressed)
 {
     LOG_TRACE << "send " << len << " bytes";
 
     // Format the frame
+    char header[14];
+    auto headerLength = encodeFrameHeader(header, len, opcode);
+    if (compressed)
+        header[0] |= 0x40;  // RSV1
     std::string bytesFormatted;
-    bytesFormatted.resize(len + 10);
-    bytesFormatted[0] = char(0x80 | (opcode & 0x0f));
-
-    int indexStartRawData = -1;
-
-    if (len <= 125)
-    {
-        bytesFormatted[1] = len;
-        indexStartRawData = 2;
-    }
-    else if (len <= 65535)
-    {
-        bytesFormatted[1] = 126;
-        bytesFormatted[2] = ((len >> 8) & 255);
-        bytesFormatted[3] = ((len)&255);
-        LOG_TRACE << "bytes[2]=" << (size_t)bytesFormatted[2];
-        LOG_TRACE << "bytes[3]=" << (size_t)bytesFormatted[3];
-        indexStartRawData = 4;
-    }
-    else
-    {
-        bytesFormatted[1] = 127;
-        bytesFormatted[2] = ((len >> 56) & 255);
-        bytesFormatted[3] = ((len >> 48) & 255);
-        bytesFormatted[4] = ((len >> 40) & 255);
-        bytesFormatted[5] = ((len >> 32) & 255);
-        bytesFormatted[6] = ((len >> 24) & 255);
-        bytesFormatted[7] = ((len >> 16) & 255);
-        bytesFormatted[8] = ((len >> 8) & 255);
-        bytesFormatted[9] = ((len)&255);
-
-        indexStartRawData = 10;
-    }
     if (!_isServer)
     {
         // Add masking key;
@@ -108,21 +235,90 @@ void WebSocketConnectionImpl::sendWsData(const char *msg,
         std::call_once(once, []() { std::srand(time(nullptr)); });
         int random = std::rand();
 
-        bytesFormatted[1] = (bytesFormatted[1] | 0x80);
-        bytesFormatted.resize(indexStartRawData + 4 + len);
-        *((int *)&bytesFormatted[indexStartRawData]) = random;
-        for (size_t i = 0; i < len; i++)
-        {
-            bytesFormatted[indexStartRawData + 4 + i] =
-                (msg[i] ^ bytesFormatted[indexStartRawData + (i % 4)]);
-        }
+        header[1] = (header[1] | 0x80);
+        memcpy(header + headerLength, &random, 4);
+        headerLength += 4;
+        bytesFormatted.resize(headerLength + len);
+        memcpy(&bytesFormatted[0], header, headerLength);
+        applyWebSocketMask(&bytesFormatted[headerLength],
+                           msg,
+                           len,
+                           header + headerLength - 4);
     }
     else
     {
-        bytesFormatted.resize(indexStartRawData);
+        bytesFormatted.reserve(headerLength + len);
+        bytesFormatted.append(header, headerLength);
         bytesFormatted.append(msg, len);
     }
-    _tcpConn->send(std::move(bytesFormatted));
+    auto frameLength = bytesFormatted.length();
+    sendToTcp(std::move(bytesFormatted), frameLength);
+}
+
+bool WebSocketConnectionImpl::exceedsSendQueueLimit(unsigned char opcode,
+                                                    size_t len) const
+{
+    auto limit = _sendQueueLimit.load(std::memory_order_relaxed);
+    if (limit == 0 || (opcode != 1 && opcode != 2) ||
+        bufferedAmount() + len <= limit)
+        return false;
+    LOG_WARN << "The send queue to " << _peerAddr.toIpPort()
+             << " is full, a message of " << len << " bytes is dropped";
+    return true;
+}
+
+template <typename T>
+void WebSocketConnectionImpl::sendToTcp(T &&data, size_t len)
+{
+    auto loop = _tcpConn->getLoop();
+    // Data sent in the IO thread is queued too if data sent by other threads
+    // is waiting, to keep the order of messages.
+    if (loop->isInLoopThread() &&
+        _pendingBytes.load(std::memory_order_relaxed) == 0)
+    {
+        sendInLoop(std::forward<T>(data));
+        return;
+    }
+    _pendingBytes.fetch_add(len, std::memory_order_relaxed);
+    loop->queueInLoop(
+        [thisPtr = shared_from_this(),
+         data = std::forward<T>(data),
+         len]() mutable {
+            thisPtr->sendInLoop(std::move(data));
+            thisPtr->_pendingBytes.fetch_sub(len, std::memory_order_relaxed);
+        });
+}
+
+template <typename T>
+void WebSocketConnectionImpl::sendInLoop(T &&data)
+{
+    if (!_outputTracked)
+    {
+        _outputTracked = true;
+        std::weak_ptr<WebSocketConnectionImpl> weakPtr = shared_from_this();
+        _tcpConn->setHighWaterMarkCallback(
+            [weakPtr](const trantor::TcpConnectionPtr &, const size_t size) {
+                auto thisPtr = weakPtr.lock();
+                if (thisPtr)
+                    thisPtr->onOutputBuffered(size);
+            },
+            0);
+    }
+    _outputBuffered = false;
+    _tcpConn->send(std::forward<T>(data));
+    // Nothing is left in the buffer if the data is written directly.
+    if (!_outputBuffered)
+        _bufferedBytes.store(0, std::memory_order_relaxed);
+}
+
+void WebSocketConnectionImpl::onOutputBuffered(size_t size)
+{
+    _outputBuffered = true;
+    _bufferedBytes.store(size, std::memory_order_relaxed);
+    if (_congestionMark > 0 && size > _congestionMark)
+        _congested = true;
+    if (_highWaterMarkCallback && size > _highWaterMark)
+        _highWaterMarkCallback(shared_from_this(), size);
 }
 void WebSocketConnectionImpl::send(const std::string &msg,
                                    const WebSocketMessageType &type)
@@ -155,25 +351,249 @@ void WebSocketConnectionImpl::WebSocketConnectionImpl::forceClose()
     _tcpConn->forceClose();
 }
 
+void WebSocketConnectionImpl::setHighWaterMarkCallback(
+    const std::function<void(const WebSocketConnectionPtr &, size_t)>
+        &callback,
+    size_t markLen)
+{
+    auto thisPtr = shared_from_this();
+    _tcpConn->getLoop()->runInLoop([thisPtr, callback, markLen]() {
+        thisPtr->_highWaterMarkCallback = callback;
+        thisPtr->_highWaterMark = markLen;
+    });
+}
+
+void WebSocketConnectionImpl::setWriteCompleteCallback(
+    const std::function<void(const WebSocketConnectionPtr &)> &callback)
+{
+    auto thisPtr = shared_from_this();
+    _tcpConn->getLoop()->runInLoop(
+        [thisPtr, callback]() { thisPtr->_writeCompleteCallback = callback; });
+}
+
+void WebSocketConnectionImpl::onWriteComplete()
+{
+    _bufferedBytes.store(0, std::memory_order_relaxed);
+    if (_writeCompleteCallback)
+        _writeCompleteCallback(shared_from_this());
+    if (!_congested)
+        return;
+    _congested = false;
+    for (auto &callback : _drainCallbacks)
+    {
+        callback.second();
+    }
+}
+
 void WebSocketConnectionImpl::setPingMessage(
     const std::string &message,
     const std::chrono::duration<long double> &interval)
 {
-    std::weak_ptr<WebSocketConnectionImpl> weakPtr = shared_from_this();
-    _pingTimerId =
-        _tcpConn->getLoop()->runEvery(interval.count(), [weakPtr, message]() {
-            auto thisPtr = weakPtr.lock();
-            if (thisPtr)
+    auto thisPtr = shared_from_this();
+    _tcpConn->getLoop()->runInLoop([thisPtr, message, interval]() {
+        thisPtr->startTimers();
+        thisPtr->_pingMessage = message;
+        auto loop = thisPtr->_tcpConn->getLoop();
+        if (thisPtr->_pingTimerId != trantor::InvalidTimerId)
+        {
+            loop->invalidateTimer(thisPtr->_pingTimerId);
+            thisPtr->_pingTimerId = trantor::InvalidTimerId;
+        }
+        if (interval.count() < WebSocketTimingWheel::kTickInterval)
+        {
+            // The wheel would round the interval up to one tick.
+            thisPtr->_pingInterval = 0;
+            std::weak_ptr<WebSocketConnectionImpl> weakPtr = thisPtr;
+            thisPtr->_pingTimerId =
+                loop->runEvery(static_cast<double>(interval.count()),
+                               [weakPtr]() {
+                                   auto thisPtr = weakPtr.lock();
+                                   if (thisPtr)
+                                       thisPtr->sendPing();
+                               });
+            return;
+        }
+        thisPtr->_pingInterval = WebSocketTimingWheel::toTicks(interval);
+        thisPtr->_nextPingTick =
+            thisPtr->_timingWheel->ticks() + thisPtr->_pingInterval;
+        thisPtr->updateTimer();
+    });
+}
+
+void WebSocketConnectionImpl::sendPing()
+{
+    if (!_tcpConn->connected())
+    {
+        _tcpConn->getLoop()->invalidateTimer(_pingTimerId);
+        _pingTimerId = trantor::InvalidTimerId;
+        return;
+    }
+    send(_pingMessage, WebSocketMessageType::Ping);
+    if (_pongTimeout > 0 && _pongDeadline == 0)
+    {
+        _pongDeadline = _timingWheel->ticks() + _pongTimeout + 1;
+        updateTimer();
+    }
+}
+
+void WebSocketConnectionImpl::setPongTimeout(
+    const std::chrono::duration<long double> &timeout)
+{
+    auto thisPtr = shared_from_this();
+    _tcpConn->getLoop()->runInLoop([thisPtr, timeout]() {
+        thisPtr->startTimers();
+        thisPtr->_pongTimeout =
+            timeout.count() > 0 ? WebSocketTimingWheel::toTicks(timeout) : 0;
+    });
+}
+
+void WebSocketConnectionImpl::setIdleTimeout(
+    const std::chrono::duration<long double> &timeout)
+{
+    auto thisPtr = shared_from_this();
+    _tcpConn->getLoop()->runInLoop([thisPtr, timeout]() {
+        thisPtr->startTimers();
+        thisPtr->_idleTimeout =
+            timeout.count() > 0 ? WebSocketTimingWheel::toTicks(timeout) : 0;
+        thisPtr->updateTimer();
+    });
+}
+
+void WebSocketConnectionImpl::startTimers()
+{
+    if (_timingWheel)
+        return;
+    _timingWheel = WebSocketTimingWheel::get(_tcpConn->getLoop());
+    _lastActiveTick = _timingWheel->ticks();
+}
+
+void WebSocketConnectionImpl::updateTimer()
+{
+    size_t tick = 0;
+    auto earlier = [&tick](size_t t) {
+        if (t > 0 && (tick == 0 || t < tick))
+            tick = t;
+    };
+    if (_pingInterval > 0)
+        earlier(_nextPingTick);
+    earlier(_pongDeadline);
+    if (_idleTimeout > 0)
+        earlier(_lastActiveTick + _idleTimeout + 1);
+    if (tick == 0)
+        return;
+    if (tick <= _timingWheel->ticks())
+        tick = _timingWheel->ticks() + 1;
+    // A later entry would be ignored, an earlier one finds that nothing
+    // expires and schedules the next one.
+    if (_timerTick != 0 && _timerTick <= tick)
+        return;
+    _timerTick = tick;
+    _timingWheel->schedule(shared_from_this(), tick);
+}
+
+void WebSocketConnectionImpl::onTimer(size_t tick)
+{
+    if (tick != _timerTick || !_tcpConn->connected())
+        return;
+    _timerTick = 0;
+    auto now = _timingWheel->ticks();
+    // Part of the current tick has already passed, so the deadlines are one
+    // tick later than the timeouts, which are kept as minimums.
+    if (_idleTimeout > 0 && now >= _lastActiveTick + _idleTimeout + 1)
+    {
+        LOG_DEBUG << "Close the idle WebSocket connection to "
+                  << _peerAddr.toIpPort();
+        forceClose();
+        return;
+    }
+    if (_pongDeadline > 0 && now >= _pongDeadline)
+    {
+        LOG_DEBUG << "No pong is received from " << _peerAddr.toIpPort();
+        forceClose();
+        return;
+    }
+    if (_pingInterval > 0 && now >= _nextPingTick)
+    {
+        send(_pingMessage, WebSocketMessageType::Ping);
+        _nextPingTick = now + _pingInterval;
+        if (_pongTimeout > 0 && _pongDeadline == 0)
+            _pongDeadline = now + _pongTimeout + 1;
+    }
+    updateTimer();
+}
+
+bool WebSocketConnectionImpl::runInWorkers(std::function<void()> &&task,
+                                           size_t bytes)
+{
+    {
+        std::lock_guard<std::mutex> lock(_workerMutex);
+        // One message is always accepted however large it is, the close
+        // event (0 bytes) is never rejected.
+        auto maxBytes = std::max<size_t>(
+            WEBSOCKET_MAX_WORKER_BYTES,
+            HttpAppFrameworkImpl::instance()
+                .getClientMaxWebSocketMessageSize());
+        if (bytes > 0 && _workerQueuedBytes > 0 &&
+            _workerQueuedBytes + bytes > maxBytes)
+            return false;
+        _workerTasks.emplace_back(std::move(task), bytes);
+        _workerQueuedBytes += bytes;
+        if (_workerRunning)
+            return true;
+        _workerRunning = true;
+    }
+    auto thisPtr = shared_from_this();
+    _workerQueue->runTaskInQueue([thisPtr]() { thisPtr->runWorkerTasks(); });
+    return true;
+}
+
+void WebSocketConnectionImpl::closeOverloaded(
+    const trantor::TcpConnectionPtr &connPtr)
+{
+    LOG_WARN << "The messages from " << _peerAddr.toIpPort()
+             << " arrive faster than they are handled, close the connection";
+    _workerOverloaded = true;
+    // The status code 1008 (policy violation), rfc6455-7.4.1
+    const char payload[] = {'\x03', '\xf0'};
+    send(payload, sizeof(payload), WebSocketMessageType::Close);
+    connPtr->shutdown();
+}
+
+void WebSocketConnectionImpl::runWorkerTasks()
+{
+    // Run a limited number of tasks each time, so a busy connection can't
+    // occupy a worker for long.
+    for (int i = 0; i < 16; ++i)
+    {
+        std::function<void()> task;
+        {
+            std::lock_guard<std::mutex> lock(_workerMutex);
+            if (_workerTasks.empty())
             {
-                thisPtr->send(message, WebSocketMessageType::Ping);
+                _workerRunning = false;
+                return;
             }
-        });
+            task = std::move(_workerTasks.front().first);
+            _workerQueuedBytes -= _workerTasks.front().second;
+            _workerTasks.pop_front();
+        }
+        task();
+    }
+    auto thisPtr = shared_from_this();
+    _workerQueue->runTaskInQueue([thisPtr]() { thisPtr->runWorkerTasks(); });
 }
 
 bool WebSocketMessageParser::parse(trantor::MsgBuffer *buffer)
 {
     // According to the rfc6455
     _gotAll = false;
+    _gotFragment = false;
+    if (_frameRemaining > 0)
+    {
+        // The rest of a data frame in the streaming mode
+        parsePayload(buffer);
+        return true;
+    }
     if (buffer->readableBytes() >= 2)
     {
         unsigned char opcode = (*buffer)[0] & 0x0f;
@@ -214,6 +634,18 @@ bool WebSocketMessageParser::parse(trantor::MsgBuffer *buffer)
             LOG_ERROR << "Bad frame: all control frames MUST NOT be fragmented";
             return false;
         }
+        bool rsv1 = (((*buffer)[0] & 0x40) == 0x40);
+        if (rsv1 && (!_compressionEnabled || isControlFrame || opcode == 0))
+        {
+            // rfc7692-6.1
+            LOG_ERROR << "Bad frame: unexpected RSV1 bit";
+            return false;
+        }
+        if (opcode == 1 || opcode == 2)
+        {
+            _compressed = rsv1;
+            _streamType = _type;
+        }
         auto secondByte = (*buffer)[1];
         size_t length = secondByte & 127;
         int isMasked = (secondByte & 0x80);
@@ -265,6 +697,22 @@ bool WebSocketMessageParser::parse(trantor::MsgBuffer *buffer)
                 return false;
             }
         }
+        if (_streaming && !isControlFrame)
+        {
+            // Messages are not accumulated, so their length isn't limited.
+            size_t headerLength = indexFirstMask + (isMasked != 0 ? 4 : 0);
+            if (buffer->readableBytes() < headerLength)
+                return true;
+            _masked = (isMasked != 0);
+            if (_masked)
+                memcpy(_maskingKey, buffer->peek() + indexFirstMask, 4);
+            _maskOffset = 0;
+            _isFin = isFin;
+            _frameRemaining = length;
+            buffer->retrieve(headerLength);
+            parsePayload(buffer);
+            return true;
+        }
         if (isMasked != 0)
         {
             // The message is sent by the client, check the length
@@ -282,10 +730,7 @@ bool WebSocketMessageParser::parse(trantor::MsgBuffer *buffer)
                 auto rawData = buffer->peek() + indexFirstDataByte;
                 auto oldLen = _message.length();
                 _message.resize(oldLen + length);
-                for (size_t i = 0; i < length; i++)
-                {
-                    _message[oldLen + i] = (rawData[i] ^ masks[i % 4]);
-                }
+                applyWebSocketMask(&_message[oldLen], rawData, length, masks);
                 if (isFin)
                     _gotAll = true;
                 buffer->retrieve(indexFirstMask + 4 + length);
@@ -308,24 +753,81 @@ bool WebSocketMessageParser::parse(trantor::MsgBuffer *buffer)
     return true;
 }
 
+void WebSocketMessageParser::parsePayload(trantor::MsgBuffer *buffer)
+{
+    assert(_message.empty());
+    auto len = std::min(_frameRemaining, buffer->readableBytes());
+    if (_masked)
+    {
+        // Rotate the masking key to the phase of the first byte.
+        char maskingKey[4];
+        for (size_t i = 0; i < 4; ++i)
+        {
+            maskingKey[i] = _maskingKey[(_maskOffset + i) & 3];
+        }
+        _message.resize(len);
+        applyWebSocketMask(&_message[0], buffer->peek(), len, maskingKey);
+        _maskOffset += len;
+    }
+    else
+    {
+        _message.assign(buffer->peek(), len);
+    }
+    buffer->retrieve(len);
+    _frameRemaining -= len;
+    _isFinal = _isFin && _frameRemaining == 0;
+    _gotFragment = len > 0 || _isFinal;
+}
+
 void WebSocketConnectionImpl::onNewMessage(
     const trantor::TcpConnectionPtr &connPtr,
     trantor::MsgBuffer *buffer)
 {
+    if (_workerOverloaded)
+    {
+        // The connection is being closed, drop the rest of the messages.
+        buffer->retrieveAll();
+        return;
+    }
+    if (_timingWheel)
+        _lastActiveTick = _timingWheel->ticks();
     while (buffer->readableBytes() > 0)
     {
+        auto readableBytes = buffer->readableBytes();
         auto success = _parser.parse(buffer);
         if (success)
         {
             std::string message;
             WebSocketMessageType type;
+            bool isFinal;
             if (_parser.gotAll(message, type))
             {
+                if (_parser.isCompressed() &&
+                    (type == WebSocketMessageType::Text ||
+                     type == WebSocketMessageType::Binary))
+                {
+                    std::string decompressedMsg;
+                    auto maxLength = HttpAppFrameworkImpl::instance()
+                                         .getClientMaxWebSocketMessageSize();
+                    if (!_deflate->decompress(message.data(),
+                                              message.length(),
+                                              decompressedMsg,
+                                              maxLength))
+                    {
+                        connPtr->forceClose();
+                        return;
+                    }
+                    message.swap(decompressedMsg);
+                }
                 if (type == WebSocketMessageType::Ping)
                 {
                     // ping
                     send(message, WebSocketMessageType::Pong);
                 }
+                else if (type == WebSocketMessageType::Pong)
+                {
+                    _pongDeadline = 0;
+                }
                 else if (type == WebSocketMessageType::Close)
                 {
                     // close
@@ -335,10 +837,83 @@ void WebSocketConnectionImpl::onNewMessage(
                 {
                     return;
                 }
-                _messageCallback(std::move(message), shared_from_this(), type);
+                if (_workerQueue)
+                {
+                    auto thisPtr = shared_from_this();
+                    auto length = message.length();
+                    if (!runInWorkers(
+                            [thisPtr,
+                             message = std::move(message),
+                             type]() mutable {
+                                thisPtr->_messageCallback(std::move(message),
+                                                          thisPtr,
+                                                          type);
+                            },
+                            length))
+                    {
+                        closeOverloaded(connPtr);
+                        buffer->retrieveAll();
+                        return;
+                    }
+                }
+                else
+                {
+                    _messageCallback(std::move(message),
+                                     shared_from_this(),
+                                     type);
+                }
             }
-            else
+            else if (_parser.gotFragment(message, type, isFinal))
+            {
+                if (_parser.isCompressed())
+                {
+                    // Every piece is limited instead of the whole message.
+                    std::string decompressedMsg;
+                    auto maxLength = HttpAppFrameworkImpl::instance()
+                                         .getClientMaxWebSocketMessageSize();
+                    if (!_deflate->decompress(message.data(),
+                                              message.length(),
+                                              decompressedMsg,
+                                              maxLength,
+                                              isFinal))
+                    {
+                        connPtr->forceClose();
+                        return;
+                    }
+                    message.swap(decompressedMsg);
+                }
+                if (_workerQueue)
+                {
+                    auto thisPtr = shared_from_this();
+                    auto length = message.length();
+                    if (!runInWorkers(
+                            [thisPtr,
+                             message = std::move(message),
+                             type,
+                             isFinal]() mutable {
+                                thisPtr->_fragmentCallback(std::move(message),
+                                                           thisPtr,
+                                                           type,
+                                                           isFinal);
+                            },
+                            length))
+                    {
+                        closeOverloaded(connPtr);
+                        buffer->retrieveAll();
+                        return;
+                    }
+                }
+                else
+                {
+                    _fragmentCallback(std::move(message),
+                                      shared_from_this(),
+                                      type,
+                                      isFinal);
+                }
+            }
+            else if (buffer->readableBytes() == readableBytes)
             {
+                // Wait for the rest of the frame
                 return;
             }
         }
@@ -15,15 +15,29 @@
 #pragma once
 
 #include "impl_forwards.h"
+#include "WebSocketDeflate.h"
+#include "WebSocketTimingWheel.h"
 #include <drogon/WebSocketConnection.h>
 #include <trantor/utils/NonCopyable.h>
 #include <trantor/net/TcpConnection.h>
+#include <atomic>
+#include <deque>
+#include <map>
+#include <mutex>
 
 namespace drogon
 {
 class WebSocketConnectionImpl;
 typedef std::shared_ptr<WebSocketConnectionImpl> WebSocketConnectionImplPtr;
 
+/// XOR len bytes of src with the 4-byte masking key (rfc6455-5.3) into dest,
+/// dest may be the same as src. The payload is processed by SIMD registers
+/// or machine words instead of byte by byte.
+void applyWebSocketMask(char *dest,
+                        const char *src,
+                        size_t len,
+                        const char *maskingKey);
+
 class WebSocketMessageParser
 {
   public:
@@ -38,10 +52,59 @@ class WebSocketMessageParser
         return true;
     }
 
+    /// Frames with the RSV1 bit are accepted only if the permessage-deflate
+    /// extension is negotiated.
+    void enableCompression()
+    {
+        _compressionEnabled = true;
+    }
+
+    /// Return true if the message returned by gotAll() or gotFragment() is
+    /// compressed.
+    bool isCompressed() const
+    {
+        return _compressed;
+    }
+
+    /// In the streaming mode, the payload of data frames is returned by
+    /// gotFragment() piece by piece as it arrives instead of being
+    /// accumulated into one message. Control frames are returned by gotAll()
+    /// as before.
+    void enableStreaming()
+    {
+        _streaming = true;
+    }
+    bool gotFragment(std::string &fragment,
+                     WebSocketMessageType &type,
+                     bool &isFinal)
+    {
+        assert(fragment.empty());
+        if (!_gotFragment)
+            return false;
+        fragment.swap(_message);
+        type = _streamType;
+        isFinal = _isFinal;
+        return true;
+    }
+
   private:
     std::string _message;
     WebSocketMessageType _type;
     bool _gotAll = false;
+    bool _compressionEnabled = false;
+    bool _compressed = false;
+
+    // The state of the data frame being received in the streaming mode.
+    bool _streaming = false;
+    bool _gotFragment = false;
+    bool _isFinal = false;
+    bool _isFin = false;
+    bool _masked = false;
+    WebSocketMessageType _streamType;
+    size_t _frameRemaining = 0;
+    size_t _maskOffset = 0;
+    char _maskingKey[4];
+    void parsePayload(trantor::MsgBuffer *buffer);
 };
 
 class WebSocketConnectionImpl
@@ -52,6 +115,7 @@ class WebSocketConnectionImpl
   public:
     explicit WebSocketConnectionImpl(const trantor::TcpConnectionPtr &conn,
                                      bool isServer = true);
+    ~WebSocketConnectionImpl();
 
     virtual void send(
         const char *msg,
@@ -60,6 +124,7 @@ class WebSocketConnectionImpl
     virtual void send(
         const std::string &msg,
         const WebSocketMessageType &type = WebSocketMessageType::Text) override;
+    virtual void sendFrame(const WebSocketFramePtr &frame) override;
 
     virtual const trantor::InetAddress &localAddr() const override;
     virtual const trantor::InetAddress &peerAddr() const override;
@@ -73,6 +138,27 @@ class WebSocketConnectionImpl
     virtual void setPingMessage(
         const std::string &message,
         const std::chrono::duration<long double> &interval) override;
+    virtual void setPongTimeout(
+        const std::chrono::duration<long double> &timeout) override;
+    virtual void setIdleTimeout(
+        const std::chrono::duration<long double> &timeout) override;
+
+    virtual void setHighWaterMarkCallback(
+        const std::function<void(const WebSocketConnectionPtr &, size_t)>
+            &callback,
+        size_t markLen) override;
+    virtual void setWriteCompleteCallback(
+        const std::function<void(const WebSocketConnectionPtr &)> &callback)
+        override;
+    virtual size_t bufferedAmount() const override
+    {
+        return _pendingBytes.load(std::memory_order_relaxed) +
+               _bufferedBytes.load(std::memory_order_relaxed);
+    }
+    virtual void setSendQueueLimit(size_t limit) override
+    {
+        _sendQueueLimit.store(limit, std::memory_order_relaxed);
+    }
 
     void setMessageCallback(
         const std::function<void(std::string &&,
@@ -82,6 +168,26 @@ class WebSocketConnectionImpl
         _messageCallback = callback;
     }
 
+    /// Receive text and binary messages piece by piece, the callback is
+    /// called with isFinal set to true for the last piece of a message.
+    void setFragmentCallback(
+        const std::function<void(std::string &&,
+                                 const WebSocketConnectionImplPtr &,
+                                 const WebSocketMessageType &,
+                                 bool isFinal)> &callback)
+    {
+        _fragmentCallback = callback;
+        _parser.enableStreaming();
+    }
+
+    /// Call the message callbacks and the close callback in the worker queue
+    /// instead of the IO thread. Callbacks of the connection are called one
+    /// by one in order.
+    void setWorkerQueue(trantor::ConcurrentTaskQueue *queue)
+    {
+        _workerQueue = queue;
+    }
+
     void setCloseCallback(
         const std::function<void(const WebSocketConnectionImplPtr &)> &callback)
     {
@@ -91,20 +197,141 @@ class WebSocketConnectionImpl
     void onNewMessage(const trantor::TcpConnectionPtr &connPtr,
                       trantor::MsgBuffer *buffer);
 
+    /// Enable the permessage-deflate extension negotiated in the handshake,
+    /// this method must be called before any message is received.
+    void setDeflate(std::unique_ptr<WebSocketDeflate> &&deflate)
+    {
+        _deflate = std::move(deflate);
+        _parser.enableCompression();
+    }
+
+    trantor::EventLoop *getLoop()
+    {
+        return _tcpConn->getLoop();
+    }
+
+    /// The connection becomes congested when the output buffer of the TCP
+    /// connection holds more than mark bytes, and stays congested until the
+    /// buffer is drained. The smallest mark set on the connection is used.
+    /// This method must be called in the thread of the connection.
+    void setCongestionMark(size_t mark)
+    {
+        if (_congestionMark == 0 || mark < _congestionMark)
+            _congestionMark = mark;
+    }
+    bool isCongested() const
+    {
+        return _congested;
+    }
+
+    /// Set a callback called when the output buffer is drained, callbacks of
+    /// the same owner replace each other.
+    void setDrainCallback(const void *owner, std::function<void()> &&callback)
+    {
+        _drainCallbacks[owner] = std::move(callback);
+    }
+    void removeDrainCallback(const void *owner)
+    {
+        _drainCallbacks.erase(owner);
+    }
+
+    /// Set a callback called in the IO thread when the connection is closed,
+    /// before the close callback, callbacks of the same owner replace each
+    /// other.
+    void setCloseHook(const void *owner, std::function<void()> &&callback)
+    {
+        _closeHooks[owner] = std::move(callback);
+    }
+    void removeCloseHook(const void *owner)
+    {
+        _closeHooks.erase(owner);
+    }
+
+    void onWriteComplete();
+
     void onClose()
     {
-        if (_pingTimerId != trantor::InvalidTimerId)
-            _tcpConn->getLoop()->invalidateTimer(_pingTimerId);
+        // The hooks may remove themselves.
+        auto closeHooks = std::move(_closeHooks);
+        _closeHooks.clear();
+        for (auto &hook : closeHooks)
+        {
+            hook.second();
+        }
+        if (_workerQueue)
+        {
+            auto thisPtr = shared_from_this();
+            runInWorkers([thisPtr]() { thisPtr->_closeCallback(thisPtr); });
+            return;
+        }
         _closeCallback(shared_from_this());
     }
 
+    /// Called by the timing wheel of the loop when it reaches the tick.
+    void onTimer(size_t tick);
+
   private:
     trantor::TcpConnectionPtr _tcpConn;
     trantor::InetAddress _localAddr;
     trantor::InetAddress _peerAddr;
     bool _isServer = true;
     WebSocketMessageParser _parser;
+
+    // The timers of the connection, in ticks of the timing wheel. They are
+    // only accessed in the thread of the connection.
+    WebSocketTimingWheel *_timingWheel = nullptr;
+    std::string _pingMessage;
+    size_t _pingInterval = 0;
+    size_t _nextPingTick = 0;
+    size_t _pongTimeout = 0;
+    size_t _pongDeadline = 0;
+    size_t _idleTimeout = 0;
+    size_t _lastActiveTick = 0;
+    // The tick of the latest entry in the wheel, 0 if there isn't one.
+    size_t _timerTick = 0;
+    // Pings more frequent than the ticks of the wheel are sent by their own
+    // timer.
     trantor::TimerId _pingTimerId = trantor::InvalidTimerId;
+    void startTimers();
+    void updateTimer();
+    void sendPing();
+
+    // The tasks of the connection waiting for the worker queue with the
+    // sizes of their messages, one worker runs them at a time to keep their
+    // order.
+    trantor::ConcurrentTaskQueue *_workerQueue = nullptr;
+    std::mutex _workerMutex;
+    std::deque<std::pair<std::function<void()>, size_t>> _workerTasks;
+    size_t _workerQueuedBytes = 0;
+    bool _workerRunning = false;
+    // Set when the connection is closed because its messages arrive faster
+    // than they are handled, only used in the IO thread.
+    bool _workerOverloaded = false;
+    bool runInWorkers(std::function<void()> &&task, size_t bytes = 0);
+    void runWorkerTasks();
+    void closeOverloaded(const trantor::TcpConnectionPtr &connPtr);
+    size_t _congestionMark = 0;
+    bool _congested = false;
+    std::map<const void *, std::function<void()>> _drainCallbacks;
+    std::map<const void *, std::function<void()>> _closeHooks;
+
+    // The output buffer of the TCP connection is tracked by its high water
+    // mark callback, which is called with the buffer size whenever a send
+    // operation leaves some data in the buffer.
+    bool _outputTracked = false;
+    bool _outputBuffered = false;
+    // Bytes in the output buffer, only changed in the IO thread.
+    std::atomic<size_t> _bufferedBytes{0};
+    // Bytes sent by other threads but not passed to the TCP connection yet.
+    std::atomic<size_t> _pendingBytes{0};
+    std::atomic<size_t> _sendQueueLimit{0};
+    size_t _highWaterMark = 0;
+    std::function<void(const WebSocketConnectionPtr &, size_t)>
+        _highWaterMarkCallback;
+    std::function<void(const WebSocketConnectionPtr &)> _writeCompleteCallback;
+    std::unique_ptr<WebSocketDeflate> _deflate;
+    // Messages compressed with the shared context must be sent in order.
+    std::mutex _deflateMutex;
 
     std::function<void(std::string &&,
                        const WebSocketConnectionImplPtr &,
@@ -112,9 +339,23 @@ class WebSocketConnectionImpl
         _messageCallback = [](std::string &&,
                               const WebSocketConnectionImplPtr &,
                               const WebSocketMessageType &) {};
+    std::function<void(std::string &&,
+                       const WebSocketConnectionImplPtr &,
+                       const WebSocketMessageType &,
+                       bool)>
+        _fragmentCallback;
     std::function<void(const WebSocketConnectionImplPtr &)> _closeCallback =
         [](const WebSocketConnectionImplPtr &) {};
-    void sendWsData(const char *msg, uint64_t len, unsigned char opcode);
+    void sendWsData(const char *msg,
+                    uint64_t len,
+                    unsigned char opcode,
+                    bool compressed = false);
+    bool exceedsSendQueueLimit(unsigned char opcode, size_t len) const;
+    template <typename T>
+    void sendToTcp(T &&data, size_t len);
+    template <typename T>
+    void sendInLoop(T &&data);
+    void onOutputBuffered(size_t size);
 };
 
 }  // namespace drogon
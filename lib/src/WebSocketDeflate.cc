@@ -0,0 +1,372 @@
+/**
+ *
+ *  WebSocketDeflate.cc
+ *  An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#include "WebSocketDeflate.h"
+#include <trantor/utils/Logger.h>
+#include <algorithm>
+#include <string.h>
+#include <utility>
+#include <vector>
+
+using namespace drogon;
+
+typedef std::vector<std::pair<std::string, std::string>> ExtensionParams;
+
+static std::string trim(const std::string &str)
+{
+    auto begin = str.find_first_not_of(" \t");
+    if (begin == std::string::npos)
+        return std::string();
+    auto end = str.find_last_not_of(" \t");
+    return str.substr(begin, end - begin + 1);
+}
+
+static std::vector<std::string> split(const std::string &str, char delimiter)
+{
+    std::vector<std::string> ret;
+    std::string::size_type pos = 0;
+    while (true)
+    {
+        auto next = str.find(delimiter, pos);
+        ret.push_back(trim(str.substr(pos, next - pos)));
+        if (next == std::string::npos)
+            break;
+        pos = next + 1;
+    }
+    return ret;
+}
+
+// Parse "permessage-deflate; client_max_window_bits, x-webkit-deflate-frame",
+// the first item of every extension is its name.
+static std::vector<ExtensionParams> parseExtensions(const std::string &header)
+{
+    std::vector<ExtensionParams> extensions;
+    for (auto &extension : split(header, ','))
+    {
+        ExtensionParams params;
+        for (auto &param : split(extension, ';'))
+        {
+            std::string name, value;
+            auto pos = param.find('=');
+            name = trim(param.substr(0, pos));
+            if (pos != std::string::npos)
+            {
+                value = trim(param.substr(pos + 1));
+                if (value.length() >= 2 && value.front() == '"' &&
+                    value.back() == '"')
+                    value = value.substr(1, value.length() - 2);
+            }
+            std::transform(name.begin(), name.end(), name.begin(), tolower);
+            params.emplace_back(std::move(name), std::move(value));
+        }
+        if (!params.empty() && !params[0].first.empty())
+            extensions.push_back(std::move(params));
+    }
+    return extensions;
+}
+
+static int parseWindowBits(const std::string &value)
+{
+    if (value.empty() || value.length() > 2 ||
+        !std::all_of(value.begin(), value.end(), ::isdigit))
+        return -1;
+    auto bits = std::stoi(value);
+    if (bits < 8 || bits > 15)
+        return -1;
+    return bits;
+}
+
+std::unique_ptr<WebSocketDeflate> WebSocketDeflate::acceptOffers(
+    const std::string &offers,
+    int maxWindowBits,
+    std::string &response)
+{
+    for (auto &offer : parseExtensions(offers))
+    {
+        if (offer[0].first != "permessage-deflate")
+            continue;
+        bool serverNoContextTakeover = false;
+        bool clientNoContextTakeover = false;
+        int serverWindowBits = 15;
+        bool serverWindowBitsOffered = false;
+        int clientWindowBits = 15;
+        bool clientWindowBitsOffered = false;
+        bool valid = true;
+        for (size_t i = 1; i < offer.size() && valid; ++i)
+        {
+            auto &name = offer[i].first;
+            auto &value = offer[i].second;
+            if (name == "server_no_context_takeover" && value.empty())
+            {
+                serverNoContextTakeover = true;
+            }
+            else if (name == "client_no_context_takeover" && value.empty())
+            {
+                clientNoContextTakeover = true;
+            }
+            else if (name == "server_max_window_bits")
+            {
+                serverWindowBits = parseWindowBits(value);
+                serverWindowBitsOffered = true;
+                // zlib can't make raw deflate streams with a 256-byte window.
+                valid = serverWindowBits >= 9;
+            }
+            else if (name == "client_max_window_bits")
+            {
+                if (!value.empty())
+                {
+                    clientWindowBits = parseWindowBits(value);
+                    valid = clientWindowBits > 0;
+                }
+                clientWindowBitsOffered = true;
+            }
+            else
+            {
+                valid = false;
+            }
+        }
+        if (!valid)
+            continue;
+
+        auto deflateWindowBits = std::min(serverWindowBits, maxWindowBits);
+        // The window of the client can be limited only if the client
+        // supports the client_max_window_bits parameter.
+        auto inflateWindowBits =
+            clientWindowBitsOffered ? std::min(clientWindowBits, maxWindowBits)
+                                    : 15;
+        response = "permessage-deflate";
+        if (serverNoContextTakeover)
+            response.append("; server_no_context_takeover");
+        if (clientNoContextTakeover)
+            response.append("; client_no_context_takeover");
+        if (serverWindowBitsOffered || deflateWindowBits < 15)
+            response.append("; server_max_window_bits=" +
+                            std::to_string(deflateWindowBits));
+        if (clientWindowBitsOffered)
+            response.append("; client_max_window_bits=" +
+                            std::to_string(inflateWindowBits));
+        return std::unique_ptr<WebSocketDeflate>(
+            new WebSocketDeflate(deflateWindowBits,
+                                 serverNoContextTakeover,
+                                 inflateWindowBits,
+                                 clientNoContextTakeover));
+    }
+    return nullptr;
+}
+
+std::string WebSocketDeflate::makeOffer(int maxWindowBits)
+{
+    std::string offer = "permessage-deflate; client_max_window_bits";
+    if (maxWindowBits < 15)
+        offer.append("; server_max_window_bits=" +
+                     std::to_string(maxWindowBits));
+    return offer;
+}
+
+std::unique_ptr<WebSocketDeflate> WebSocketDeflate::acceptResponse(
+    const std::string &response,
+    int maxWindowBits,
+    bool &valid)
+{
+    valid = true;
+    if (response.empty())
+        return nullptr;
+    auto extensions = parseExtensions(response);
+    if (extensions.size() != 1 ||
+        extensions[0][0].first != "permessage-deflate")
+    {
+        valid = false;
+        return nullptr;
+    }
+    auto &params = extensions[0];
+    bool serverNoContextTakeover = false;
+    bool clientNoContextTakeover = false;
+    int serverWindowBits = 15;
+    int clientWindowBits = 15;
+    for (size_t i = 1; i < params.size(); ++i)
+    {
+        auto &name = params[i].first;
+        auto &value = params[i].second;
+        if (name == "server_no_context_takeover" && value.empty())
+        {
+            serverNoContextTakeover = true;
+        }
+        else if (name == "client_no_context_takeover" && value.empty())
+        {
+            clientNoContextTakeover = true;
+        }
+        else if (name == "server_max_window_bits")
+        {
+            serverWindowBits = parseWindowBits(value);
+            if (serverWindowBits < 0 || serverWindowBits > maxWindowBits)
+            {
+                valid = false;
+                return nullptr;
+            }
+        }
+        else if (name == "client_max_window_bits")
+        {
+            clientWindowBits = parseWindowBits(value);
+            if (clientWindowBits < 0)
+            {
+                valid = false;
+                return nullptr;
+            }
+        }
+        else
+        {
+            valid = false;
+            return nullptr;
+        }
+    }
+    clientWindowBits = std::min(clientWindowBits, maxWindowBits);
+    // Sending uncompressed messages is always allowed, do it when zlib
+    // can't make streams with the small window.
+    return std::unique_ptr<WebSocketDeflate>(
+        new WebSocketDeflate(clientWindowBits >= 9 ? clientWindowBits : 0,
+                             clientNoContextTakeover,
+                             serverWindowBits,
+                             serverNoContextTakeover));
+}
+
+WebSocketDeflate::WebSocketDeflate(int deflateWindowBits,
+                                   bool deflateNoContextTakeover,
+                                   int inflateWindowBits,
+                                   bool inflateNoContextTakeover)
+    : _deflateWindowBits(deflateWindowBits),
+      _deflateNoContextTakeover(deflateNoContextTakeover),
+      _inflateWindowBits(std::max(inflateWindowBits, 9)),
+      _inflateNoContextTakeover(inflateNoContextTakeover)
+{
+}
+
+WebSocketDeflate::~WebSocketDeflate()
+{
+    if (_deflateInitialized)
+        deflateEnd(&_deflateStream);
+    if (_inflateInitialized)
+        inflateEnd(&_inflateStream);
+}
+
+bool WebSocketDeflate::compress(const char *data, size_t len, std::string &out)
+{
+    if (!canCompress())
+        return false;
+    if (!_deflateInitialized)
+    {
+        memset(&_deflateStream, 0, sizeof(_deflateStream));
+        // Negative window bits make raw deflate streams. The hash table of
+        // zlib takes 1 << (memLevel + 9) bytes besides the window of
+        // 1 << (windowBits + 2) bytes, so the memory level is scaled with
+        // the window, it's the default level 8 with the largest window.
+        if (deflateInit2(&_deflateStream,
+                         Z_DEFAULT_COMPRESSION,
+                         Z_DEFLATED,
+                         -_deflateWindowBits,
+                         std::max(_deflateWindowBits - 7, 1),
+                         Z_DEFAULT_STRATEGY) != Z_OK)
+        {
+            LOG_ERROR << "deflateInit2 error!";
+            return false;
+        }
+        _deflateInitialized = true;
+    }
+    _deflateStream.next_in =
+        reinterpret_cast<Bytef *>(const_cast<char *>(data));
+    _deflateStream.avail_in = static_cast<uInt>(len);
+    out.resize(len / 2 + 64);
+    size_t offset = 0;
+    do
+    {
+        if (out.length() - offset < 64)
+            out.resize(out.length() * 2);
+        _deflateStream.next_out = reinterpret_cast<Bytef *>(&out[offset]);
+        _deflateStream.avail_out = static_cast<uInt>(out.length() - offset);
+        if (deflate(&_deflateStream, Z_SYNC_FLUSH) == Z_STREAM_ERROR)
+        {
+            LOG_ERROR << "deflate error!";
+            deflateReset(&_deflateStream);
+            return false;
+        }
+        offset = out.length() - _deflateStream.avail_out;
+    } while (_deflateStream.avail_out == 0);
+    // Remove the empty block at the end of the flushed data, rfc7692-7.2.1
+    if (offset >= 4)
+        offset -= 4;
+    out.resize(offset);
+    if (_deflateNoContextTakeover)
+        deflateReset(&_deflateStream);
+    return true;
+}
+
+bool WebSocketDeflate::decompress(const char *data,
+                                  size_t len,
+                                  std::string &out,
+                                  size_t maxLength,
+                                  bool isFinal)
+{
+    if (!_inflateInitialized)
+    {
+        memset(&_inflateStream, 0, sizeof(_inflateStream));
+        if (inflateInit2(&_inflateStream, -_inflateWindowBits) != Z_OK)
+        {
+            LOG_ERROR << "inflateInit2 error!";
+            return false;
+        }
+        _inflateInitialized = true;
+    }
+    static const char tail[] = {'\x00', '\x00', '\xff', '\xff'};
+    out.resize(maxLength < len * 2 + 64 ? maxLength + 1 : len * 2 + 64);
+    size_t offset = 0;
+    // Append the empty block removed by the sender to the end of the
+    // message, rfc7692-7.2.2
+    for (auto &input : {std::make_pair(data, len),
+                        std::make_pair(tail, isFinal ? sizeof(tail) : 0)})
+    {
+        _inflateStream.next_in =
+            reinterpret_cast<Bytef *>(const_cast<char *>(input.first));
+        _inflateStream.avail_in = static_cast<uInt>(input.second);
+        do
+        {
+            if (out.length() == offset)
+                out.resize(out.length() * 2);
+            _inflateStream.next_out = reinterpret_cast<Bytef *>(&out[offset]);
+            _inflateStream.avail_out =
+                static_cast<uInt>(out.length() - offset);
+            auto ret = inflate(&_inflateStream, Z_SYNC_FLUSH);
+            offset = out.length() - _inflateStream.avail_out;
+            if (offset > maxLength)
+            {
+                LOG_ERROR << "The decompressed WebSocket message is too large!";
+                return false;
+            }
+            if (ret == Z_STREAM_END)
+            {
+                // The sender finished the stream by a final block.
+                inflateReset(&_inflateStream);
+                break;
+            }
+            if (ret != Z_OK && ret != Z_BUF_ERROR)
+            {
+                LOG_ERROR << "inflate error!";
+                inflateReset(&_inflateStream);
+                return false;
+            }
+        } while (_inflateStream.avail_in > 0 || _inflateStream.avail_out == 0);
+    }
+    out.resize(offset);
+    if (isFinal && _inflateNoContextTakeover)
+        inflateReset(&_inflateStream);
+    return true;
+}
@@ -0,0 +1,100 @@
+/**
+ *
+ *  WebSocketDeflate.h
+ *  An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#pragma once
+
+#include <trantor/utils/NonCopyable.h>
+#include <memory>
+#include <string>
+#include <zlib.h>
+
+namespace drogon
+{
+/**
+ * @brief The permessage-deflate extension of WebSocket (rfc7692).
+ *
+ * The zlib streams are created when they are used for the first time, and
+ * are reused by all messages of the connection unless the context takeover
+ * is disabled by the negotiation.
+ */
+class WebSocketDeflate : public trantor::NonCopyable
+{
+  public:
+    /**
+     * @brief Negotiate with the offers of a client.
+     *
+     * @param offers The value of the Sec-WebSocket-Extensions header.
+     * @param maxWindowBits The max LZ77 window bits used by the server.
+     * @param response The value of the Sec-WebSocket-Extensions header in
+     * the response.
+     * @return nullptr if no offer is accepted.
+     */
+    static std::unique_ptr<WebSocketDeflate> acceptOffers(
+        const std::string &offers,
+        int maxWindowBits,
+        std::string &response);
+
+    /// Return the offer sent by clients.
+    static std::string makeOffer(int maxWindowBits);
+
+    /**
+     * @brief Configure a client by the response of the server.
+     *
+     * @param response The value of the Sec-WebSocket-Extensions header.
+     * @param maxWindowBits The parameter passed to makeOffer().
+     * @param valid Set to false if the response is invalid.
+     * @return nullptr if the extension is not accepted by the server.
+     */
+    static std::unique_ptr<WebSocketDeflate> acceptResponse(
+        const std::string &response,
+        int maxWindowBits,
+        bool &valid);
+
+    /// A window bits of 0 disables compression, messages are sent
+    /// uncompressed then.
+    WebSocketDeflate(int deflateWindowBits,
+                     bool deflateNoContextTakeover,
+                     int inflateWindowBits,
+                     bool inflateNoContextTakeover);
+    ~WebSocketDeflate();
+
+    bool canCompress() const
+    {
+        return _deflateWindowBits > 0;
+    }
+
+    /// Compress the payload of a message.
+    bool compress(const char *data, size_t len, std::string &out);
+
+    /// Decompress the payload of a message, false is returned if the data is
+    /// invalid or the decompressed data is longer than maxLength. A message
+    /// can be decompressed piece by piece, isFinal is true for the last one.
+    bool decompress(const char *data,
+                    size_t len,
+                    std::string &out,
+                    size_t maxLength,
+                    bool isFinal = true);
+
+  private:
+    int _deflateWindowBits;
+    bool _deflateNoContextTakeover;
+    int _inflateWindowBits;
+    bool _inflateNoContextTakeover;
+    bool _deflateInitialized = false;
+    bool _inflateInitialized = false;
+    z_stream _deflateStream;
+    z_stream _inflateStream;
+};
+
+}  // namespace drogon
@@ -0,0 +1,257 @@
+/**
+ *
+ *  WebSocketHub.cc
+ *  An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#include "WebSocketConnectionImpl.h"
+#include <drogon/HttpAppFramework.h>
+#include <drogon/WebSocketHub.h>
+#include <trantor/utils/Logger.h>
+#include <atomic>
+#include <limits>
+#include <unordered_map>
+#include <unordered_set>
+
+using namespace drogon;
+
+/// The subscribers in one IO loop, only accessed in the thread of the loop
+/// except the _loop member.
+struct WebSocketHub::LoopData
+{
+    std::atomic<trantor::EventLoop *> _loop{nullptr};
+    std::unordered_map<std::string,
+                       std::unordered_set<WebSocketConnectionImplPtr>>
+        _topics;
+    std::unordered_map<WebSocketConnectionImplPtr,
+                       std::unordered_set<std::string>>
+        _connections;
+    // The latest frames of every topic for the slow subscribers when the
+    // Coalesce policy is used.
+    std::unordered_map<WebSocketConnectionImplPtr,
+                       std::unordered_map<std::string, WebSocketFramePtr>>
+        _coalescedFrames;
+
+    void dispatch(const std::string &topic,
+                  const WebSocketFramePtr &frame,
+                  SlowConsumerPolicy policy)
+    {
+        auto iter = _topics.find(topic);
+        if (iter == _topics.end())
+            return;
+        std::vector<WebSocketConnectionImplPtr> closedConnections;
+        std::vector<WebSocketConnectionImplPtr> slowConnections;
+        for (auto &conn : iter->second)
+        {
+            if (!conn->connected())
+            {
+                closedConnections.push_back(conn);
+                continue;
+            }
+            if (conn->isCongested())
+            {
+                switch (policy)
+                {
+                    case SlowConsumerPolicy::Drop:
+                        LOG_TRACE << "Drop a message to a slow subscriber";
+                        break;
+                    case SlowConsumerPolicy::Disconnect:
+                        slowConnections.push_back(conn);
+                        break;
+                    case SlowConsumerPolicy::Coalesce:
+                        _coalescedFrames[conn][topic] = frame;
+                        break;
+                }
+                continue;
+            }
+            conn->sendFrame(frame);
+        }
+        for (auto &conn : closedConnections)
+        {
+            removeConnection(conn);
+        }
+        // The close callbacks may unsubscribe the connections synchronously,
+        // so the connections are closed after the iteration.
+        for (auto &conn : slowConnections)
+        {
+            LOG_DEBUG << "Disconnect a slow subscriber from "
+                      << conn->peerAddr().toIpPort();
+            removeConnection(conn);
+            conn->forceClose();
+        }
+    }
+
+    void remove(const WebSocketConnectionImplPtr &conn,
+                const std::string &topic)
+    {
+        auto iter = _topics.find(topic);
+        if (iter != _topics.end())
+        {
+            iter->second.erase(conn);
+            if (iter->second.empty())
+                _topics.erase(iter);
+        }
+        auto framesIter = _coalescedFrames.find(conn);
+        if (framesIter != _coalescedFrames.end())
+        {
+            framesIter->second.erase(topic);
+            if (framesIter->second.empty())
+                _coalescedFrames.erase(framesIter);
+        }
+    }
+
+    void removeConnection(const WebSocketConnectionImplPtr &conn)
+    {
+        auto iter = _connections.find(conn);
+        if (iter == _connections.end())
+            return;
+        for (auto &topic : iter->second)
+        {
+            remove(conn, topic);
+        }
+        _connections.erase(iter);
+        conn->removeDrainCallback(this);
+        conn->removeCloseHook(this);
+    }
+
+    void flush(const WebSocketConnectionImplPtr &conn)
+    {
+        auto iter = _coalescedFrames.find(conn);
+        if (iter == _coalescedFrames.end())
+            return;
+        auto frames = std::move(iter->second);
+        _coalescedFrames.erase(iter);
+        for (auto &frame : frames)
+        {
+            conn->sendFrame(frame.second);
+        }
+    }
+};
+
+WebSocketHub::WebSocketHub(SlowConsumerPolicy policy, size_t highWaterMark)
+    : _policy(policy), _highWaterMark(highWaterMark)
+{
+    size_t numThreads = app().getThreadNum();
+    assert(numThreads > 0 &&
+           numThreads != std::numeric_limits<size_t>::max());
+    // One more for the main loop, as IOThreadStorage does.
+    for (size_t i = 0; i <= numThreads; ++i)
+    {
+        _loopData.push_back(std::make_shared<LoopData>());
+    }
+}
+
+WebSocketHub::~WebSocketHub()
+{
+}
+
+std::shared_ptr<WebSocketHub::LoopData> WebSocketHub::getLoopData(
+    const WebSocketConnectionPtr &conn)
+{
+    auto connImpl = static_cast<WebSocketConnectionImpl *>(conn.get());
+    auto index = connImpl->getLoop()->index();
+    if (index < _loopData.size())
+        return _loopData[index];
+    LOG_ERROR << "Only connections accepted by the framework can subscribe";
+    return nullptr;
+}
+
+void WebSocketHub::subscribe(const WebSocketConnectionPtr &conn,
+                             const std::string &topic)
+{
+    auto data = getLoopData(conn);
+    if (!data)
+        return;
+    auto connImpl = std::static_pointer_cast<WebSocketConnectionImpl>(conn);
+    auto loop = connImpl->getLoop();
+    data->_loop.store(loop, std::memory_order_release);
+    auto policy = _policy;
+    auto highWaterMark = _highWaterMark;
+    loop->runInLoop([data, connImpl, topic, policy, highWaterMark]() {
+        if (!connImpl->connected())
+            return;
+        auto &topics = data->_connections[connImpl];
+        if (topics.empty())
+        {
+            connImpl->setCongestionMark(highWaterMark);
+            std::weak_ptr<LoopData> weakData = data;
+            std::weak_ptr<WebSocketConnectionImpl> weakConn = connImpl;
+            // The connection is unsubscribed as soon as it's closed, so the
+            // hub doesn't hold it until a message is published to its
+            // topics.
+            connImpl->setCloseHook(data.get(), [weakData, weakConn]() {
+                auto data = weakData.lock();
+                auto conn = weakConn.lock();
+                if (data && conn)
+                    data->removeConnection(conn);
+            });
+            if (policy == SlowConsumerPolicy::Coalesce)
+            {
+                connImpl->setDrainCallback(data.get(), [weakData, weakConn]() {
+                    auto data = weakData.lock();
+                    auto conn = weakConn.lock();
+                    if (data && conn)
+                        data->flush(conn);
+                });
+            }
+        }
+        if (topics.insert(topic).second)
+        {
+            data->_topics[topic].insert(connImpl);
+        }
+    });
+}
+
+void WebSocketHub::unsubscribe(const WebSocketConnectionPtr &conn,
+                               const std::string &topic)
+{
+    auto data = getLoopData(conn);
+    if (!data)
+        return;
+    auto connImpl = std::static_pointer_cast<WebSocketConnectionImpl>(conn);
+    connImpl->getLoop()->runInLoop([data, connImpl, topic]() {
+        auto iter = data->_connections.find(connImpl);
+        if (iter == data->_connections.end() || iter->second.erase(topic) == 0)
+            return;
+        data->remove(connImpl, topic);
+        if (iter->second.empty())
+        {
+            data->_connections.erase(iter);
+            connImpl->removeDrainCallback(data.get());
+            connImpl->removeCloseHook(data.get());
+        }
+    });
+}
+
+void WebSocketHub::unsubscribe(const WebSocketConnectionPtr &conn)
+{
+    auto data = getLoopData(conn);
+    if (!data)
+        return;
+    auto connImpl = std::static_pointer_cast<WebSocketConnectionImpl>(conn);
+    connImpl->getLoop()->runInLoop(
+        [data, connImpl]() { data->removeConnection(connImpl); });
+}
+
+void WebSocketHub::publish(const std::string &topic,
+                           const WebSocketFramePtr &frame)
+{
+    auto policy = _policy;
+    for (auto &data : _loopData)
+    {
+        auto loop = data->_loop.load(std::memory_order_acquire);
+        if (!loop)
+            continue;
+        loop->runInLoop([data, topic, frame, policy]() {
+            data->dispatch(topic, frame, policy);
+        });
+    }
+}
@@ -0,0 +1,88 @@
+/**
+ *
+ *  WebSocketTimingWheel.cc
+ *  An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#include "WebSocketTimingWheel.h"
+#include "WebSocketConnectionImpl.h"
+#include <cmath>
+#include <unordered_map>
+
+using namespace drogon;
+
+#define WEBSOCKET_WHEEL_BUCKETS 64
+
+constexpr double WebSocketTimingWheel::kTickInterval;
+
+WebSocketTimingWheel *WebSocketTimingWheel::get(trantor::EventLoop *loop)
+{
+    loop->assertInLoopThread();
+    // A thread may run several loops one after another, every loop has its
+    // own wheel. The wheels aren't destroyed before the thread exits, when
+    // their loops have quit, so their timers are never invalidated.
+    static thread_local std::unordered_map<
+        trantor::EventLoop *,
+        std::unique_ptr<WebSocketTimingWheel>>
+        wheels;
+    auto &wheel = wheels[loop];
+    if (!wheel)
+        wheel.reset(new WebSocketTimingWheel(loop));
+    return wheel.get();
+}
+
+size_t WebSocketTimingWheel::toTicks(
+    const std::chrono::duration<long double> &duration)
+{
+    auto ticks = std::ceil(duration.count() / kTickInterval);
+    return ticks < 1 ? 1 : static_cast<size_t>(ticks);
+}
+
+WebSocketTimingWheel::WebSocketTimingWheel(trantor::EventLoop *loop)
+    : _loop(loop), _buckets(WEBSOCKET_WHEEL_BUCKETS)
+{
+}
+
+void WebSocketTimingWheel::schedule(
+    const std::weak_ptr<WebSocketConnectionImpl> &conn,
+    size_t tick)
+{
+    if (!_started)
+    {
+        _started = true;
+        _loop->runEvery(kTickInterval, [this]() { onTick(); });
+    }
+    if (tick <= _ticks)
+        tick = _ticks + 1;
+    _buckets[tick % _buckets.size()].push_back({conn, tick});
+}
+
+void WebSocketTimingWheel::onTick()
+{
+    ++_ticks;
+    auto &bucket = _buckets[_ticks % _buckets.size()];
+    if (bucket.empty())
+        return;
+    // Connections may schedule new entries into this bucket in onTimer().
+    std::vector<Entry> entries;
+    entries.swap(bucket);
+    for (auto &entry : entries)
+    {
+        if (entry._tick > _ticks)
+        {
+            bucket.push_back(std::move(entry));
+            continue;
+        }
+        auto conn = entry._conn.lock();
+        if (conn)
+            conn->onTimer(entry._tick);
+    }
+}
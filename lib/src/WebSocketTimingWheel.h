@@ -0,0 +1,80 @@
+/**
+ *
+ *  WebSocketTimingWheel.h
+ *  An Tao
+ *
+ *  Copyright 2018, An Tao.  All rights reserved.
+ *  https://github.com/an-tao/drogon
+ *  Use of this source code is governed by a MIT license
+ *  that can be found in the License file.
+ *
+ *  Drogon
+ *
+ */
+
+#pragma once
+
+#include <trantor/net/EventLoop.h>
+#include <trantor/utils/NonCopyable.h>
+#include <chrono>
+#include <memory>
+#include <vector>
+
+namespace drogon
+{
+class WebSocketConnectionImpl;
+
+/**
+ * @brief A hashed timing wheel which drives the pings, pong timeouts and
+ * idle timeouts of all WebSocket connections in one event loop.
+ *
+ * There is only one trantor timer per loop. Scheduling a connection appends
+ * an entry to a bucket, and every tick visits one bucket, so the cost per
+ * connection is O(1) no matter how many connections there are. Entries
+ * don't own connections, closed connections are dropped when their entries
+ * expire.
+ *
+ * All methods must be called in the thread of the event loop.
+ */
+class WebSocketTimingWheel : public trantor::NonCopyable
+{
+  public:
+    /// The resolution of the wheel in seconds.
+    static constexpr double kTickInterval = 1.0;
+
+    /// Return the wheel of the loop, which must run in the current thread,
+    /// it's created when it's used for the first time.
+    static WebSocketTimingWheel *get(trantor::EventLoop *loop);
+
+    /// Convert a duration to ticks, at least one tick.
+    static size_t toTicks(const std::chrono::duration<long double> &duration);
+
+    /// The number of ticks since the wheel is created.
+    size_t ticks() const
+    {
+        return _ticks;
+    }
+
+    /// Call the onTimer() method of the connection with the tick when the
+    /// wheel reaches it.
+    void schedule(const std::weak_ptr<WebSocketConnectionImpl> &conn,
+                  size_t tick);
+
+  private:
+    explicit WebSocketTimingWheel(trantor::EventLoop *loop);
+    void onTick();
+
+    struct Entry
+    {
+        std::weak_ptr<WebSocketConnectionImpl> _conn;
+        size_t _tick;
+    };
+    trantor::EventLoop *_loop;
+    // Entries whose ticks are one or more rounds later are kept in their
+    // buckets until the wheel reaches them.
+    std::vector<std::vector<Entry>> _buckets;
+    size_t _ticks = 0;
+    bool _started = false;
+};
+
+}  // namespace drogon
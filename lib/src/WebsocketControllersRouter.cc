@@ -13,18 +13,15 @@
  */
 
 #include "WebsocketControllersRouter.h"
+#include "HttpAppFrameworkImpl.h"
 #include "HttpRequestImpl.h"
 #include "HttpResponseImpl.h"
+#include "WebSocketAcceptKey.h"
 #include "WebSocketConnectionImpl.h"
 #include "FiltersFunction.h"
 #include <drogon/HttpFilter.h>
 #include <drogon/WebSocketController.h>
 #include <drogon/config.h>
-#ifdef OpenSSL_FOUND
-#include <openssl/sha.h>
-#else
-#include "ssl_funcs/Sha1.h"
-#endif
 using namespace drogon;
 
 void WebsocketControllersRouter::registerWebSocketController(
@@ -51,11 +48,8 @@ void WebsocketControllersRouter::route(
     std::function<void(const HttpResponsePtr &)> &&callback,
     const WebSocketConnectionImplPtr &wsConnPtr)
 {
-    std::string wsKey = req->getHeaderBy("sec-websocket-key");
-    if (!wsKey.empty())
+    if (!req->getHeaderBy("sec-websocket-key").empty())
     {
-        // magic="258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
-
         std::string pathLower(req->path());
         std::transform(pathLower.begin(),
                        pathLower.end(),
@@ -76,7 +70,6 @@ void WebsocketControllersRouter::route(
                     filters_function::doFilters(
                         filters, req, callbackPtr, [=]() mutable {
                             doControllerHandler(ctrlPtr,
-                                                wsKey,
                                                 req,
                                                 std::move(*callbackPtr),
                                                 wsConnPtr);
@@ -84,8 +77,10 @@ void WebsocketControllersRouter::route(
                 }
                 else
                 {
-                    doControllerHandler(
-                        ctrlPtr, wsKey, req, std::move(callback), wsConnPtr);
+                    doControllerHandler(ctrlPtr,
+                                        req,
+                                        std::move(callback),
+                                        wsConnPtr);
                 }
                 return;
             }
@@ -114,29 +109,64 @@ WebsocketControllersRouter::getHandlersInfo() const
 
 void WebsocketControllersRouter::doControllerHandler(
     const WebSocketControllerBasePtr &ctrlPtr,
-    std::string &wsKey,
     const HttpRequestImplPtr &req,
     std::function<void(const HttpResponsePtr &)> &&callback,
     const WebSocketConnectionImplPtr &wsConnPtr)
 {
-    wsKey.append("258EAFA5-E914-47DA-95CA-C5AB0DC85B11");
-    unsigned char accKey[SHA_DIGEST_LENGTH];
-    SHA1(reinterpret_cast<const unsigned char *>(wsKey.c_str()),
-         wsKey.length(),
-         accKey);
-    auto base64Key = utils::base64Encode(accKey, SHA_DIGEST_LENGTH);
+    auto &wsKey = req->getHeaderBy("sec-websocket-key");
+    char accKey[WEBSOCKET_ACCEPT_KEY_LENGTH];
+    if (!computeWebSocketAcceptKey(wsKey.data(), wsKey.length(), accKey))
+    {
+        auto resp = HttpResponse::newHttpResponse();
+        resp->setStatusCode(k400BadRequest);
+        resp->setCloseConnection(true);
+        callback(resp);
+        return;
+    }
     auto resp = HttpResponse::newHttpResponse();
     resp->setStatusCode(k101SwitchingProtocols);
     resp->addHeader("Upgrade", "websocket");
     resp->addHeader("Connection", "Upgrade");
-    resp->addHeader("Sec-WebSocket-Accept", base64Key);
+    resp->addHeader("Sec-WebSocket-Accept",
+                    std::string(accKey, WEBSOCKET_ACCEPT_KEY_LENGTH));
+    auto &app = HttpAppFrameworkImpl::instance();
+    if (app.isWebSocketCompressionEnabled())
+    {
+        auto &offers = req->getHeaderBy("sec-websocket-extensions");
+        if (!offers.empty())
+        {
+            std::string extension;
+            auto deflate = WebSocketDeflate::acceptOffers(
+                offers, app.getWebSocketMaxWindowBits(), extension);
+            if (deflate)
+            {
+                resp->addHeader("Sec-WebSocket-Extensions", extension);
+                wsConnPtr->setDeflate(std::move(deflate));
+            }
+        }
+    }
     callback(resp);
+    if (ctrlPtr->usesWorkerThreads())
+        wsConnPtr->setWorkerQueue(app.getWebSocketWorkerQueue());
     wsConnPtr->setMessageCallback(
         [ctrlPtr](std::string &&message,
                   const WebSocketConnectionImplPtr &connPtr,
                   const WebSocketMessageType &type) {
             ctrlPtr->handleNewMessage(connPtr, std::move(message), type);
         });
+    if (ctrlPtr->isStreaming())
+    {
+        wsConnPtr->setFragmentCallback(
+            [ctrlPtr](std::string &&fragment,
+                      const WebSocketConnectionImplPtr &connPtr,
+                      const WebSocketMessageType &type,
+                      bool isFinal) {
+                ctrlPtr->handleNewFragment(connPtr,
+                                           std::move(fragment),
+                                           type,
+                                           isFinal);
+            });
+    }
     wsConnPtr->setCloseCallback(
         [ctrlPtr](const WebSocketConnectionImplPtr &connPtr) {
             ctrlPtr->handleConnectionClosed(connPtr);
@@ -56,7 +56,6 @@ class WebsocketControllersRouter : public trantor::NonCopyable
 
     void doControllerHandler(
         const WebSocketControllerBasePtr &ctrlPtr,
-        std::string &wsKey,
         const HttpRequestImplPtr &req,
         std::function<void(const HttpResponsePtr &)> &&callback,
         const WebSocketConnectionImplPtr &wsConnPtr);
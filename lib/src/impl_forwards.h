@@ -25,7 +25,14 @@ class HttpResponseImpl;
 typedef std::shared_ptr<HttpResponseImpl> HttpResponseImplPtr;
 class WebSocketConnectionImpl;
 typedef std::shared_ptr<WebSocketConnectionImpl> WebSocketConnectionImplPtr;
+class HttpClientImpl;
+typedef std::shared_ptr<HttpClientImpl> HttpClientImplPtr;
+class HttpProxyStream;
+typedef std::shared_ptr<HttpProxyStream> HttpProxyStreamPtr;
+class UpstreamGroup;
+typedef std::shared_ptr<UpstreamGroup> UpstreamGroupPtr;
 class HttpRequestParser;
+class HttpResponseParser;
 class StaticFileRouter;
 class HttpControllersRouter;
 class WebsocketControllersRouter;
@@ -35,6 +42,7 @@ class ListenerManager;
 class SharedLibManager;
 class SessionManager;
 class HttpServer;
+class AsyncFileIO;
 
 namespace orm
 {
@@ -50,6 +58,7 @@ class EventLoop;
 class TcpConnection;
 typedef std::shared_ptr<TcpConnection> TcpConnectionPtr;
 class Resolver;
+class ConcurrentTaskQueue;
 }  // namespace trantor
 
 namespace drogon
@@ -13,147 +13,126 @@
  */
 
 #include "Sha1.h"
+#include <stdint.h>
 #include <string.h>
 
-static inline unsigned int fromBigEndian(unsigned int v)
+static inline uint32_t loadBigEndian(const unsigned char *p)
 {
-    return ((v & 0xff) << 24) | ((v & 0xff00) << 8) | ((v & 0xff0000) >> 8) |
-           ((v & 0xff000000) >> 24);
+    return (static_cast<uint32_t>(p[0]) << 24) |
+           (static_cast<uint32_t>(p[1]) << 16) |
+           (static_cast<uint32_t>(p[2]) << 8) | static_cast<uint32_t>(p[3]);
 }
 
-static void writeBigEndian64(unsigned char *p, unsigned int v)
+static inline void storeBigEndian(unsigned char *p, uint32_t v)
 {
-    memset(p, 0, 8);
-    memcpy(p, &v, 4);
-    int i = 0;
-    for (i = 0; i < 4; i++)
-    {
-        unsigned char t = p[i];
-        p[i] = p[7 - i];
-        p[7 - i] = t;
-    }
+    p[0] = static_cast<unsigned char>(v >> 24);
+    p[1] = static_cast<unsigned char>(v >> 16);
+    p[2] = static_cast<unsigned char>(v >> 8);
+    p[3] = static_cast<unsigned char>(v);
 }
 
-static inline unsigned int leftRoll(unsigned int v, int n)
+static inline uint32_t leftRoll(uint32_t v, int n)
 {
     return (v << n) | (v >> (32 - n));
 }
 
-unsigned char *SHA1(const unsigned char *dataIn,
-                    size_t dataLen,
-                    unsigned char *dataOut)
+// Only the last 16 words of the message schedule are kept.
+static inline uint32_t nextWord(uint32_t *words, int i)
 {
-    unsigned char *pbytes = (unsigned char *)dataIn;
-    unsigned int nbyte = dataLen;
-
-    static unsigned int words[80];
-    unsigned int H[5] = {
-        0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
-    unsigned int f, k, temp, bitlen[2], word;
-    unsigned int i, j, index, p1, p2, maxlen;
-    unsigned char spec[4] = {0};
-    i = nbyte % 4;
-
-    p1 = nbyte - i;
-    spec[i] = 1 << 7;
-    while (i--)
-    {
-        spec[i] = pbytes[p1 + i];
-    }
+    if (i < 16)
+        return words[i];
+    words[i & 15] = leftRoll(words[(i + 13) & 15] ^ words[(i + 8) & 15] ^
+                                 words[(i + 2) & 15] ^ words[i & 15],
+                             1);
+    return words[i & 15];
+}
 
-    maxlen = (nbyte + 1) % 64;
-    if (maxlen <= 56)
+static void processBlock(uint32_t *state, const unsigned char *block)
+{
+    uint32_t words[16];
+    for (int i = 0; i < 16; ++i)
+        words[i] = loadBigEndian(block + i * 4);
+    uint32_t a = state[0];
+    uint32_t b = state[1];
+    uint32_t c = state[2];
+    uint32_t d = state[3];
+    uint32_t e = state[4];
+    uint32_t temp;
+    int i = 0;
+    for (; i < 20; ++i)
     {
-        maxlen = (nbyte + 1) - maxlen + 64;
+        temp = leftRoll(a, 5) + (d ^ (b & (c ^ d))) + e + 0x5A827999 +
+               nextWord(words, i);
+        e = d;
+        d = c;
+        c = leftRoll(b, 30);
+        b = a;
+        a = temp;
     }
-    else
+    for (; i < 40; ++i)
     {
-        maxlen = (nbyte + 1) - maxlen + 128;
+        temp = leftRoll(a, 5) + (b ^ c ^ d) + e + 0x6ED9EBA1 +
+               nextWord(words, i);
+        e = d;
+        d = c;
+        c = leftRoll(b, 30);
+        b = a;
+        a = temp;
     }
-    p2 = maxlen - 8;
-    writeBigEndian64((unsigned char *)bitlen, nbyte * 8);
-
-    for (j = 0; j < maxlen; j += 64)
+    for (; i < 60; ++i)
     {
-        unsigned int a, b, c, d, e;
-        a = H[0];
-        b = H[1];
-        c = H[2];
-        d = H[3];
-        e = H[4];
-        for (i = 0; i < 80; i++)
-        {
-            if (i < 16)
-            {
-                index = j + (i << 2);
-                if (index < p1)
-                {
-                    word = *((unsigned int *)(pbytes + index));
-                }
-                else if (index == p1)
-                {
-                    word = *(unsigned int *)spec;
-                }
-                else if (index < p2)
-                {
-                    word = 0;
-                }
-                else
-                {
-                    word = (index < maxlen - 4) ? bitlen[0] : bitlen[1];
-                }
-                words[i] = fromBigEndian(word);
-            }
-            else
-            {
-                words[i] = leftRoll(words[i - 3] ^ words[i - 8] ^
-                                        words[i - 14] ^ words[i - 16],
-                                    1);
-            }
-            if (i < 20)
-            {
-                f = (b & c) | ((~b) & d);
-                k = 0x5A827999;
-            }
-            else if (i < 40)
-            {
-                f = b ^ c ^ d;
-                k = 0x6ED9EBA1;
-            }
-            else if (i < 60)
-            {
-                f = (b & c) | (b & d) | (c & d);
-                k = 0x8F1BBCDC;
-            }
-            else
-            {
-                f = b ^ c ^ d;
-                k = 0xCA62C1D6;
-            }
-            temp = leftRoll(a, 5) + f + e + k + words[i];
-            e = d;
-            d = c;
-            c = leftRoll(b, 30);
-            b = a;
-            a = temp;
-        }
-        H[0] += a;
-        H[1] += b;
-        H[2] += c;
-        H[3] += d;
-        H[4] += e;
+        temp = leftRoll(a, 5) + ((b & c) | (d & (b | c))) + e + 0x8F1BBCDC +
+               nextWord(words, i);
+        e = d;
+        d = c;
+        c = leftRoll(b, 30);
+        b = a;
+        a = temp;
     }
-    int ct = 0;
-    for (i = 0; i < 5; i++)
+    for (; i < 80; ++i)
     {
-        unsigned char buf[4] = {0};
-        memcpy(buf, &(H[i]), 4);
-        for (int r = 3; r >= 0; r--)
-        {
-            dataOut[ct] = buf[r];
-            ct++;
-        }
+        temp = leftRoll(a, 5) + (b ^ c ^ d) + e + 0xCA62C1D6 +
+               nextWord(words, i);
+        e = d;
+        d = c;
+        c = leftRoll(b, 30);
+        b = a;
+        a = temp;
     }
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+}
+
+unsigned char *SHA1(const unsigned char *dataIn,
+                    size_t dataLen,
+                    unsigned char *dataOut)
+{
+    // All state lives on the stack, so the function can be called by
+    // multiple threads at the same time.
+    uint32_t state[5] = {
+        0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+    size_t blocks = dataLen / 64;
+    for (size_t i = 0; i < blocks; ++i)
+        processBlock(state, dataIn + i * 64);
+
+    // The rest of the data, the padding and the bit length take one or two
+    // blocks.
+    unsigned char tail[128] = {0};
+    size_t rest = dataLen % 64;
+    memcpy(tail, dataIn + blocks * 64, rest);
+    tail[rest] = 0x80;
+    size_t tailLen = rest < 56 ? 64 : 128;
+    uint64_t bitLen = static_cast<uint64_t>(dataLen) * 8;
+    storeBigEndian(tail + tailLen - 8, static_cast<uint32_t>(bitLen >> 32));
+    storeBigEndian(tail + tailLen - 4, static_cast<uint32_t>(bitLen));
+    processBlock(state, tail);
+    if (tailLen == 128)
+        processBlock(state, tail + 64);
 
+    for (int i = 0; i < 5; ++i)
+        storeBigEndian(dataOut + i * 4, state[i]);
     return dataOut;
 }
@@ -0,0 +1,111 @@
+#include "../src/AsyncFileIO.h"
+#include <trantor/net/EventLoop.h>
+#include <algorithm>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+using namespace drogon;
+
+static const size_t blockSize = 4096;
+static const size_t fileSize = blockSize * 300 + 100;
+
+// Write and read a file with more requests at once than the entries of the
+// ring, then read past the end of the file and from a bad descriptor.
+static bool testFileIO(unsigned int entries)
+{
+    char path[] = "/tmp/drogon_file_io_XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0)
+        return false;
+    unlink(path);
+    std::string content(fileSize, '\0');
+    for (size_t i = 0; i < fileSize; ++i)
+        content[i] = static_cast<char>('a' + (i * 7 + i / blockSize) % 26);
+    std::string readBack(fileSize, '\0');
+    char tail[200];
+    char pastEnd[10];
+    char badFd[10];
+    bool success = true;
+
+    trantor::EventLoop loop;
+    AsyncFileIO fileIO(&loop, entries);
+    std::cout << "entries " << entries << ", "
+              << (fileIO.isAsync() ? "async" : "blocking") << ": ";
+
+    // The counter holds one for the step itself, so the next step starts
+    // when all requests are issued and done, whether the callbacks are
+    // called at once or later.
+    size_t pending = 0;
+    std::function<void()> next;
+    auto release = [&]() {
+        if (--pending == 0)
+            loop.queueInLoop([&]() {
+                auto step = std::move(next);
+                step();
+            });
+    };
+    auto expect = [&](ssize_t expected) {
+        ++pending;
+        return [&, expected](ssize_t result) {
+            if (result != expected)
+            {
+                std::cout << "got " << result << " instead of " << expected
+                          << "; ";
+                success = false;
+            }
+            release();
+        };
+    };
+    auto readStep = [&]() {
+        pending = 1;
+        next = [&]() { loop.quit(); };
+        for (size_t offset = 0; offset < fileSize; offset += blockSize)
+        {
+            auto len = std::min(blockSize, fileSize - offset);
+            fileIO.read(fd, &readBack[offset], len, offset, expect(len));
+        }
+        // Short reads only happen at the end of the file.
+        fileIO.read(fd, tail, sizeof(tail), fileSize - 100, expect(100));
+        fileIO.read(fd, pastEnd, sizeof(pastEnd), fileSize, expect(0));
+        fileIO.read(-1, badFd, sizeof(badFd), 0, expect(-EBADF));
+        release();
+    };
+    loop.queueInLoop([&]() {
+        pending = 1;
+        next = readStep;
+        for (size_t offset = 0; offset < fileSize; offset += blockSize)
+        {
+            auto len = std::min(blockSize, fileSize - offset);
+            fileIO.write(fd, &content[offset], len, offset, expect(len));
+        }
+        release();
+    });
+    loop.runAfter(10.0, [&]() {
+        std::cout << "timeout; ";
+        success = false;
+        loop.quit();
+    });
+    loop.loop();
+    close(fd);
+    if (pending != 0 || readBack != content ||
+        memcmp(tail, content.data() + fileSize - 100, 100) != 0)
+        success = false;
+    std::cout << (success ? "done" : "error") << std::endl;
+    return success;
+}
+
+int main()
+{
+    bool success = true;
+    // A ring of 4 entries keeps most requests waiting, a ring of 0 entries
+    // can't be set up and the blocking calls are used.
+    for (unsigned int entries : {256, 4, 0})
+        success &= testFileIO(entries);
+    std::cout << (success ? "OK" : "Error") << std::endl;
+    return success ? 0 : 1;
+}
@@ -0,0 +1,88 @@
+#include <drogon/drogon.h>
+#include <drogon/utils/coroutine.h>
+#include <iostream>
+#include <string>
+
+using namespace drogon;
+
+// The clients run in the main loop, the handler awaits them in an IO loop.
+static HttpClientPtr plainClient;
+static HttpClientPtr badClient;
+
+// Only compiled, running it needs a database.
+[[maybe_unused]] static Task<size_t> countUsers(orm::DbClientPtr client)
+{
+    auto result = co_await client->execSqlCoro("select * from users");
+    co_return result.size();
+}
+
+int main()
+{
+    app().registerHandler(
+        "/plain",
+        [](const HttpRequestPtr &,
+           std::function<void(const HttpResponsePtr &)> &&callback) {
+            auto resp = HttpResponse::newHttpResponse();
+            resp->setBody("plain");
+            callback(resp);
+        });
+    // The parameters are taken by value, they are used after the coroutine
+    // is suspended.
+    app().registerHandler(
+        "/coro",
+        [](HttpRequestPtr req,
+           std::function<void(const HttpResponsePtr &)> callback)
+            -> AsyncTask {
+            auto loop = trantor::EventLoop::getEventLoopOfCurrentThread();
+            auto plainReq = HttpRequest::newHttpRequest();
+            plainReq->setPath("/plain");
+            auto plainResp = co_await plainClient->sendRequestCoro(plainReq);
+            std::string body = plainResp->getBody();
+            if (trantor::EventLoop::getEventLoopOfCurrentThread() != loop)
+                body += ", moved";
+            try
+            {
+                co_await badClient->sendRequestCoro(
+                    HttpRequest::newHttpRequest());
+                body += ", no exception";
+            }
+            catch (const HttpRequestException &e)
+            {
+                std::cout << "exception: " << e.what() << std::endl;
+                body += ", threw";
+            }
+            if (trantor::EventLoop::getEventLoopOfCurrentThread() != loop)
+                body += ", moved";
+            auto resp = HttpResponse::newHttpResponse();
+            resp->setBody(body + ", " + req->getParameter("name"));
+            callback(resp);
+        });
+    app().addListener("127.0.0.1", 8861);
+    app().setThreadNum(1);
+
+    bool success = false;
+    auto loop = app().getLoop();
+    loop->runAfter(0.5, [loop, &success]() {
+        plainClient = HttpClient::newHttpClient("http://127.0.0.1:8861", loop);
+        // Nothing listens to the port.
+        badClient = HttpClient::newHttpClient("http://127.0.0.1:8862", loop);
+        auto req = HttpRequest::newHttpRequest();
+        req->setPath("/coro");
+        req->setParameter("name", "coro");
+        plainClient->sendRequest(
+            req, [&success](ReqResult result, const HttpResponsePtr &resp) {
+                if (result != ReqResult::Ok)
+                    return;
+                std::cout << "body: " << resp->getBody() << std::endl;
+                success = resp->getBody() == "plain, threw, coro";
+            });
+    });
+    loop->runAfter(3.0, []() {
+        plainClient.reset();
+        badClient.reset();
+        app().quit();
+    });
+    app().run();
+    std::cout << (success ? "OK" : "Error") << std::endl;
+    return success ? 0 : 1;
+}
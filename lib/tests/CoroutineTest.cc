@@ -0,0 +1,82 @@
+#include <drogon/utils/coroutine.h>
+#include <trantor/net/EventLoopThread.h>
+#include <future>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+
+using namespace drogon;
+
+// Completes in another thread, like the callback of a client.
+class ThreadAwaiter : public internal::CallbackAwaiter<int>
+{
+  public:
+    ThreadAwaiter(int value, bool fail) : _value(value), _fail(fail)
+    {
+    }
+    void await_suspend(std::coroutine_handle<> handle)
+    {
+        suspend(handle);
+        std::thread([this]() {
+            if (_fail)
+                setException(
+                    std::make_exception_ptr(std::runtime_error("failed")));
+            else
+                setValue(_value);
+            resume();
+        }).detach();
+    }
+
+  private:
+    int _value;
+    bool _fail;
+};
+
+Task<int> add(int a, int b)
+{
+    auto value = co_await ThreadAwaiter(a, false);
+    co_return value + b;
+}
+
+Task<> fail()
+{
+    co_await ThreadAwaiter(0, true);
+}
+
+AsyncTask run(trantor::EventLoop *loop, std::promise<bool> &done)
+{
+    bool success = true;
+    auto sum = co_await add(1, 2);
+    std::cout << "sum: " << sum << std::endl;
+    // Resumed in the loop, not in the thread of the awaiter.
+    if (sum != 3 || !loop->isInLoopThread())
+        success = false;
+    try
+    {
+        co_await fail();
+        success = false;
+    }
+    catch (const std::runtime_error &e)
+    {
+        std::cout << "exception: " << e.what() << std::endl;
+    }
+    if (!loop->isInLoopThread())
+        success = false;
+    done.set_value(success);
+}
+
+int main()
+{
+    trantor::EventLoopThread loopThread;
+    loopThread.run();
+    auto loop = loopThread.getLoop();
+    std::promise<bool> done;
+    auto f = done.get_future();
+    loop->runInLoop([loop, &done]() { run(loop, done); });
+    auto success = f.get();
+    if (success)
+        std::cout << "OK" << std::endl;
+    else
+        std::cout << "Error" << std::endl;
+    return success ? 0 : 1;
+}
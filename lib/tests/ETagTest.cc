@@ -0,0 +1,72 @@
+#include "../src/HttpUtils.h"
+#include <iostream>
+
+using namespace drogon;
+
+static HttpResponsePtr conditionalResponse(HttpMethod method,
+                                           const std::string &ifNoneMatch,
+                                           const std::string &etag)
+{
+    auto req = HttpRequest::newHttpRequest();
+    req->setMethod(method);
+    req->addHeader("If-None-Match", ifNoneMatch);
+    auto resp = HttpResponse::newHttpResponse();
+    resp->addHeader("ETag", etag);
+    resp->addHeader("Cache-Control", "max-age=60");
+    resp->addHeader("Expires", "Thu, 01 Jan 1970 00:00:00 GMT");
+    resp->addHeader("Vary", "Accept-Encoding");
+    resp->addHeader("Content-Language", "en");
+    return getNotModifiedResponse(req, resp);
+}
+
+int main()
+{
+    bool success = true;
+    const std::string etag = "\"2a4b1-1b3-5da52e7d\"";
+    std::cout << isETagMatched(etag, etag) << std::endl;
+    std::cout << isETagMatched("W/\"2a4b1-1b3-5da52e7d\"", etag) << std::endl;
+    std::cout << isETagMatched("\"xyz\", \"2a4b1-1b3-5da52e7d\"", etag)
+              << std::endl;
+    std::cout << isETagMatched("*", etag) << std::endl;
+    std::cout << isETagMatched("\"xyz\"", etag) << std::endl;
+    std::cout << isETagMatched("\"2a4b1\"", etag) << std::endl;
+    if (!isETagMatched(etag, etag) ||
+        !isETagMatched("W/\"2a4b1-1b3-5da52e7d\"", etag) ||
+        !isETagMatched("\"xyz\", \"2a4b1-1b3-5da52e7d\"", etag) ||
+        !isETagMatched("*", etag) || isETagMatched("\"xyz\"", etag) ||
+        isETagMatched("\"2a4b1\"", etag))
+        success = false;
+
+    // Commas in opaque tags don't separate the tags of the list.
+    std::cout << isETagMatched("\"xyz\", W/\"a,b\"", "\"a,b\"") << std::endl;
+    std::cout << isETagMatched("\"a,b\"", "\"a\"") << std::endl;
+    std::cout << isETagMatched("\"a,b\"", "\"b\"") << std::endl;
+    if (!isETagMatched("\"xyz\", W/\"a,b\"", "\"a,b\"") ||
+        isETagMatched("\"a,b\"", "\"a\"") || isETagMatched("\"a,b\"", "\"b\""))
+        success = false;
+
+    // A 304 response keeps the caching headers of the 200 one.
+    for (auto method : {Get, Head})
+    {
+        auto resp = conditionalResponse(method, etag, etag);
+        if (!resp || resp->statusCode() != k304NotModified ||
+            resp->getHeader("etag") != etag ||
+            resp->getHeader("cache-control") != "max-age=60" ||
+            resp->getHeader("expires") != "Thu, 01 Jan 1970 00:00:00 GMT" ||
+            resp->getHeader("vary") != "Accept-Encoding" ||
+            !resp->getHeader("content-language").empty())
+            success = false;
+    }
+    if (conditionalResponse(Get, "\"xyz\"", etag))
+        success = false;
+
+    // Other methods are performed before the response is checked, so it's
+    // sent as is.
+    for (auto method : {Post, Put, Delete})
+    {
+        if (conditionalResponse(method, "*", etag))
+            success = false;
+    }
+    std::cout << (success ? "OK" : "Error") << std::endl;
+    return success ? 0 : 1;
+}
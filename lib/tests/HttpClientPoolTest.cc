@@ -0,0 +1,73 @@
+#include <drogon/drogon.h>
+#include <trantor/net/EventLoop.h>
+#include <iostream>
+#include <string>
+
+using namespace drogon;
+
+int main()
+{
+    // The slow handler responds after 1 second.
+    app().registerHandler(
+        "/slow",
+        [](const HttpRequestPtr &,
+           std::function<void(const HttpResponsePtr &)> &&callback) {
+            auto loop = trantor::EventLoop::getEventLoopOfCurrentThread();
+            loop->runAfter(1.0, [callback = std::move(callback)]() {
+                auto resp = HttpResponse::newHttpResponse();
+                resp->setBody("slow");
+                callback(resp);
+            });
+        });
+    app().registerHandler(
+        "/fast",
+        [](const HttpRequestPtr &,
+           std::function<void(const HttpResponsePtr &)> &&callback) {
+            auto resp = HttpResponse::newHttpResponse();
+            resp->setBody("fast");
+            callback(resp);
+        });
+    app().addListener("127.0.0.1", 8855);
+
+    // With a pool of 2 connections, the fast request sent while the slow one
+    // is in flight goes to a new connection instead of being pipelined
+    // behind the slow response.
+    std::string order;
+    auto client = HttpClient::newHttpClient("http://127.0.0.1:8855",
+                                            app().getLoop());
+    client->setMaxConnectionNum(2);
+    client->setPipeliningDepth(4);
+    app().getLoop()->runAfter(0.5, [client, &order]() {
+        auto slowReq = HttpRequest::newHttpRequest();
+        slowReq->setPath("/slow");
+        client->sendRequest(slowReq,
+                            [&order](ReqResult result,
+                                     const HttpResponsePtr &resp) {
+                                if (result == ReqResult::Ok &&
+                                    resp->body() == "slow")
+                                    order.append("slow;");
+                                app().quit();
+                            });
+        app().getLoop()->runAfter(0.2, [client, &order]() {
+            auto fastReq = HttpRequest::newHttpRequest();
+            fastReq->setPath("/fast");
+            client->sendRequest(fastReq,
+                                [&order](ReqResult result,
+                                         const HttpResponsePtr &resp) {
+                                    if (result == ReqResult::Ok &&
+                                        resp->body() == "fast")
+                                        order.append("fast;");
+                                });
+        });
+    });
+    app().getLoop()->runAfter(10.0, []() { app().quit(); });
+    app().run();
+    std::cout << order << std::endl;
+    if (order != "fast;slow;")
+    {
+        std::cout << "Error" << std::endl;
+        return 1;
+    }
+    std::cout << "OK" << std::endl;
+    return 0;
+}
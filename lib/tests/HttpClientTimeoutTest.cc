@@ -0,0 +1,114 @@
+#include <drogon/drogon.h>
+#include <atomic>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace drogon;
+
+static std::atomic<int> finished(0);
+static bool success = true;
+
+static void expect(const std::string &name,
+                   const HttpClientPtr &client,
+                   const HttpRequestPtr &req,
+                   ReqResult expected,
+                   double timeout,
+                   double maxDelay)
+{
+    auto start = trantor::Date::now();
+    auto calls = std::make_shared<int>(0);
+    client->sendRequest(
+        req,
+        [name, expected, maxDelay, start, calls](ReqResult result,
+                                                 const HttpResponsePtr &) {
+            auto delay = (trantor::Date::now().microSecondsSinceEpoch() -
+                          start.microSecondsSinceEpoch()) /
+                         1000000.0;
+            std::cout << name << ": " << static_cast<int>(result) << " in "
+                      << delay << "s" << std::endl;
+            if (result != expected || delay > maxDelay || ++*calls > 1)
+                success = false;
+            ++finished;
+        },
+        timeout);
+}
+
+int main()
+{
+    // The handler never responds, the callbacks are kept so the connections
+    // are not closed.
+    std::vector<std::function<void(const HttpResponsePtr &)>> pending;
+    app().registerHandler(
+        "/never",
+        [&pending](const HttpRequestPtr &,
+                   std::function<void(const HttpResponsePtr &)> &&callback) {
+            pending.push_back(std::move(callback));
+        });
+    app().registerHandler(
+        "/fast",
+        [](const HttpRequestPtr &,
+           std::function<void(const HttpResponsePtr &)> &&callback) {
+            callback(HttpResponse::newHttpResponse());
+        });
+    app().addListener("127.0.0.1", 8856);
+    app().setThreadNum(1);
+
+    auto loop = app().getLoop();
+    loop->runAfter(0.5, [loop]() {
+        auto newRequest = [](const std::string &path) {
+            auto req = HttpRequest::newHttpRequest();
+            req->setPath(path);
+            return req;
+        };
+        auto newClient = [loop]() {
+            return HttpClient::newHttpClient("http://127.0.0.1:8856", loop);
+        };
+
+        // The timeout of the request.
+        expect("timeout",
+               newClient(),
+               newRequest("/never"),
+               ReqResult::Timeout,
+               0.3,
+               1.0);
+
+        // The timeout of the client.
+        auto client = newClient();
+        client->setTimeout(0.3);
+        expect("client timeout",
+               client,
+               newRequest("/never"),
+               ReqResult::Timeout,
+               0,
+               1.0);
+
+        // The deadline is earlier than the timeout.
+        auto req = newRequest("/never");
+        req->setDeadline(trantor::Date::now().after(0.3));
+        expect("deadline", newClient(), req, ReqResult::Timeout, 10.0, 1.0);
+
+        // A request cancelled while waiting for its response.
+        client = newClient();
+        req = newRequest("/never");
+        expect("cancel", client, req, ReqResult::Cancelled, 0, 1.0);
+        loop->runAfter(0.2, [client, req]() { client->cancelRequest(req); });
+
+        // The timeout of a request which is done doesn't fire.
+        expect("done",
+               newClient(),
+               newRequest("/fast"),
+               ReqResult::Ok,
+               0.3,
+               1.0);
+    });
+    loop->runAfter(2.0, []() { app().quit(); });
+    app().run();
+    if (!success || finished != 5)
+    {
+        std::cout << "Error" << std::endl;
+        return 1;
+    }
+    std::cout << "OK" << std::endl;
+    return 0;
+}
@@ -0,0 +1,121 @@
+#include <drogon/drogon.h>
+#include <drogon/HttpFanOut.h>
+#include <atomic>
+#include <iostream>
+#include <string>
+
+using namespace drogon;
+
+static bool success = true;
+
+static double secondsSince(const trantor::Date &start)
+{
+    return (trantor::Date::now().microSecondsSinceEpoch() -
+            start.microSecondsSinceEpoch()) /
+           1000000.0;
+}
+
+static HttpRequestPtr newRequest(const std::string &path)
+{
+    auto req = HttpRequest::newHttpRequest();
+    req->setPath(path);
+    return req;
+}
+
+int main()
+{
+    auto respond = [](const std::string &body,
+                      std::function<void(const HttpResponsePtr &)> &callback,
+                      double delay) {
+        auto resp = HttpResponse::newHttpResponse();
+        resp->setBody(body);
+        if (delay == 0)
+        {
+            callback(resp);
+            return;
+        }
+        trantor::EventLoop::getEventLoopOfCurrentThread()->runAfter(
+            delay, [callback = std::move(callback), resp]() {
+                callback(resp);
+            });
+    };
+    app().registerHandler(
+        "/fast",
+        [respond](const HttpRequestPtr &,
+                  std::function<void(const HttpResponsePtr &)> &&callback) {
+            respond("fast", callback, 0);
+        });
+    app().registerHandler(
+        "/slow",
+        [respond](const HttpRequestPtr &,
+                  std::function<void(const HttpResponsePtr &)> &&callback) {
+            respond("slow", callback, 2.0);
+        });
+    // The first request is slow, its hedged copy is fast.
+    std::atomic<int> hedgeCount(0);
+    app().registerHandler(
+        "/hedge",
+        [respond, &hedgeCount](
+            const HttpRequestPtr &,
+            std::function<void(const HttpResponsePtr &)> &&callback) {
+            if (hedgeCount++ == 0)
+                respond("original", callback, 2.0);
+            else
+                respond("copy", callback, 0);
+        });
+    app().addListener("127.0.0.1", 8857);
+
+    auto loop = app().getLoop();
+    int finished = 0;
+    loop->runAfter(0.5, [loop, &finished]() {
+        auto newClient = [loop]() {
+            return HttpClient::newHttpClient("http://127.0.0.1:8857", loop);
+        };
+
+        // The fan-out completes when 2 of the 3 requests succeed, the slow
+        // one is not waited for.
+        auto start = trantor::Date::now();
+        auto fanOut = HttpFanOut::newHttpFanOut(loop);
+        fanOut->addRequest(newRequest("/fast"), newClient());
+        fanOut->addRequest(newRequest("/slow"), newClient());
+        fanOut->addRequest(newRequest("/fast"), newClient());
+        fanOut->setQuorum(2);
+        fanOut->send([start, &finished](
+                         const std::vector<HttpFanOutResult> &results) {
+            auto delay = secondsSince(start);
+            std::cout << "quorum: " << delay << "s" << std::endl;
+            if (results.size() != 3 || results[0]._result != ReqResult::Ok ||
+                results[1]._result != ReqResult::Cancelled ||
+                results[2]._result != ReqResult::Ok || delay > 1.0)
+                success = false;
+            if (++finished == 2)
+                app().quit();
+        });
+
+        // The copy sent after the hedge delay by the second client finishes
+        // first.
+        start = trantor::Date::now();
+        fanOut = HttpFanOut::newHttpFanOut(loop);
+        fanOut->addRequest(newRequest("/hedge"), {newClient(), newClient()});
+        fanOut->setHedgeDelay(0.1);
+        fanOut->send([start, &finished](
+                         const std::vector<HttpFanOutResult> &results) {
+            auto delay = secondsSince(start);
+            std::cout << "hedge: " << delay << "s" << std::endl;
+            if (results.size() != 1 || results[0]._result != ReqResult::Ok ||
+                results[0]._response->body() != "copy" || delay > 1.0)
+                success = false;
+            if (++finished == 2)
+                app().quit();
+        });
+    });
+    loop->runAfter(10.0, []() { app().quit(); });
+    app().run();
+    if (!success || finished != 2)
+    {
+        std::cout << "Error" << std::endl;
+        return 1;
+    }
+    std::cout << "OK" << std::endl;
+    return 0;
+}
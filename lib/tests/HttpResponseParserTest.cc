@@ -0,0 +1,112 @@
+#include "../src/HttpResponseParser.h"
+#include "../src/HttpResponseImpl.h"
+#include <trantor/utils/MsgBuffer.h>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace drogon;
+
+static const std::string nextResponse = "HTTP/1.1 204 No Content\r\n\r\n";
+
+// Parse the response in the given parts and check the relayed bytes, a
+// response which isn't delimited by the connection must leave the next
+// response in the buffer.
+static bool relay(const std::string &headers,
+                  const std::string &body,
+                  bool closeDelimited,
+                  const std::vector<size_t> &splits)
+{
+    auto data = headers + body + (closeDelimited ? "" : nextResponse);
+    HttpResponseParser parser;
+    int headersCount = 0;
+    bool bodyBeforeHeaders = false;
+    std::string relayed;
+    parser.setStreamCallbacks([&headersCount]() { ++headersCount; },
+                              [&](const char *bytes, size_t len) {
+                                  if (headersCount == 0)
+                                      bodyBeforeHeaders = true;
+                                  relayed.append(bytes, len);
+                              });
+    trantor::MsgBuffer buf;
+    size_t offset = 0;
+    for (auto split : splits)
+    {
+        if (parser.gotAll())
+            break;
+        buf.append(data.data() + offset, split - offset);
+        offset = split;
+        if (!parser.parseResponse(&buf))
+            return false;
+    }
+    auto left = std::string(buf.peek(), buf.readableBytes()) +
+                data.substr(offset);
+    if (headersCount != 1 || bodyBeforeHeaders || relayed != body ||
+        parser.responseImpl()->statusCode() != k200OK)
+        return false;
+    if (closeDelimited)
+        return parser.waitingForClose() && !parser.gotAll() && left.empty();
+    return parser.gotAll() && left == nextResponse;
+}
+
+static bool relayAllSplits(const std::string &name,
+                           const std::string &headers,
+                           const std::string &body,
+                           bool closeDelimited)
+{
+    auto length = headers.length() + body.length() +
+                  (closeDelimited ? 0 : nextResponse.length());
+    bool success = true;
+    // Split in two parts at every byte.
+    for (size_t i = 0; i <= length; ++i)
+    {
+        if (!relay(headers, body, closeDelimited, {i, length}))
+        {
+            std::cout << name << ": error when split at " << i << std::endl;
+            success = false;
+        }
+    }
+    // Fed byte by byte.
+    std::vector<size_t> splits;
+    for (size_t i = 1; i <= length; ++i)
+        splits.push_back(i);
+    if (!relay(headers, body, closeDelimited, splits))
+    {
+        std::cout << name << ": error when fed byte by byte" << std::endl;
+        success = false;
+    }
+    std::cout << name << ": " << (success ? "relayed" : "error") << std::endl;
+    return success;
+}
+
+int main()
+{
+    bool success = true;
+    // The chunk-size lines, the CRLF after the data, the extensions and the
+    // last chunk are relayed as they are.
+    success &= relayAllSplits("chunked",
+                              "HTTP/1.1 200 OK\r\n"
+                              "Transfer-Encoding: chunked\r\n\r\n",
+                              "5\r\nhello\r\n"
+                              "b;ext=1\r\n world\r\n\r\n!\r\n"
+                              "1\r\n!\r\n"
+                              "0\r\n\r\n",
+                              false);
+    success &= relayAllSplits("content-length",
+                              "HTTP/1.1 200 OK\r\n"
+                              "Content-Length: 13\r\n\r\n",
+                              "hello\r\nworld!",
+                              false);
+    success &= relayAllSplits("empty content",
+                              "HTTP/1.1 200 OK\r\n"
+                              "Content-Length: 0\r\n\r\n",
+                              "",
+                              false);
+    success &= relayAllSplits("until close",
+                              "HTTP/1.1 200 OK\r\n"
+                              "Connection: close\r\n\r\n",
+                              "hello\r\n0\r\n\r\nworld",
+                              true);
+    std::cout << (success ? "OK" : "Error") << std::endl;
+    return success ? 0 : 1;
+}
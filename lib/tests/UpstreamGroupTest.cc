@@ -0,0 +1,86 @@
+#include "../src/UpstreamGroup.h"
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace drogon;
+int main()
+{
+    bool success = true;
+    std::vector<std::string> hosts = {"http://127.0.0.1:8081",
+                                      "http://127.0.0.1:8082",
+                                      "http://127.0.0.1:8083"};
+    auto req = HttpRequest::newHttpRequest();
+
+    // Round robin, a host ejected after 2 failures in a row is skipped.
+    UpstreamGroup roundRobin("rr", hosts, "round_robin", "", "", 0, 2, 30.0, 1);
+    std::vector<size_t> counts(hosts.size());
+    for (size_t i = 0; i < 30; ++i)
+    {
+        auto index = roundRobin.choose(req);
+        ++counts[index];
+        roundRobin.finishRequest(index, index != 1);
+    }
+    std::cout << "round robin: " << counts[0] << " " << counts[1] << " "
+              << counts[2] << std::endl;
+    if (counts[1] != 2 || counts[0] + counts[2] != 28)
+        success = false;
+
+    // Least connections.
+    UpstreamGroup leastConn("lc",
+                            hosts,
+                            "least_connections",
+                            "",
+                            "",
+                            0,
+                            3,
+                            30.0,
+                            1);
+    auto first = leastConn.choose(req);
+    auto second = leastConn.choose(req);
+    auto third = leastConn.choose(req);
+    if (first == second || second == third || first == third)
+        success = false;
+    leastConn.finishRequest(second, true);
+    if (leastConn.choose(req) != second)
+        success = false;
+
+    // Consistent hash, the same key goes to the same host, and only goes to
+    // another host when its host is down.
+    UpstreamGroup hash("ch",
+                       hosts,
+                       "consistent_hash",
+                       "header:x-user-id",
+                       "",
+                       0,
+                       1,
+                       30.0,
+                       1);
+    req->addHeader("x-user-id", "12345");
+    auto index = hash.choose(req);
+    hash.finishRequest(index, true);
+    for (size_t i = 0; i < 10; ++i)
+    {
+        auto next = hash.choose(req);
+        hash.finishRequest(next, true);
+        if (next != index)
+            success = false;
+    }
+    auto excluded = hash.choose(req, index);
+    hash.finishRequest(excluded, true);
+    if (excluded == index)
+        success = false;
+    hash.finishRequest(hash.choose(req), false);
+    auto other = hash.choose(req);
+    hash.finishRequest(other, true);
+    if (other == index)
+        success = false;
+    if (!UpstreamGroup::isIdempotent(Get) || UpstreamGroup::isIdempotent(Post))
+        success = false;
+
+    if (success)
+        std::cout << "OK" << std::endl;
+    else
+        std::cout << "Error" << std::endl;
+    return success ? 0 : 1;
+}
@@ -0,0 +1,35 @@
+#include "../src/WebSocketAcceptKey.h"
+#include <iostream>
+#include <string>
+
+using namespace drogon;
+int main()
+{
+    bool success = true;
+    // The example of rfc6455-1.3
+    std::string key = "dGhlIHNhbXBsZSBub25jZQ==";
+    char accept[WEBSOCKET_ACCEPT_KEY_LENGTH];
+    if (!computeWebSocketAcceptKey(key.data(), key.length(), accept))
+        success = false;
+    std::string acceptStr(accept, WEBSOCKET_ACCEPT_KEY_LENGTH);
+    std::cout << acceptStr << std::endl;
+    if (acceptStr != "s3pPLMBiTxaQ9kYGzzhZRbK+xOo=")
+        success = false;
+    // The key and the GUID take two SHA1 blocks.
+    std::string longKey(60, 'a');
+    if (!computeWebSocketAcceptKey(longKey.data(), longKey.length(), accept))
+        success = false;
+    acceptStr.assign(accept, WEBSOCKET_ACCEPT_KEY_LENGTH);
+    std::cout << acceptStr << std::endl;
+    if (acceptStr != "tcgN0NU24HLnPXrs4KLF3gkeQB0=")
+        success = false;
+    std::string hugeKey(1000, 'a');
+    if (computeWebSocketAcceptKey(hugeKey.data(), hugeKey.length(), accept) ||
+        computeWebSocketAcceptKey("", 0, accept))
+        success = false;
+    if (success)
+        std::cout << "OK" << std::endl;
+    else
+        std::cout << "Error" << std::endl;
+    return success ? 0 : 1;
+}
@@ -0,0 +1,47 @@
+#include "../src/WebSocketDeflate.h"
+#include <iostream>
+#include <string>
+
+using namespace drogon;
+int main()
+{
+    bool success = true;
+    std::string extension;
+    auto server = WebSocketDeflate::acceptOffers(
+        "x-webkit-deflate-frame, permessage-deflate; client_max_window_bits",
+        10,
+        extension);
+    std::cout << extension << std::endl;
+    bool valid = false;
+    auto client = WebSocketDeflate::acceptResponse(extension, 15, valid);
+    if (!server || !client || !valid)
+    {
+        std::cout << "Error" << std::endl;
+        return 1;
+    }
+    std::string json =
+        "{\"id\":1,\"name\":\"drogon\",\"tags\":[\"web\",\"c++\"]}";
+    for (int i = 0; i < 5; ++i)
+    {
+        std::string compressed, msg;
+        if (!client->compress(json.data(), json.length(), compressed) ||
+            !server->decompress(
+                compressed.data(), compressed.length(), msg, 1024) ||
+            msg != json)
+            success = false;
+        // Later messages are shorter because the context is taken over.
+        std::cout << json.length() << " -> " << compressed.length()
+                  << std::endl;
+    }
+    std::string big(100000, 'a'), compressed, msg;
+    server->compress(big.data(), big.length(), compressed);
+    if (client->decompress(compressed.data(), compressed.length(), msg, 1024))
+        success = false;
+    // The "Hello" example of rfc7692-7.2.3.1
+    WebSocketDeflate deflate(15, false, 15, false);
+    if (!deflate.decompress("\xf2\x48\xcd\xc9\xc9\x07\x00", 7, msg, 1024) ||
+        msg != "Hello")
+        success = false;
+    std::cout << (success ? "OK" : "Error") << std::endl;
+    return success ? 0 : 1;
+}
@@ -0,0 +1,26 @@
+#include <drogon/WebSocketConnection.h>
+#include <iostream>
+#include <string>
+
+using namespace drogon;
+int main()
+{
+    bool success = true;
+    for (size_t len : {0, 5, 125, 126, 65535, 65536, 100000})
+    {
+        std::string msg(len, 'a');
+        auto frame =
+            WebSocketFrame::newFrame(msg, WebSocketMessageType::Binary);
+        auto &data = frame->data();
+        std::cout << len << ": header length "
+                  << data.length() - frame->payloadLength() << std::endl;
+        if ((unsigned char)data[0] != 0x82 || frame->payloadLength() != len ||
+            std::string(frame->payload(), frame->payloadLength()) != msg)
+            success = false;
+    }
+    auto frame = WebSocketFrame::newFrame("hello");
+    if (frame->data() != std::string("\x81\x05hello"))
+        success = false;
+    std::cout << (success ? "OK" : "Error") << std::endl;
+    return success ? 0 : 1;
+}
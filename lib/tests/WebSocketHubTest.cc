@@ -0,0 +1,191 @@
+#include <drogon/drogon.h>
+#include <drogon/WebSocketClient.h>
+#include <drogon/WebSocketController.h>
+#include <drogon/WebSocketHub.h>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+using namespace drogon;
+
+static const size_t bigSize = 32 * 1024 * 1024;
+
+static std::unique_ptr<WebSocketHub> plainHub;
+static std::unique_ptr<WebSocketHub> dropHub;
+static std::unique_ptr<WebSocketHub> coalesceHub;
+static std::mutex mutex;
+static std::set<trantor::EventLoop *> plainLoops;
+static std::weak_ptr<WebSocketConnection> closedSubscriber;
+
+static WebSocketHub *hubOf(const WebSocketConnectionPtr &conn)
+{
+    auto &path = *conn->getContext<std::string>();
+    if (path == "/drop")
+        return dropHub.get();
+    if (path == "/coalesce")
+        return coalesceHub.get();
+    return plainHub.get();
+}
+
+// A message is a topic to subscribe to, except "burst", which congests the
+// connection with a big message followed by small ones, and "last".
+class HubCtrl : public drogon::WebSocketController<HubCtrl>
+{
+  public:
+    virtual void handleNewMessage(const WebSocketConnectionPtr &conn,
+                                  std::string &&message,
+                                  const WebSocketMessageType &type) override
+    {
+        if (type != WebSocketMessageType::Text)
+            return;
+        auto hub = hubOf(conn);
+        if (message == "burst")
+        {
+            // The messages are published in the loop of the connection, so
+            // the small ones find it congested by the big one.
+            hub->publish("data",
+                         std::string(bigSize, 'a'),
+                         WebSocketMessageType::Binary);
+            for (auto msg : {"m1", "m2", "m3"})
+                hub->publish("data", msg);
+            return;
+        }
+        if (message == "last")
+        {
+            hub->publish("data", "m4");
+            return;
+        }
+        hub->subscribe(conn, message);
+        conn->send("subscribed");
+    }
+    virtual void handleNewConnection(
+        const HttpRequestPtr &req,
+        const WebSocketConnectionPtr &conn) override
+    {
+        conn->setContext(std::make_shared<std::string>(req->path()));
+        std::lock_guard<std::mutex> lock(mutex);
+        if (req->path() == "/plain")
+            plainLoops.insert(
+                trantor::EventLoop::getEventLoopOfCurrentThread());
+        else if (req->path() == "/closed")
+            closedSubscriber = conn;
+    }
+    virtual void handleConnectionClosed(
+        const WebSocketConnectionPtr &) override
+    {
+    }
+    WS_PATH_LIST_BEGIN
+    WS_PATH_ADD("/plain");
+    WS_PATH_ADD("/closed");
+    WS_PATH_ADD("/drop");
+    WS_PATH_ADD("/coalesce");
+    WS_PATH_LIST_END
+};
+
+int main()
+{
+    app().addListener("127.0.0.1", 8860);
+    app().setThreadNum(2);
+    app().setClientMaxWebSocketMessageSize(2 * bigSize);
+    plainHub.reset(new WebSocketHub);
+    dropHub.reset(new WebSocketHub(WebSocketHub::SlowConsumerPolicy::Drop, 1));
+    coalesceHub.reset(
+        new WebSocketHub(WebSocketHub::SlowConsumerPolicy::Coalesce, 1));
+
+    // The messages received by every client, the big one is recorded as
+    // "big".
+    std::vector<std::vector<std::string>> received(5);
+    std::vector<WebSocketClientPtr> clients;
+    int plainSubscribed = 0;
+    auto loop = app().getLoop();
+    auto connect = [&](size_t index,
+                       const std::string &path,
+                       const std::string &topic) {
+        auto client = WebSocketClient::newWebSocketClient("127.0.0.1", 8860);
+        client->setMessageHandler([&, index, path](
+                                      std::string &&message,
+                                      const WebSocketClientPtr &wsPtr,
+                                      const WebSocketMessageType &type) {
+            if (type == WebSocketMessageType::Ping ||
+                type == WebSocketMessageType::Pong)
+                return;
+            auto conn = wsPtr->getConnection();
+            if (message == "subscribed")
+            {
+                if (path == "/plain" && ++plainSubscribed == 2)
+                {
+                    // The subscribers are in two loops, each gets the
+                    // message once.
+                    plainHub->publish("news", "hello");
+                }
+                else if (path == "/closed")
+                {
+                    // Nothing is published to the topic any more, the hub
+                    // releases the connection when it's closed.
+                    conn->forceClose();
+                }
+                else if (path != "/plain")
+                {
+                    conn->send("burst");
+                }
+                return;
+            }
+            if (message.length() == bigSize)
+            {
+                received[index].push_back("big");
+                conn->send("last");
+                return;
+            }
+            received[index].push_back(message);
+        });
+        auto req = HttpRequest::newHttpRequest();
+        req->setPath(path);
+        client->connectToServer(req,
+                                [topic](ReqResult result,
+                                        const HttpResponsePtr &,
+                                        const WebSocketClientPtr &wsPtr) {
+                                    if (result == ReqResult::Ok)
+                                        wsPtr->getConnection()->send(topic);
+                                });
+        clients.push_back(client);
+    };
+    // The connections are dispatched to the IO loops in turn, the first two
+    // go to different loops.
+    loop->runAfter(0.5, [&]() {
+        connect(0, "/plain", "news");
+        connect(1, "/plain", "news");
+    });
+    loop->runAfter(1.0, [&]() {
+        connect(2, "/closed", "closing");
+        connect(3, "/drop", "data");
+        connect(4, "/coalesce", "data");
+    });
+    loop->runAfter(4.5, []() { app().quit(); });
+    app().run();
+
+    bool success = true;
+    std::vector<std::vector<std::string>> expected = {
+        {"hello"}, {"hello"}, {}, {"big", "m4"}, {"big", "m3", "m4"}};
+    for (size_t i = 0; i < received.size(); ++i)
+    {
+        std::cout << i << ":";
+        for (auto &message : received[i])
+            std::cout << " " << message;
+        std::cout << std::endl;
+        if (received[i] != expected[i])
+            success = false;
+    }
+    std::cout << plainLoops.size() << " loops of subscribers" << std::endl;
+    if (plainLoops.size() != 2)
+        success = false;
+    if (!closedSubscriber.expired())
+    {
+        std::cout << "The closed subscriber is kept by the hub" << std::endl;
+        success = false;
+    }
+    std::cout << (success ? "OK" : "Error") << std::endl;
+    return success ? 0 : 1;
+}
@@ -0,0 +1,36 @@
+#include "../src/WebSocketConnectionImpl.h"
+#include <iostream>
+#include <string>
+
+using namespace drogon;
+int main()
+{
+    const char maskingKey[4] = {'\x12', '\x34', '\x56', '\x78'};
+    std::string payload;
+    for (int i = 0; i < 1000; ++i)
+        payload.push_back(static_cast<char>(i * 7));
+    bool success = true;
+    // Check all the lengths and alignments around the SIMD block sizes.
+    for (size_t offset = 0; offset < 8; ++offset)
+    {
+        for (size_t len = 0; len + offset <= 200; ++len)
+        {
+            std::string masked(len, '\0');
+            applyWebSocketMask(&masked[0],
+                               payload.data() + offset,
+                               len,
+                               maskingKey);
+            for (size_t i = 0; i < len; ++i)
+            {
+                if (masked[i] != (payload[offset + i] ^ maskingKey[i % 4]))
+                    success = false;
+            }
+            // Unmask in place
+            applyWebSocketMask(&masked[0], masked.data(), len, maskingKey);
+            if (masked != payload.substr(offset, len))
+                success = false;
+        }
+    }
+    std::cout << (success ? "OK" : "Error") << std::endl;
+    return success ? 0 : 1;
+}
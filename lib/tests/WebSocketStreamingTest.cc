@@ -0,0 +1,91 @@
+#include "../src/WebSocketConnectionImpl.h"
+#include <trantor/utils/MsgBuffer.h>
+#include <algorithm>
+#include <iostream>
+#include <string>
+
+using namespace drogon;
+
+static std::string makeFrame(unsigned char opcode,
+                             bool fin,
+                             const std::string &payload)
+{
+    // Frames sent by clients are masked.
+    const char maskingKey[] = {'\x12', '\x34', '\x56', '\x78'};
+    std::string frame;
+    frame.push_back(char((fin ? 0x80 : 0) | opcode));
+    if (payload.length() <= 125)
+    {
+        frame.push_back(char(0x80 | payload.length()));
+    }
+    else
+    {
+        frame.push_back(char(0x80 | 126));
+        frame.push_back(char(payload.length() >> 8));
+        frame.push_back(char(payload.length() & 255));
+    }
+    frame.append(maskingKey, 4);
+    for (size_t i = 0; i < payload.length(); ++i)
+    {
+        frame.push_back(payload[i] ^ maskingKey[i & 3]);
+    }
+    return frame;
+}
+
+int main()
+{
+    std::string payload(1000, 'a');
+    for (size_t i = 0; i < payload.length(); ++i)
+        payload[i] += i % 26;
+    // A binary message in two fragments with a ping between them.
+    auto data = makeFrame(2, false, payload) + makeFrame(9, true, "ping") +
+                makeFrame(0, true, "end");
+    bool success = true;
+    for (size_t step : {1, 10, 100, 10000})
+    {
+        WebSocketMessageParser parser;
+        parser.enableStreaming();
+        trantor::MsgBuffer buffer;
+        std::string message, control;
+        int finalCount = 0;
+        for (size_t offset = 0; offset < data.length(); offset += step)
+        {
+            buffer.append(data.data() + offset,
+                          std::min(step, data.length() - offset));
+            while (buffer.readableBytes() > 0)
+            {
+                auto readableBytes = buffer.readableBytes();
+                if (!parser.parse(&buffer))
+                {
+                    std::cout << "Error" << std::endl;
+                    return 1;
+                }
+                std::string piece;
+                WebSocketMessageType type;
+                bool isFinal;
+                if (parser.gotAll(piece, type))
+                {
+                    control.append(piece);
+                }
+                else if (parser.gotFragment(piece, type, isFinal))
+                {
+                    if (type != WebSocketMessageType::Binary)
+                        success = false;
+                    message.append(piece);
+                    finalCount += isFinal;
+                }
+                else if (buffer.readableBytes() == readableBytes)
+                {
+                    break;
+                }
+            }
+        }
+        std::cout << "step " << step << ": " << message.length() << " bytes"
+                  << std::endl;
+        if (message != payload + "end" || control != "ping" ||
+            finalCount != 1)
+            success = false;
+    }
+    std::cout << (success ? "OK" : "Error") << std::endl;
+    return success ? 0 : 1;
+}
@@ -0,0 +1,148 @@
+#include <drogon/drogon.h>
+#include <drogon/WebSocketClient.h>
+#include <drogon/WebSocketController.h>
+#include <trantor/net/TcpClient.h>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <string>
+
+using namespace drogon;
+
+// Closes the connections of /idle after one idle second, and pings the
+// connections of /ping every 200ms, closing them when a pong doesn't come
+// in one second.
+class TimerCtrl : public drogon::WebSocketController<TimerCtrl>
+{
+  public:
+    virtual void handleNewMessage(const WebSocketConnectionPtr &,
+                                  std::string &&,
+                                  const WebSocketMessageType &) override
+    {
+    }
+    virtual void handleNewConnection(
+        const HttpRequestPtr &req,
+        const WebSocketConnectionPtr &conn) override
+    {
+        if (req->path() == "/idle")
+        {
+            conn->setIdleTimeout(std::chrono::seconds(1));
+            return;
+        }
+        conn->setPingMessage("ping", std::chrono::milliseconds(200));
+        conn->setPongTimeout(std::chrono::seconds(1));
+    }
+    virtual void handleConnectionClosed(
+        const WebSocketConnectionPtr &) override
+    {
+    }
+    WS_PATH_LIST_BEGIN
+    WS_PATH_ADD("/idle");
+    WS_PATH_ADD("/ping");
+    WS_PATH_LIST_END
+};
+
+static double secondsSince(const trantor::Date &start)
+{
+    return (trantor::Date::now().microSecondsSinceEpoch() -
+            start.microSecondsSinceEpoch()) /
+           1000000.0;
+}
+
+int main()
+{
+    app().addListener("127.0.0.1", 8859);
+
+    double idleClose = 0;
+    double silentClose = 0;
+    int pings = 0;
+    bool pingOpen = false;
+    WebSocketClientPtr idleClient;
+    WebSocketClientPtr pingClient;
+    std::shared_ptr<trantor::TcpClient> silentClient;
+    auto loop = app().getLoop();
+    loop->runAfter(0.5, [&]() {
+        // Nothing is sent, the server closes the connection.
+        auto idleStart = std::make_shared<trantor::Date>();
+        idleClient = WebSocketClient::newWebSocketClient("127.0.0.1", 8859);
+        idleClient->setConnectionClosedHandler(
+            [idleStart, &idleClose](const WebSocketClientPtr &) {
+                idleClose = secondsSince(*idleStart);
+            });
+        auto req = HttpRequest::newHttpRequest();
+        req->setPath("/idle");
+        idleClient->connectToServer(req,
+                                    [idleStart](ReqResult,
+                                                const HttpResponsePtr &,
+                                                const WebSocketClientPtr &) {
+                                        *idleStart = trantor::Date::now();
+                                    });
+
+        // The client answers the pings, the connection stays open.
+        pingClient = WebSocketClient::newWebSocketClient("127.0.0.1", 8859);
+        pingClient->setMessageHandler(
+            [&pings](std::string &&,
+                     const WebSocketClientPtr &,
+                     const WebSocketMessageType &type) {
+                if (type == WebSocketMessageType::Ping)
+                    ++pings;
+            });
+        req = HttpRequest::newHttpRequest();
+        req->setPath("/ping");
+        pingClient->connectToServer(
+            req,
+            [loop, &pingOpen](ReqResult result,
+                              const HttpResponsePtr &,
+                              const WebSocketClientPtr &wsPtr) {
+                if (result != ReqResult::Ok)
+                    return;
+                loop->runAfter(2.5, [wsPtr, &pingOpen]() {
+                    pingOpen = wsPtr->getConnection()->connected();
+                });
+            });
+
+        // The handshake is done by hand and the pings are never answered,
+        // so the server closes the connection after the pong timeout.
+        auto silentStart = std::make_shared<trantor::Date>();
+        silentClient = std::make_shared<trantor::TcpClient>(
+            loop, trantor::InetAddress("127.0.0.1", 8859), "silent");
+        silentClient->setConnectionCallback(
+            [silentStart, &silentClose](const trantor::TcpConnectionPtr &conn) {
+                if (!conn->connected())
+                {
+                    silentClose = secondsSince(*silentStart);
+                    return;
+                }
+                *silentStart = trantor::Date::now();
+                conn->send(
+                    "GET /ping HTTP/1.1\r\n"
+                    "Host: 127.0.0.1:8859\r\n"
+                    "Upgrade: websocket\r\n"
+                    "Connection: Upgrade\r\n"
+                    "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+                    "Sec-WebSocket-Version: 13\r\n\r\n");
+            });
+        silentClient->setMessageCallback(
+            [](const trantor::TcpConnectionPtr &, trantor::MsgBuffer *buf) {
+                buf->retrieveAll();
+            });
+        silentClient->connect();
+    });
+    loop->runAfter(4.5, []() { app().quit(); });
+    app().run();
+    std::cout << "idle close: " << idleClose << "s" << std::endl;
+    std::cout << "pings: " << pings << (pingOpen ? ", open" : ", closed")
+              << std::endl;
+    std::cout << "pong timeout: " << silentClose << "s" << std::endl;
+    // The timeouts are minimums, the wheel adds up to one second. The idle
+    // time is measured from the end of the handshake, a bit later than the
+    // server starts it.
+    if (idleClose < 0.95 || idleClose > 2.5 || pings < 8 || !pingOpen ||
+        silentClose < 1.2 || silentClose > 3.0)
+    {
+        std::cout << "Error" << std::endl;
+        return 1;
+    }
+    std::cout << "OK" << std::endl;
+    return 0;
+}
@@ -0,0 +1,117 @@
+#include <drogon/drogon.h>
+#include <drogon/WebSocketClient.h>
+#include <drogon/WebSocketController.h>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace drogon;
+
+static const int messageNum = 200;
+static const int clientNum = 4;
+
+// Handles the messages in the worker threads, every connection checks that
+// its messages are numbered in order, and replies with the result after
+// the last one.
+class OrderCtrl : public drogon::WebSocketController<OrderCtrl>
+{
+  public:
+    virtual void handleNewMessage(const WebSocketConnectionPtr &conn,
+                                  std::string &&message,
+                                  const WebSocketMessageType &type) override
+    {
+        if (type != WebSocketMessageType::Text)
+            return;
+        auto next = conn->getContext<int>();
+        if (message == "end")
+        {
+            conn->send(*next == messageNum ? "ordered" : "unordered");
+            return;
+        }
+        // Messages taking different times must not be reordered.
+        if (std::stoi(message) % 7 == 0)
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        if (std::stoi(message) == *next)
+            ++*next;
+        else
+            *next = -1;
+    }
+    virtual void handleNewConnection(
+        const HttpRequestPtr &,
+        const WebSocketConnectionPtr &conn) override
+    {
+        conn->setContext(std::make_shared<int>(0));
+    }
+    virtual void handleConnectionClosed(
+        const WebSocketConnectionPtr &) override
+    {
+    }
+    virtual bool usesWorkerThreads() const override
+    {
+        return true;
+    }
+    WS_PATH_LIST_BEGIN
+    WS_PATH_ADD("/order");
+    WS_PATH_LIST_END
+};
+
+int main()
+{
+    app().addListener("127.0.0.1", 8858);
+    app().setWebSocketWorkerThreadNum(4);
+
+    std::atomic<int> ordered(0);
+    std::atomic<int> replied(0);
+    std::vector<WebSocketClientPtr> clients;
+    auto loop = app().getLoop();
+    loop->runAfter(0.5, [&]() {
+        for (int i = 0; i < clientNum; ++i)
+        {
+            auto client =
+                WebSocketClient::newWebSocketClient("127.0.0.1", 8858);
+            client->setMessageHandler(
+                [&](std::string &&message,
+                    const WebSocketClientPtr &,
+                    const WebSocketMessageType &) {
+                    if (message == "ordered")
+                        ++ordered;
+                    if (++replied == clientNum)
+                        app().quit();
+                });
+            auto req = HttpRequest::newHttpRequest();
+            req->setPath("/order");
+            client->connectToServer(
+                req,
+                [](ReqResult result,
+                   const HttpResponsePtr &,
+                   const WebSocketClientPtr &wsPtr) {
+                    if (result != ReqResult::Ok)
+                    {
+                        app().quit();
+                        return;
+                    }
+                    // All messages are sent at once, faster than they are
+                    // handled.
+                    auto conn = wsPtr->getConnection();
+                    for (int j = 0; j < messageNum; ++j)
+                        conn->send(std::to_string(j));
+                    conn->send("end");
+                });
+            clients.push_back(client);
+        }
+    });
+    loop->runAfter(10.0, []() { app().quit(); });
+    app().run();
+    std::cout << ordered << " of " << clientNum << " connections in order"
+              << std::endl;
+    if (ordered != clientNum)
+    {
+        std::cout << "Error" << std::endl;
+        return 1;
+    }
+    std::cout << "OK" << std::endl;
+    return 0;
+}
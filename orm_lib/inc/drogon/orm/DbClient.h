@@ -20,6 +20,7 @@
 #include <drogon/orm/Row.h>
 #include <drogon/orm/RowIterator.h>
 #include <drogon/orm/SqlBinder.h>
+#include <drogon/utils/coroutine.h>
 #include <exception>
 #include <functional>
 #include <future>
@@ -36,6 +37,36 @@ typedef std::function<void(const DrogonDbException &)> ExceptionCallback;
 
 class Transaction;
 
+#ifdef __cpp_impl_coroutine
+namespace internal
+{
+template <typename Executor>
+class SqlAwaiter : public drogon::internal::CallbackAwaiter<Result>
+{
+  public:
+    explicit SqlAwaiter(Executor &&executor) : _executor(std::move(executor))
+    {
+    }
+    void await_suspend(std::coroutine_handle<> handle)
+    {
+        suspend(handle);
+        _executor(
+            [this](const Result &result) {
+                setValue(result);
+                resume();
+            },
+            [this](const std::exception_ptr &exception) {
+                setException(exception);
+                resume();
+            });
+    }
+
+  private:
+    Executor _executor;
+};
+}  // namespace internal
+#endif
+
 /// Database client abstract class
 class DbClient : public trantor::NonCopyable
 {
@@ -129,6 +160,34 @@ class DbClient : public trantor::NonCopyable
         return prom->get_future();
     }
 
+#ifdef __cpp_impl_coroutine
+    /// Execute the sql in a coroutine and return the result
+    /**
+     * The sql is executed when the awaiter is awaited, and the coroutine is
+     * resumed in the event loop in which it awaits. The DrogonDbException is
+     * thrown if the execution fails.
+     *
+     * @code
+       auto result = co_await client->execSqlCoro(
+           "select * from users where id=$1", userId);
+       @endcode
+     */
+    template <typename... Arguments>
+    auto execSqlCoro(const std::string &sql, Arguments &&... args)
+    {
+        auto executor = [this, sql, ... args = std::forward<Arguments>(args)](
+                            auto &&resultCallback,
+                            auto &&exceptionCallback) mutable {
+            execSqlAsync(
+                sql,
+                std::forward<decltype(resultCallback)>(resultCallback),
+                std::forward<decltype(exceptionCallback)>(exceptionCallback),
+                std::move(args)...);
+        };
+        return internal::SqlAwaiter<decltype(executor)>(std::move(executor));
+    }
+#endif
+
     // Sync and blocking method
     template <typename... Arguments>
     const Result execSqlSync(const std::string &sql,